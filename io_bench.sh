@@ -0,0 +1,37 @@
+#!/bin/bash
+
+# Compare the server's I/O backends on the same upload.
+# Usage: ./io_bench.sh [size_in_MB] [clients]
+# Run build_script.sh first. Each backend prints its syscall count and
+# I/O thread CPU per GB received when the server shuts down.
+
+SIZE_MB=${1:-16}
+CLIENTS=${2:-4}
+PORT=8080
+
+cd build || exit 1
+
+# One TXT log, uploaded by every client
+mkdir -p io_bench_logs
+yes "2023-06-01 10:00:00|alice|10.0.0.1|INFO|io benchmark record" | head -c $((SIZE_MB * 1024 * 1024)) > io_bench_logs/bench.txt
+
+for MODE in epoll uring; do
+    echo "=== $MODE ==="
+    ./server --io $MODE $PORT > io_bench_$MODE.log 2>&1 &
+    SERVER_PID=$!
+    sleep 1
+
+    START=$(date +%s.%N)
+    for i in $(seq $CLIENTS); do
+        ./client 127.0.0.1 log_level io_bench_logs > /dev/null 2>&1 &
+    done
+    wait $(jobs -p | grep -v "^$SERVER_PID$")
+    END=$(date +%s.%N)
+    echo "$CLIENTS clients x $SIZE_MB MB in $(awk "BEGIN { print $END - $START }") s"
+
+    kill -TERM $SERVER_PID
+    wait $SERVER_PID
+    grep "I/O backend\|falling back" io_bench_$MODE.log
+done
+
+rm -rf io_bench_logs
@@ -0,0 +1,27 @@
+#!/bin/bash
+
+# Run a coordinator and N worker servers on this machine.
+# Usage: ./local_cluster.sh [workers] [first_worker_port]
+# Run build_script.sh first. Clients connect to the coordinator on port 8080
+# as usual; Ctrl+C stops every process.
+
+WORKERS=${1:-3}
+FIRST_PORT=${2:-9101}
+
+cd build || exit 1
+
+PIDS=()
+NODES=""
+for i in $(seq 0 $((WORKERS - 1))); do
+    PORT=$((FIRST_PORT + i))
+    # Separate directories keep the workers' temp files apart
+    mkdir -p cluster/worker$PORT
+    (cd cluster/worker$PORT && exec ../../server $PORT > ../worker$PORT.log 2>&1) &
+    PIDS+=($!)
+    NODES="$NODES${NODES:+,}127.0.0.1:$PORT"
+done
+sleep 1
+
+trap 'kill -TERM "${PIDS[@]}" 2>/dev/null; wait' EXIT
+echo "Worker logs: build/cluster/worker<port>.log"
+./server --worker-nodes "$NODES"
@@ -0,0 +1,561 @@
+#include "common/protocol.h"
+#include "common/log_parser.h"
+#include "common/analyzer.h"
+#include "common/arena.h"
+#include "common/pattern_matcher.h"
+#include "common/segment_store.h"
+#include "common/content_hash.h"
+#include "bench/log_synth.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Repeatable microbenchmarks for the parsers, message framing, the text
+// result format, date filtering and the analyzer, on synthetic logs with a
+// fixed seed. Each benchmark reports the median of its runs.
+// Usage: log_bench [--records N] [--repeat R] [--filter text] [--json file] [--label text]
+using Clock = std::chrono::steady_clock;
+
+// Every allocation in the process is counted to report allocations per
+// record. All the replaceable forms are defined, so that whatever form
+// allocates, the matching one frees with std::free.
+static std::atomic<uint64_t> allocationCount{0};
+
+static void* countedAlloc(std::size_t size) noexcept {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new(std::size_t size) {
+    if (void* memory = countedAlloc(size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    if (void* memory = countedAlloc(size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return countedAlloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return countedAlloc(size);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+// Keeps results alive so the measured work is not optimized away
+static volatile size_t sink;
+
+struct Measurement {
+    std::string name;
+    double seconds;               // Median run time
+    uint64_t bytes;               // Input processed per run
+    uint64_t records;             // Records (or messages, keys, calls) per run
+    double allocationsPerRecord;  // Fewest allocations over the runs, per record
+};
+
+class Bench {
+public:
+    Bench(int repeat, const std::string& filter) : repeat_(std::max(repeat, 1)), filter_(filter) {}
+
+    // Time body repeat times; setup runs untimed before each run
+    void run(const std::string& name, uint64_t bytes, uint64_t records, const std::function<void()>& body,
+             const std::function<void()>& setup = nullptr) {
+        if (!filter_.empty() && name.find(filter_) == std::string::npos) {
+            return;
+        }
+        std::vector<double> times;
+        uint64_t fewestAllocations = UINT64_MAX;
+        for (int i = 0; i < repeat_; ++i) {
+            if (setup) {
+                setup();
+            }
+            uint64_t allocationsBefore = allocationCount.load();
+            auto start = Clock::now();
+            body();
+            times.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+            fewestAllocations = std::min(fewestAllocations, allocationCount.load() - allocationsBefore);
+        }
+        std::sort(times.begin(), times.end());
+
+        Measurement measurement{name, times[times.size() / 2], bytes, records,
+                                records > 0 ? static_cast<double>(fewestAllocations) / records : 0.0};
+        report(measurement);
+        results_.push_back(measurement);
+    }
+
+    const std::vector<Measurement>& results() const {
+        return results_;
+    }
+
+private:
+    static void report(const Measurement& m) {
+        std::cout << std::left << std::setw(26) << m.name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(10) << m.seconds * 1000 << " ms" << std::setw(10)
+                  << (m.bytes / 1048576.0) / m.seconds << " MB/s" << std::setw(12)
+                  << (m.records / 1e6) / m.seconds << " M/s" << std::setw(10) << m.allocationsPerRecord
+                  << " allocs/record" << std::endl;
+    }
+
+    int repeat_;
+    std::string filter_;
+    std::vector<Measurement> results_;
+};
+
+static bool makeSocketPair(socket_t sockets[2]) {
+#ifdef _WIN32
+    // No socketpair: connect two ends over loopback
+    socket_t listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int length = sizeof(address);
+    if (listener == INVALID_SOCKET_VALUE || bind(listener, (sockaddr*)&address, sizeof(address)) != 0 ||
+        getsockname(listener, (sockaddr*)&address, &length) != 0 || listen(listener, 1) != 0) {
+        return false;
+    }
+    sockets[0] = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (connect(sockets[0], (sockaddr*)&address, sizeof(address)) != 0) {
+        closesocket(listener);
+        return false;
+    }
+    sockets[1] = accept(listener, nullptr, nullptr);
+    closesocket(listener);
+    return sockets[1] != INVALID_SOCKET_VALUE;
+#else
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        return false;
+    }
+    sockets[0] = fds[0];
+    sockets[1] = fds[1];
+    return true;
+#endif
+}
+
+static void benchParsers(Bench& bench, size_t records) {
+    SyntheticLogOptions options;
+    options.records = records;
+    const std::pair<LogFormat, const char*> formats[] = {
+        {LogFormat::JSON, "json"}, {LogFormat::XML, "xml"}, {LogFormat::TXT, "txt"}};
+    for (const auto& format : formats) {
+        std::string content = generateLogs(format.first, options);
+        auto parser = LogParser::createParser(std::string("bench.") + format.second);
+        // Into a job arena, as the analyzer parses
+        bench.run(std::string("parse/") + format.second, content.size(), records, [&]() {
+            ArenaScope arena;
+            std::pmr::vector<LogEntry> entries(ArenaScope::current());
+            parser->parseInto(content, entries);
+            sink = entries.size();
+        });
+    }
+}
+
+static void benchProtocol(Bench& bench) {
+    socket_t sockets[2];
+    if (!makeSocketPair(sockets)) {
+        std::cerr << "Cannot create a socket pair, skipping protocol benchmarks" << std::endl;
+        return;
+    }
+
+    // 64 MB per run: file chunks as the client sends them, and large frames
+    constexpr size_t TOTAL_BYTES = 64 * 1024 * 1024;
+    for (size_t size : {static_cast<size_t>(BUFFER_SIZE), static_cast<size_t>(64 * 1024)}) {
+        std::string payload(size, 'x');
+        size_t count = TOTAL_BYTES / size;
+        bench.run("protocol/" + std::to_string(size / 1024) + "KB", count * size, count, [&]() {
+            std::thread sender([&]() {
+                for (size_t i = 0; i < count; ++i) {
+                    sendMessage(sockets[0], MSG_FILE_CHUNK, payload);
+                }
+            });
+            char type;
+            std::string message;
+            size_t received = 0;
+            for (size_t i = 0; i < count && receiveMessage(sockets[1], type, message); ++i) {
+                received += message.size();
+            }
+            sender.join();
+            sink = received;
+        });
+    }
+    close_socket(sockets[0]);
+    close_socket(sockets[1]);
+}
+
+static void benchResultFormat(Bench& bench, size_t keys) {
+    AnalysisResult result;
+    result.type = AnalysisType::IP;
+    for (size_t i = 0; i < keys; ++i) {
+        result.counts["10." + std::to_string((i >> 16) & 255) + "." + std::to_string((i >> 8) & 255) + "." +
+                      std::to_string(i & 255)] = 1 + i % 1000;
+    }
+    std::string text = serializeResult(result);
+
+    bench.run("result/serialize", text.size(), keys, [&]() { sink = serializeResult(result).size(); });
+    bench.run("result/deserialize", text.size(), keys, [&]() { sink = deserializeResult(text).counts.size(); });
+}
+
+static void benchPatterns(Bench& bench, size_t records) {
+    // Messages of a TXT log scanned for a growing number of random 6-16
+    // character literals (plus one that occurs), once with the automaton and,
+    // for comparison, with one search per pattern
+    SyntheticLogOptions options;
+    options.records = records;
+    std::vector<LogEntry> entries = TxtLogParser().parse(generateLogs(LogFormat::TXT, options));
+    uint64_t bytes = 0;
+    for (const auto& entry : entries) {
+        bytes += entry.message.size();
+    }
+
+    std::mt19937_64 rng(7);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::uniform_int_distribution<int> length(6, 16);
+    std::vector<std::string> patterns = {"timeout"};
+    for (size_t count : {10, 100, 1000, 10000}) {
+        while (patterns.size() < count) {
+            std::string pattern(length(rng), ' ');
+            for (auto& c : pattern) {
+                c = static_cast<char>(letter(rng));
+            }
+            patterns.push_back(pattern);
+        }
+        PatternMatcher matcher(patterns);
+        bench.run("patterns/aho" + std::to_string(count), bytes, entries.size(), [&]() {
+            size_t found = 0;
+            for (const auto& entry : entries) {
+                matcher.scan(entry.message, [&found](size_t) { found++; });
+            }
+            sink = found;
+        });
+        if (count <= 100) {
+            bench.run("patterns/naive" + std::to_string(count), bytes, entries.size(), [&]() {
+                size_t found = 0;
+                for (const auto& entry : entries) {
+                    std::string_view message(entry.message);
+                    for (const auto& pattern : patterns) {
+                        found += message.find(pattern) != std::string_view::npos;
+                    }
+                }
+                sink = found;
+            });
+        }
+    }
+}
+
+static void benchDateFilter(Bench& bench, size_t calls) {
+    SyntheticLogOptions options;
+    options.records = 1000;
+    std::vector<LogEntry> entries = TxtLogParser().parse(generateLogs(LogFormat::TXT, options));
+    std::optional<std::string> startDate = std::string("2023-01-01");
+    std::optional<std::string> endDate = std::string("2023-12-31");
+
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < calls; ++i) {
+        bytes += entries[i % entries.size()].timestamp.size();
+    }
+    bench.run("date/isDateInRange", bytes, calls, [&]() {
+        size_t inRange = 0;
+        for (size_t i = 0; i < calls; ++i) {
+            inRange += isDateInRange(entries[i % entries.size()].timestamp, startDate, endDate);
+        }
+        sink = inRange;
+    });
+}
+
+// Content hash of --dedup uploads, computed by the client and checked by the server
+static void benchContentHash(Bench& bench, size_t records) {
+    SyntheticLogOptions options;
+    options.records = records;
+    std::string content = generateLogs(LogFormat::TXT, options);
+    bench.run("hash/content", content.size(), records, [&]() { sink = ContentHasher::hash(content).size(); });
+}
+
+// One file of each format; bytes is set to their total size
+static std::vector<LogSource> makeDataset(const SyntheticLogOptions& options, uint64_t& bytes) {
+    std::vector<LogSource> dataset;
+    bytes = 0;
+    const std::pair<LogFormat, const char*> formats[] = {
+        {LogFormat::JSON, "bench.json"}, {LogFormat::XML, "bench.xml"}, {LogFormat::TXT, "bench.txt"}};
+    for (const auto& format : formats) {
+        LogSource source;
+        source.name = format.second;
+        source.content = generateLogs(format.first, options);
+        bytes += source.content.size();
+        dataset.push_back(std::move(source));
+    }
+    return dataset;
+}
+
+static void benchAnalyzer(Bench& bench, size_t records, const std::string& name, const std::string& filter) {
+    // One file of each format, analyzed by a private pool as in edge mode
+    SyntheticLogOptions options;
+    options.records = records;
+    uint64_t bytes = 0;
+    std::vector<LogSource> dataset = makeDataset(options, bytes);
+
+    AnalysisRequest request;
+    request.type = AnalysisType::USER;
+    request.filter = filter;
+    std::vector<LogSource> sources;
+    std::unique_ptr<LogAnalyzer> analyzer;
+    bench.run(name, bytes, records * dataset.size(),
+              [&]() { sink = analyzer->analyze(sources).totalEntries; },
+              [&]() {
+                  sources = dataset;
+                  analyzer = std::make_unique<LogAnalyzer>(request);
+              });
+}
+
+// Queries of a stored dataset against parsing the same upload again: all of
+// it, a tenth of its time range (other blocks skipped by their zone maps)
+// and with a filter (rows rebuilt from the columns it reads)
+static void benchSegmentStore(Bench& bench, size_t records) {
+    SyntheticLogOptions options;
+    options.records = records;
+    std::vector<LogSource> upload(1);
+    upload[0].name = "bench.txt";
+    upload[0].content = generateLogs(LogFormat::TXT, options);
+    const uint64_t bytes = upload[0].content.size();
+
+    std::string storeDir = (std::filesystem::temp_directory_path() / "log_bench_store").string();
+    {
+        AnalysisRequest request;
+        request.type = AnalysisType::USER;
+        SegmentWriter writer(storeDir, "bench");
+        LogAnalyzer analyzer(request);
+        analyzer.setEntrySink([&writer](const std::pmr::vector<LogEntry>& entries) { writer.add(entries); });
+        std::vector<LogSource> sources = upload;
+        analyzer.analyze(sources);
+        if (!writer.commit()) {
+            std::cerr << "Cannot store the benchmark dataset in " << storeDir << std::endl;
+            return;
+        }
+    }
+    std::string datasetDir;
+    datasetPath(storeDir, "bench", datasetDir);
+    std::vector<std::string> segments = listSegments(datasetDir);
+
+    AnalysisRequest request;
+    request.type = AnalysisType::USER;
+    std::vector<LogSource> sources;
+    std::unique_ptr<LogAnalyzer> analyzer;
+    bench.run("store/parse_txt", bytes, records, [&]() { sink = analyzer->analyze(sources).totalEntries; },
+              [&]() {
+                  sources = upload;
+                  analyzer = std::make_unique<LogAnalyzer>(request);
+              });
+
+    auto query = [&](const std::string& name, const AnalysisRequest& query, size_t rows) {
+        bench.run(name, bytes, rows,
+                  [&]() {
+                      for (const auto& segment : segments) {
+                          analyzer->submitSegment(segment);
+                      }
+                      sink = analyzer->finish().totalEntries;
+                  },
+                  [&]() { analyzer = std::make_unique<LogAnalyzer>(query); });
+    };
+    query("store/scan_user", request, records);
+    AnalysisRequest tenth = request;
+    tenth.startDate = formatStoredTime(options.startTime);
+    tenth.endDate = formatStoredTime(options.startTime + static_cast<int64_t>(records / 10));
+    query("store/scan_tenth", tenth, records / 10);
+    AnalysisRequest filtered = request;
+    filtered.filter = "level = ERROR and message contains \"timeout\"";
+    query("store/scan_filtered", filtered, records);
+
+    analyzer.reset();
+    std::error_code error;
+    std::filesystem::remove_all(storeDir, error);
+}
+
+// Many requests at once on one shared pool, as on a busy server: every
+// request uploads one file of each format
+static void runConcurrentRequests(Bench& bench, const std::string& name, const SyntheticLogOptions& options,
+                                  size_t requests, ThreadPool& pool) {
+    uint64_t bytes = 0;
+    std::vector<LogSource> dataset = makeDataset(options, bytes);
+
+    AnalysisRequest request;
+    request.type = AnalysisType::USER;
+    std::vector<std::vector<LogSource>> inputs;
+    std::vector<std::unique_ptr<LogAnalyzer>> analyzers;
+    bench.run(name, bytes * requests, options.records * dataset.size() * requests,
+              [&]() {
+                  for (size_t i = 0; i < requests; ++i) {
+                      for (auto& source : inputs[i]) {
+                          analyzers[i]->submit(std::move(source));
+                      }
+                  }
+                  uint64_t entries = 0;
+                  for (auto& analyzer : analyzers) {
+                      entries += analyzer->finish().totalEntries;
+                  }
+                  sink = entries;
+              },
+              [&]() {
+                  inputs.assign(requests, dataset);
+                  analyzers.clear();
+                  for (size_t i = 0; i < requests; ++i) {
+                      analyzers.push_back(std::make_unique<LogAnalyzer>(request, pool, i + 1));
+                  }
+              });
+}
+
+static void benchConcurrentRequests(Bench& bench, size_t records, size_t requests) {
+    SyntheticLogOptions options;
+    options.records = records;
+    ThreadPool pool;
+    runConcurrentRequests(bench, "analyze/concurrent" + std::to_string(requests), options, requests, pool);
+}
+
+static void benchHighCardinality(Bench& bench, size_t records, size_t requests) {
+    // Nearly every record has its own user, so merging dominates: the same
+    // load on a floating pool and on one pinned across the NUMA nodes
+    // (--pin-workers), which merges per node before the cross-node merge
+    SyntheticLogOptions options;
+    options.records = records;
+    options.users = records;
+    {
+        ThreadPool pool;
+        runConcurrentRequests(bench, "analyze/highcard", options, requests, pool);
+    }
+    ThreadPool pinned(0, true);
+    runConcurrentRequests(bench, "analyze/highcard_pinned", options, requests, pinned);
+}
+
+static std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+static bool writeJson(const std::string& filename, const std::string& label, size_t records, int repeat,
+                      const std::vector<Measurement>& results) {
+    std::ofstream out(filename);
+    if (!out) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return false;
+    }
+    out << std::fixed << std::setprecision(6);
+    out << "{\n  \"label\": " << jsonString(label) << ",\n  \"records\": " << records
+        << ",\n  \"repeat\": " << repeat << ",\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Measurement& m = results[i];
+        out << "    {\"name\": " << jsonString(m.name) << ", \"seconds\": " << m.seconds
+            << ", \"bytes\": " << m.bytes << ", \"records\": " << m.records
+            << ", \"mb_per_second\": " << (m.bytes / 1048576.0) / m.seconds
+            << ", \"records_per_second\": " << m.records / m.seconds
+            << ", \"allocations_per_record\": " << m.allocationsPerRecord << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    size_t records = 10000;
+    int repeat = 5;
+    std::string filter;
+    std::string jsonFile;
+    std::string label;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--records" && i + 1 < argc) {
+            records = std::stoull(argv[++i]);
+        }
+        else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = std::stoi(argv[++i]);
+        }
+        else if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        }
+        else if (arg == "--json" && i + 1 < argc) {
+            jsonFile = argv[++i];
+        }
+        else if (arg == "--label" && i + 1 < argc) {
+            label = argv[++i];
+        }
+        else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--records N] [--repeat R] [--filter text] [--json file] [--label text]" << std::endl;
+            return 1;
+        }
+    }
+
+#ifdef _WIN32
+    if (!initializeWinsock()) {
+        return 1;
+    }
+#endif
+
+    std::cout << records << " records per file, median of " << repeat << " runs\n" << std::endl;
+    Bench bench(repeat, filter);
+    benchParsers(bench, records);
+    benchProtocol(bench);
+    benchResultFormat(bench, records * 5);
+    benchDateFilter(bench, records * 50);
+    benchPatterns(bench, records * 5);
+    benchContentHash(bench, records * 10);
+    benchAnalyzer(bench, records, "analyze/user", "");
+    benchAnalyzer(bench, records, "analyze/filtered", "level = ERROR and message contains \"timeout\"");
+    benchSegmentStore(bench, records * 10);
+    benchConcurrentRequests(bench, std::max<size_t>(records / 10, 1), 16);
+    benchHighCardinality(bench, records, 4);
+
+    if (!jsonFile.empty() && !writeJson(jsonFile, label, records, repeat, bench.results())) {
+        return 1;
+    }
+    return 0;
+}
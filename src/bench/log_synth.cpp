@@ -0,0 +1,132 @@
+#include "bench/log_synth.h"
+#include <random>
+#include <ctime>
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+static const char* const LEVELS[] = {"DEBUG", "INFO", "INFO", "INFO", "WARN", "ERROR"};
+static const char* const MESSAGES[] = {"user login", "user logout", "disk timeout", "connection reset",
+                                       "request served", "ok"};
+
+// Key ranks drawn with probability proportional to 1 / (rank + 1)^skew
+class KeySampler {
+public:
+    KeySampler(size_t keys, double skew) : uniform_(0, std::max<size_t>(keys, 1) - 1) {
+        if (skew <= 0 || keys <= 1) {
+            return;
+        }
+        cumulative_.resize(keys);
+        double total = 0;
+        for (size_t rank = 0; rank < keys; ++rank) {
+            total += 1.0 / std::pow(static_cast<double>(rank + 1), skew);
+            cumulative_[rank] = total;
+        }
+        for (double& value : cumulative_) {
+            value /= total;
+        }
+    }
+
+    size_t operator()(std::mt19937_64& rng) {
+        if (cumulative_.empty()) {
+            return uniform_(rng);
+        }
+        double draw = std::uniform_real_distribution<double>(0, 1)(rng);
+        auto it = std::lower_bound(cumulative_.begin(), cumulative_.end(), draw);
+        return std::min<size_t>(it - cumulative_.begin(), cumulative_.size() - 1);
+    }
+
+private:
+    std::uniform_int_distribution<size_t> uniform_;
+    std::vector<double> cumulative_;
+};
+
+// "YYYY-MM-DD HH:MM:SS" for a record, spread evenly from startTime
+static std::string timestampFor(size_t index, const SyntheticLogOptions& options) {
+    int64_t offset = static_cast<int64_t>(index);
+    if (options.spanSeconds > 0 && options.records > 0) {
+        offset = static_cast<int64_t>(static_cast<double>(index) * options.spanSeconds / options.records);
+    }
+    std::time_t seconds = static_cast<std::time_t>(options.startTime + offset);
+    char text[32];
+    std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", std::gmtime(&seconds));
+    return text;
+}
+
+static std::string ipFor(size_t index) {
+    return "10." + std::to_string((index >> 16) & 255) + "." + std::to_string((index >> 8) & 255) + "." +
+           std::to_string(index & 255);
+}
+
+std::string generateLogs(LogFormat format, const SyntheticLogOptions& options) {
+    std::mt19937_64 rng(options.seed);
+    KeySampler user(options.users, options.skew);
+    KeySampler ip(options.ips, options.skew);
+    std::uniform_int_distribution<size_t> level(0, sizeof(LEVELS) / sizeof(LEVELS[0]) - 1);
+    std::uniform_int_distribution<size_t> message(0, sizeof(MESSAGES) / sizeof(MESSAGES[0]) - 1);
+
+    std::string out;
+    out.reserve(options.records * (format == LogFormat::TXT ? 64 : 180));
+    if (format == LogFormat::JSON) {
+        out += "[\n";
+    }
+    else if (format == LogFormat::XML) {
+        out += "<logs>\n";
+    }
+
+    for (size_t i = 0; i < options.records; ++i) {
+        std::string timestamp = timestampFor(i, options);
+        std::string userName = "user" + std::to_string(user(rng));
+        std::string address = ipFor(ip(rng));
+        const char* levelName = LEVELS[level(rng)];
+        const char* text = MESSAGES[message(rng)];
+
+        switch (format) {
+            case LogFormat::JSON:
+                out += "  {\n    \"timestamp\": \"" + timestamp + "\",\n    \"user\": \"" + userName +
+                       "\",\n    \"ip\": \"" + address + "\",\n    \"level\": \"" + levelName +
+                       "\",\n    \"message\": \"" + text + "\"\n  }";
+                out += (i + 1 < options.records) ? ",\n" : "\n";
+                break;
+            case LogFormat::XML:
+                out += "  <entry>\n    <timestamp>" + timestamp + "</timestamp>\n    <user>" + userName +
+                       "</user>\n    <ip>" + address + "</ip>\n    <level>" + levelName +
+                       "</level>\n    <message>" + text + "</message>\n  </entry>\n";
+                break;
+            default:
+                out += timestamp + "|" + userName + "|" + address + "|" + levelName + "|" + text + "\n";
+                break;
+        }
+    }
+
+    if (format == LogFormat::JSON) {
+        out += "]\n";
+    }
+    else if (format == LogFormat::XML) {
+        out += "</logs>\n";
+    }
+    return out;
+}
+
+double averageRecordSize(LogFormat format, const SyntheticLogOptions& options) {
+    SyntheticLogOptions sample = options;
+    sample.records = 1000;
+    return generateLogs(format, sample).size() / 1000.0;
+}
+
+bool parseStartDate(const std::string& date, int64_t& seconds) {
+    int year, month, day;
+    if (std::sscanf(date.c_str(), "%d-%d-%d", &year, &month, &day) != 3 || month < 1 || month > 12 || day < 1 ||
+        day > 31) {
+        return false;
+    }
+    // Days since 1970-01-01 in the proleptic Gregorian calendar
+    int64_t y = year - (month <= 2);
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yearOfEra = y - era * 400;
+    int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    seconds = (era * 146097 + dayOfEra - 719468) * 86400;
+    return true;
+}
@@ -0,0 +1,28 @@
+#ifndef LOG_SYNTH_H
+#define LOG_SYNTH_H
+
+#include "common/log_parser.h"
+#include <string>
+#include <cstdint>
+
+// Synthetic log content in the layouts LogParser reads, for benchmarks and
+// load tests. The same options and seed always give the same bytes.
+struct SyntheticLogOptions {
+    size_t records = 10000;
+    size_t users = 100;          // Distinct user names
+    size_t ips = 1000;           // Distinct IP addresses
+    double skew = 0;             // Zipf exponent for users and IPs, 0 for uniform
+    int64_t startTime = 1672531200; // First timestamp, seconds since the epoch (2023-01-01)
+    int64_t spanSeconds = 0;     // Timestamps spread evenly over this span, 0 for one per second
+    uint64_t seed = 42;
+};
+
+std::string generateLogs(LogFormat format, const SyntheticLogOptions& options);
+
+// Seconds since the epoch for "YYYY-MM-DD" (UTC); false if malformed
+bool parseStartDate(const std::string& date, int64_t& seconds);
+
+// Average size of a record in the format, to turn a byte target into records
+double averageRecordSize(LogFormat format, const SyntheticLogOptions& options);
+
+#endif // LOG_SYNTH_H
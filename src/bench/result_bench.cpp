@@ -0,0 +1,139 @@
+#include "common/protocol.h"
+#include "common/result_codec.h"
+#include <iostream>
+#include <algorithm>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+// Compares the legacy text result format with the binary frame stream on a
+// synthetic result. Usage: result_bench [keys] [ip|user]
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static AnalysisResult makeResult(size_t keys, AnalysisType type) {
+    AnalysisResult result;
+    result.type = type;
+    result.counts.reserve(keys);
+
+    // Skewed counts, as real logs have a few heavy hitters and a long tail
+    std::mt19937_64 rng(42);
+    std::exponential_distribution<double> skew(0.001);
+    for (size_t i = 0; i < keys; ++i) {
+        std::string key;
+        if (type == AnalysisType::IP) {
+            key = std::to_string(10 + (i >> 24)) + "." + std::to_string((i >> 16) & 255) + "." +
+                  std::to_string((i >> 8) & 255) + "." + std::to_string(i & 255);
+        }
+        else {
+            key = "user" + std::to_string(i);
+        }
+        uint64_t count = 1 + static_cast<uint64_t>(skew(rng));
+        result.counts.emplace(std::move(key), count);
+        result.totalEntries += count;
+    }
+    return result;
+}
+
+static void report(const std::string& name, double seconds, size_t bytes, size_t keys) {
+    std::cout << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(9) << seconds << " s" << std::setprecision(1)
+              << std::setw(10) << (bytes / 1048576.0) / seconds << " MB/s"
+              << std::setw(12) << (keys / 1e6) / seconds << " Mkeys/s" << std::endl;
+}
+
+static bool sameResult(const AnalysisResult& a, const AnalysisResult& b) {
+    return a.type == b.type && a.totalEntries == b.totalEntries && a.counts == b.counts;
+}
+
+int main(int argc, char* argv[]) {
+    size_t keys = 1000000;
+    AnalysisType type = AnalysisType::IP;
+    if (argc > 1) {
+        keys = std::stoull(argv[1]);
+    }
+    if (argc > 2) {
+        type = stringToAnalysisType(argv[2] == std::string("user") ? "USER" : "IP");
+    }
+
+    std::cout << "Building result with " << keys << " keys..." << std::endl;
+    AnalysisResult result = makeResult(keys, type);
+
+    // Text: the whole result is one string on each side
+    auto start = Clock::now();
+    std::string text = serializeResult(result);
+    double textEncode = secondsSince(start);
+
+    start = Clock::now();
+    AnalysisResult fromText = deserializeResult(text);
+    double textDecode = secondsSince(start);
+
+    // Binary: frames are produced and consumed one at a time
+    std::vector<std::string> frames;
+    size_t binaryBytes = 0;
+    size_t largestFrame = 0;
+    start = Clock::now();
+    {
+        ResultEncoder encoder;
+        encoder.begin(result);
+        while (!encoder.done()) {
+            frames.push_back(encoder.nextFrame());
+            binaryBytes += frames.back().size();
+        }
+    }
+    double binaryEncode = secondsSince(start);
+    for (const auto& frame : frames) {
+        largestFrame = std::max(largestFrame, frame.size());
+    }
+
+    AnalysisResult fromBinary;
+    start = Clock::now();
+    {
+        ResultDecoder decoder;
+        for (const auto& frame : frames) {
+            if (decoder.addFrame(frame)) {
+                fromBinary = decoder.takeResult();
+            }
+        }
+    }
+    double binaryDecode = secondsSince(start);
+
+    // The same result again on one stream: keys already in the string table
+    // go out as references (as repeated results on a connection would)
+    size_t repeatBytes = 0;
+    double repeatEncode;
+    {
+        ResultEncoder encoder;
+        encoder.begin(result);
+        while (!encoder.done()) {
+            encoder.nextFrame();
+        }
+        start = Clock::now();
+        encoder.begin(result);
+        while (!encoder.done()) {
+            repeatBytes += encoder.nextFrame().size();
+        }
+        repeatEncode = secondsSince(start);
+    }
+
+    std::cout << "\nText:   " << text.size() << " bytes in one message\n"
+              << "Binary: " << binaryBytes << " bytes in " << frames.size()
+              << " frames (largest " << largestFrame << " bytes), "
+              << repeatBytes << " bytes when repeated on the same stream\n" << std::endl;
+    report("text serialize", textEncode, text.size(), keys);
+    report("text deserialize", textDecode, text.size(), keys);
+    report("binary encode", binaryEncode, binaryBytes, keys);
+    report("binary decode", binaryDecode, binaryBytes, keys);
+    report("binary encode, repeat", repeatEncode, repeatBytes, keys);
+
+    if (!sameResult(result, fromText) || !sameResult(result, fromBinary)) {
+        std::cerr << "Round trip mismatch" << std::endl;
+        return 1;
+    }
+    return 0;
+}
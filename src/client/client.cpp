@@ -1,4 +1,8 @@
 #include "client/client.h"
+#include "common/analyzer.h"
+#include "common/compression.h"
+#include "common/content_hash.h"
+#include "common/log_parser.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -8,9 +12,27 @@
 #include <chrono>
 #include <iomanip>
 #include <algorithm>
+#include <csignal>
+#include <unordered_set>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <poll.h>
+#endif
 
 namespace fs = std::filesystem;
 
+// Set by Ctrl+C while waiting for the result
+static volatile std::sig_atomic_t cancelRequested = 0;
+
+static void onInterrupt(int) {
+    cancelRequested = 1;
+    // A second Ctrl+C quits
+    std::signal(SIGINT, SIG_DFL);
+}
+
 LogClient::LogClient() : socket_(INVALID_SOCKET_VALUE), connected_(false) {
 }
 
@@ -103,10 +125,44 @@ bool LogClient::sendRequest(const AnalysisRequest& request) {
     }
     
     std::string requestStr = serializeRequest(request);
+    if (requestStr.size() > MAX_MESSAGE_SIZE) {
+        std::cerr << "Request is " << requestStr.size() << " bytes, over the protocol limit of "
+                  << MAX_MESSAGE_SIZE << " (shorten its patterns or filter)" << std::endl;
+        return false;
+    }
     return sendMessage(socket_, MSG_REQUEST, requestStr);
 }
 
-bool LogClient::sendLogFiles(const std::string& directory) {
+bool LogClient::sessionOpen() {
+    if (!connected_) {
+        return false;
+    }
+    if (!socketReadable(socket_, 0)) {
+        return true;
+    }
+    
+    // Nothing is sent between requests but the server closing the session
+    char type;
+    std::string message;
+    if (receiveMessage(socket_, type, message) && type == MSG_ERROR) {
+        std::cerr << "Server error: " << message << std::endl;
+    }
+    else {
+        std::cerr << "Session ended by the server" << std::endl;
+    }
+    return false;
+}
+
+bool LogClient::sendWindowQuery(AnalysisType type, int minutes) {
+    if (!connected_) {
+        std::cerr << "Not connected to server" << std::endl;
+        return false;
+    }
+    
+    return sendMessage(socket_, MSG_WINDOW, analysisTypeToString(type) + "|" + std::to_string(minutes));
+}
+
+bool LogClient::sendLogFiles(const std::string& directory, bool dedup) {
     if (!connected_) {
         std::cerr << "Not connected to server" << std::endl;
         return false;
@@ -127,7 +183,7 @@ bool LogClient::sendLogFiles(const std::string& directory) {
     
     // Send each file
     for (const auto& file : files) {
-        if (!sendFile(file)) {
+        if (!(dedup ? sendFileDeduplicated(file) : sendFile(file))) {
             std::cerr << "Failed to send file: " << file << std::endl;
             return false;
         }
@@ -142,6 +198,80 @@ bool LogClient::sendLogFiles(const std::string& directory) {
     return true;
 }
 
+bool LogClient::endUpload() {
+    if (!connected_) {
+        std::cerr << "Not connected to server" << std::endl;
+        return false;
+    }
+    if (!sendMessage(socket_, MSG_FILE_END, "")) {
+        std::cerr << "Failed to signal end of file transfer" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool LogClient::sendPartialResult(const std::string& directory, const AnalysisRequest& request) {
+    if (!connected_) {
+        std::cerr << "Not connected to server" << std::endl;
+        return false;
+    }
+    
+    // Check if directory exists
+    if (!fs::exists(directory) || !fs::is_directory(directory)) {
+        std::cerr << "Directory not found: " << directory << std::endl;
+        return false;
+    }
+    
+    std::vector<std::string> files = listFilesInDirectory(directory);
+    if (files.empty()) {
+        std::cerr << "No files found in directory: " << directory << std::endl;
+        return false;
+    }
+    
+    // Parse and aggregate on this machine's cores
+    AnalysisResult partial;
+    {
+        LogAnalyzer analyzer(request);
+        partial = analyzer.analyze(files);
+    }
+    
+    // Stream it in frames rather than as one large message
+    ResultEncoder encoder;
+    encoder.begin(partial);
+    size_t partialBytes = 0;
+    while (!encoder.done()) {
+        std::string frame = encoder.nextFrame();
+        partialBytes += frame.size();
+        if (!sendMessage(socket_, MSG_PARTIAL_RESULT, frame)) {
+            std::cerr << "Failed to send partial result" << std::endl;
+            return false;
+        }
+    }
+    
+    // Wait for acknowledgment
+    char type = 0;
+    std::string message;
+    if (!receiveReply(type, message) || type != MSG_ACK) {
+        if (type == MSG_ERROR) {
+            // e.g. the server's admission queue is full
+            std::cerr << "Server error: " << message << std::endl;
+        }
+        std::cerr << "Did not receive acknowledgment for partial result" << std::endl;
+        return false;
+    }
+    
+    std::cout << "Sent partial result for " << files.size() << " files ("
+              << partialBytes << " bytes)" << std::endl;
+    
+    // Signal end of transfer
+    if (!sendMessage(socket_, MSG_FILE_END, "")) {
+        std::cerr << "Failed to signal end of file transfer" << std::endl;
+        return false;
+    }
+    
+    return true;
+}
+
 bool LogClient::sendFile(const std::string& filepath) {
     if (!connected_) {
         std::cerr << "Not connected to server" << std::endl;
@@ -157,26 +287,150 @@ bool LogClient::sendFile(const std::string& filepath) {
     // Get file name (without path)
     std::string filename = fs::path(filepath).filename().string();
     
-    // Signal start of file transfer
-    if (!sendMessage(socket_, MSG_FILE_START, filename)) {
-        std::cerr << "Failed to signal start of file transfer" << std::endl;
+    // Open file
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error opening file: " << filepath << std::endl;
         return false;
     }
     
-    // Open file
+    if (!sendRange(file, filename, 0, UINT64_MAX)) {
+        return false;
+    }
+    
+    std::cout << "Sent file: " << filename << std::endl;
+    return true;
+}
+
+bool LogClient::sendFileDeduplicated(const std::string& filepath) {
+    if (!fs::exists(filepath) || !fs::is_regular_file(filepath)) {
+        std::cerr << "File not found: " << filepath << std::endl;
+        return false;
+    }
+    std::string filename = fs::path(filepath).filename().string();
     std::ifstream file(filepath, std::ios::binary);
     if (!file) {
         std::cerr << "Error opening file: " << filepath << std::endl;
         return false;
     }
     
+    // Cut the file into pieces at record boundaries, so that the same
+    // records give the same pieces again (appending to a file only adds
+    // pieces at its end), and hash them. A compressed file is one piece.
+    struct Piece {
+        uint64_t offset;
+        uint64_t size;
+        std::string hash;
+    };
+    std::vector<Piece> pieces;
+    bool compressed = detectFileCompression(filepath) != Compression::NONE;
+    auto parser = LogParser::createParser(filename);
+    std::string pending;
+    uint64_t pendingOffset = 0;
+    ContentHasher whole;
+    std::vector<char> buffer(DEDUP_PIECE_SIZE);
+    while (file) {
+        file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        size_t bytesRead = static_cast<size_t>(file.gcount());
+        if (compressed) {
+            whole.update(buffer.data(), bytesRead);
+            pendingOffset += bytesRead;
+            continue;
+        }
+        pending.append(buffer.data(), bytesRead);
+        while (pending.size() >= DEDUP_PIECE_SIZE) {
+            size_t boundary = parser->lastRecordBoundary(pending);
+            if (boundary == 0) {
+                break;
+            }
+            pieces.push_back({pendingOffset, boundary, ContentHasher::hash(pending.substr(0, boundary))});
+            pending.erase(0, boundary);
+            pendingOffset += boundary;
+        }
+    }
+    if (compressed) {
+        pieces.push_back({0, pendingOffset, whole.hex()});
+    }
+    else if (!pending.empty()) {
+        pieces.push_back({pendingOffset, pending.size(), ContentHasher::hash(pending)});
+    }
+    std::string().swap(pending);
+    if (pieces.empty()) {
+        return true;
+    }
+    
+    std::string manifest = filename + "\n";
+    for (const auto& piece : pieces) {
+        manifest += piece.hash + " " + std::to_string(piece.size) + "\n";
+    }
+    if (!sendMessage(socket_, MSG_MANIFEST, manifest)) {
+        std::cerr << "Failed to send manifest" << std::endl;
+        return false;
+    }
+    char type = 0;
+    std::string message;
+    if (!receiveReply(type, message) || type != MSG_MANIFEST) {
+        if (type == MSG_ERROR) {
+            std::cerr << "Server error: " << message << std::endl;
+        }
+        std::cerr << "Did not receive the missing pieces of " << filename << std::endl;
+        return false;
+    }
+    
+    // Indexes of the missing pieces, in order
+    std::vector<size_t> missing;
+    std::istringstream indexes(message);
+    std::string index;
+    while (std::getline(indexes, index, ',')) {
+        size_t value = pieces.size();
+        try {
+            value = static_cast<size_t>(std::stoul(index));
+        }
+        catch (const std::exception&) {
+        }
+        if (value >= pieces.size() || (!missing.empty() && value <= missing.back())) {
+            std::cerr << "Invalid list of missing pieces for " << filename << std::endl;
+            return false;
+        }
+        missing.push_back(value);
+    }
+    
+    file.clear();
+    uint64_t sentBytes = 0;
+    uint64_t totalBytes = 0;
+    for (const auto& piece : pieces) {
+        totalBytes += piece.size;
+    }
+    for (size_t value : missing) {
+        if (!sendRange(file, filename, pieces[value].offset, pieces[value].size)) {
+            return false;
+        }
+        sentBytes += pieces[value].size;
+    }
+    
+    std::cout << "Sent file: " << filename << " (" << missing.size() << " of " << pieces.size() << " pieces, "
+              << sentBytes << " of " << totalBytes << " bytes)" << std::endl;
+    return true;
+}
+
+bool LogClient::sendRange(std::ifstream& file, const std::string& filename, uint64_t offset, uint64_t size) {
+    // Signal start of file transfer
+    if (!sendMessage(socket_, MSG_FILE_START, filename)) {
+        std::cerr << "Failed to signal start of file transfer" << std::endl;
+        return false;
+    }
+    
     // Send file in chunks
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(offset));
     char buffer[BUFFER_SIZE];
-    while (!file.eof()) {
-        file.read(buffer, BUFFER_SIZE);
+    uint64_t remaining = size;
+    while (remaining > 0 && file) {
+        file.read(buffer, static_cast<std::streamsize>(std::min<uint64_t>(BUFFER_SIZE, remaining)));
         std::streamsize bytesRead = file.gcount();
         
         if (bytesRead > 0) {
+            remaining -= static_cast<uint64_t>(bytesRead);
             std::string chunk(buffer, bytesRead);
             if (!sendMessage(socket_, MSG_FILE_CHUNK, chunk)) {
                 std::cerr << "Error sending file chunk" << std::endl;
@@ -192,15 +446,271 @@ bool LogClient::sendFile(const std::string& filepath) {
     }
     
     // Wait for acknowledgment
-    char type;
+    char type = 0;
     std::string message;
-    if (!receiveMessage(socket_, type, message) || type != MSG_ACK) {
+    if (!receiveReply(type, message) || type != MSG_ACK) {
+        if (type == MSG_ERROR) {
+            // e.g. the server's admission queue is full
+            std::cerr << "Server error: " << message << std::endl;
+        }
         std::cerr << "Did not receive acknowledgment for file transfer" << std::endl;
         return false;
     }
+    return true;
+}
+
+// Follow mode reads appended data in pieces of this size, and rescans the
+// directory at least this often even without inotify events
+constexpr size_t FOLLOW_CHUNK_SIZE = 64 * 1024;
+static_assert(FOLLOW_CHUNK_SIZE <= MAX_MESSAGE_SIZE, "appended data must fit in a message");
+constexpr int FOLLOW_RESCAN_MS = 1000;
+
+bool LogClient::followDirectory(const std::string& directory) {
+    if (!connected_) {
+        std::cerr << "Not connected to server" << std::endl;
+        return false;
+    }
     
-    std::cout << "Sent file: " << filename << std::endl;
+#ifdef __linux__
+    int inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0 ||
+        inotify_add_watch(inotifyFd, directory.c_str(),
+                          IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE) < 0) {
+        std::cerr << "Error watching directory " << directory << ": " << strerror(errno) << std::endl;
+        if (inotifyFd >= 0) {
+            close(inotifyFd);
+        }
+        return false;
+    }
+    
+    // Ctrl+C ends the follow session
+    cancelRequested = 0;
+    auto previousHandler = std::signal(SIGINT, onInterrupt);
+    std::cout << "Following " << directory << ": press Enter for the current aggregates, Ctrl+C to stop" << std::endl;
+    
+    std::unordered_map<uint64_t, FollowedFile> files;
+    bool ok = scanFollowedFiles(directory, files);
+    bool watchStdin = true;
+    while (ok && !cancelRequested) {
+        struct pollfd fds[3];
+        fds[0].fd = inotifyFd;
+        fds[1].fd = socket_;
+        fds[2].fd = watchStdin ? 0 : -1;
+        for (auto& pfd : fds) {
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+        }
+        if (poll(fds, 3, FOLLOW_RESCAN_MS) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Error waiting for changes: " << strerror(errno) << std::endl;
+            ok = false;
+            break;
+        }
+        
+        // Progress reports pushed by the server
+        if (fds[1].revents) {
+            char type;
+            std::string message;
+            if (!receiveMessage(socket_, type, message)) {
+                std::cerr << "Connection to server lost" << std::endl;
+                ok = false;
+                break;
+            }
+            if (type == MSG_PROGRESS) {
+                try {
+                    printProgress(decodeProgress(decoder_, message));
+                }
+                catch (const std::exception& e) {
+                    std::cerr << "Invalid progress report from server: " << e.what() << std::endl;
+                    ok = false;
+                    break;
+                }
+            }
+            else {
+                std::cerr << (type == MSG_ERROR ? "Server error: " + message
+                                                : std::string("Unexpected message type: ") + type) << std::endl;
+                ok = false;
+                break;
+            }
+        }
+        
+        if (fds[2].revents) {
+            std::string line;
+            if (std::getline(std::cin, line)) {
+                ok = queryAggregates();
+            }
+            else {
+                watchStdin = false;
+            }
+        }
+        
+        // The events only say that something changed; the scan finds out what
+        if (fds[0].revents) {
+            char events[4096];
+            while (read(inotifyFd, events, sizeof(events)) > 0) {
+            }
+        }
+        ok = ok && scanFollowedFiles(directory, files);
+    }
+    
+    std::signal(SIGINT, previousHandler);
+    close(inotifyFd);
+    for (auto& pair : files) {
+        close(pair.second.fd);
+    }
+    if (!ok) {
+        return false;
+    }
+    
+    // End of the upload: the server analyzes what is left and sends the final result
+    std::cout << "Stopped following, waiting for the final result..." << std::endl;
+    if (!sendMessage(socket_, MSG_FILE_END, "")) {
+        std::cerr << "Failed to signal end of file transfer" << std::endl;
+        return false;
+    }
     return true;
+#else
+    (void)directory;
+    std::cerr << "Follow mode needs inotify (Linux)" << std::endl;
+    return false;
+#endif
+}
+
+#ifdef __linux__
+bool LogClient::scanFollowedFiles(const std::string& directory, std::unordered_map<uint64_t, FollowedFile>& files) {
+    std::vector<std::pair<uint64_t, std::string>> present;
+    std::unordered_set<uint64_t> seen;
+    for (const auto& path : listFilesInDirectory(directory)) {
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0) {
+            present.emplace_back(static_cast<uint64_t>(st.st_ino), path);
+            seen.insert(static_cast<uint64_t>(st.st_ino));
+        }
+    }
+    
+    // Deleted, or rotated away under a name we do not read: send the rest and stop.
+    // Done first so a file replacing a rotated one can take over its name.
+    for (auto it = files.begin(); it != files.end();) {
+        if (seen.count(it->first)) {
+            ++it;
+            continue;
+        }
+        bool ok = sendAppended(it->second) && sendMessage(socket_, MSG_FILE_RESET, it->second.name);
+        std::cout << "Stopped following " << it->second.name << std::endl;
+        close(it->second.fd);
+        it = files.erase(it);
+        if (!ok) {
+            return false;
+        }
+    }
+    
+    for (const auto& pair : present) {
+        auto it = files.find(pair.first);
+        if (it == files.end()) {
+            int fd = open(pair.second.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                continue;
+            }
+            FollowedFile file;
+            file.name = fs::path(pair.second).filename().string();
+            file.fd = fd;
+            file.offset = 0;
+            
+            // Renamed within the directory while another file took its name
+            for (const auto& other : files) {
+                if (other.second.name == file.name) {
+                    file.name = std::to_string(pair.first) + "_" + file.name;
+                    break;
+                }
+            }
+            std::cout << "Following " << file.name << std::endl;
+            it = files.emplace(pair.first, file).first;
+        }
+        if (!sendAppended(it->second)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LogClient::sendAppended(FollowedFile& file) {
+    struct stat st;
+    if (fstat(file.fd, &st) != 0) {
+        return true;
+    }
+    uint64_t size = static_cast<uint64_t>(st.st_size);
+    
+    if (size < file.offset) {
+        // Truncated in place (e.g. copytruncate rotation): start over
+        std::cout << file.name << " was truncated, following it from the start" << std::endl;
+        if (!sendMessage(socket_, MSG_FILE_RESET, file.name)) {
+            return false;
+        }
+        file.offset = 0;
+    }
+    if (size == file.offset) {
+        return true;
+    }
+    
+    // Only the new bytes
+    if (!sendMessage(socket_, MSG_FILE_START, file.name)) {
+        return false;
+    }
+    std::string chunk(FOLLOW_CHUNK_SIZE, '\0');
+    while (file.offset < size) {
+        size_t wanted = static_cast<size_t>(std::min<uint64_t>(chunk.size(), size - file.offset));
+        ssize_t bytesRead = pread(file.fd, &chunk[0], wanted, static_cast<off_t>(file.offset));
+        if (bytesRead <= 0) {
+            break;
+        }
+        if (!sendMessage(socket_, MSG_FILE_CHUNK, chunk.substr(0, static_cast<size_t>(bytesRead)))) {
+            return false;
+        }
+        file.offset += static_cast<uint64_t>(bytesRead);
+    }
+    
+    char type = 0;
+    std::string message;
+    if (!sendMessage(socket_, MSG_FILE_END, "") || !receiveReply(type, message) || type != MSG_ACK) {
+        std::cerr << "Did not receive acknowledgment for " << file.name
+                  << (type == MSG_ERROR ? ": " + message : "") << std::endl;
+        return false;
+    }
+    return true;
+}
+#endif
+
+bool LogClient::queryAggregates() {
+    if (!sendMessage(socket_, MSG_QUERY, "")) {
+        std::cerr << "Failed to send query" << std::endl;
+        return false;
+    }
+    
+    try {
+        while (true) {
+            char type;
+            std::string message;
+            if (!receiveReply(type, message)) {
+                std::cerr << "Error receiving message from server" << std::endl;
+                return false;
+            }
+            if (type != MSG_RESULT) {
+                std::cerr << (type == MSG_ERROR ? "Server error: " + message
+                                                : std::string("Unexpected message type: ") + type) << std::endl;
+                return false;
+            }
+            if (decoder_.addFrame(message)) {
+                printResult(decoder_.takeResult());
+                return true;
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Invalid result from server: " << e.what() << std::endl;
+        return false;
+    }
 }
 
 bool LogClient::receiveResult(AnalysisResult& result) {
@@ -209,26 +719,165 @@ bool LogClient::receiveResult(AnalysisResult& result) {
         return false;
     }
     
-    char type;
-    std::string message;
+    // Ctrl+C asks the server to stop and send what it has so far
+    cancelRequested = 0;
+    auto previousHandler = std::signal(SIGINT, onInterrupt);
+    bool cancelSent = false;
+    bool received = false;
+    
+    try {
+        while (true) {
+            if (cancelRequested && !cancelSent) {
+                std::cout << "Cancelling: waiting for the result so far (Ctrl+C again to quit)..." << std::endl;
+                sendMessage(socket_, MSG_CANCEL, "");
+                cancelSent = true;
+            }
+            if (!socketReadable(socket_, 200)) {
+                continue;
+            }
+            
+            char type;
+            std::string message;
+            if (!receiveMessage(socket_, type, message)) {
+                std::cerr << "Error receiving message from server" << std::endl;
+                break;
+            }
+            
+            // Progress reports come first, then the result in frames
+            if (type == MSG_PROGRESS) {
+                printProgress(decodeProgress(decoder_, message));
+            }
+            else if (type == MSG_RESULT) {
+                if (decoder_.addFrame(message)) {
+                    result = decoder_.takeResult();
+                    received = true;
+                    break;
+                }
+            }
+            else if (type == MSG_ERROR) {
+                std::cerr << "Server error: " << message << std::endl;
+                break;
+            }
+            else {
+                std::cerr << "Unexpected message type: " << type << std::endl;
+                break;
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Invalid result from server: " << e.what() << std::endl;
+    }
     
-    if (!receiveMessage(socket_, type, message)) {
-        std::cerr << "Error receiving message from server" << std::endl;
+    std::signal(SIGINT, previousHandler);
+    if (received && cancelSent) {
+        std::cout << "Analysis cancelled: the result covers only the data analyzed so far" << std::endl;
+    }
+    return received;
+}
+
+bool LogClient::receiveReply(char& type, std::string& message) {
+    while (receiveMessage(socket_, type, message)) {
+        if (type != MSG_PROGRESS) {
+            return true;
+        }
+        try {
+            printProgress(decodeProgress(decoder_, message));
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Invalid progress report from server: " << e.what() << std::endl;
+            return false;
+        }
+    }
+    return false;
+}
+
+bool LogClient::requestStats(ServerStats& stats) {
+    if (!connected_) {
+        std::cerr << "Not connected to server" << std::endl;
         return false;
     }
     
-    if (type == MSG_RESULT) {
-        result = deserializeResult(message);
-        return true;
+    char type;
+    std::string message;
+    if (!sendMessage(socket_, MSG_STATS, "") || !receiveReply(type, message)) {
+        std::cerr << "Failed to receive stats from server" << std::endl;
+        return false;
     }
-    else if (type == MSG_ERROR) {
-        std::cerr << "Server error: " << message << std::endl;
+    if (type != MSG_STATS) {
+        std::cerr << "Unexpected reply to stats request: " << type << std::endl;
         return false;
     }
+    stats = deserializeStats(message);
+    return true;
+}
+
+void LogClient::printStats(const ServerStats& stats) {
+    std::cout << "\n===== Server Stats =====\n";
+    std::cout << std::left << std::setw(18) << "Stage" << std::right << std::setw(10) << "Count"
+              << std::setw(12) << "p50 (us)" << std::setw(12) << "p90 (us)" << std::setw(12) << "p99 (us)"
+              << std::setw(12) << "max (us)" << std::setw(14) << "total (ms)" << "\n";
+    std::cout << std::string(90, '-') << "\n";
+    for (const auto& stage : stats.stages) {
+        std::cout << std::left << std::setw(18) << stage.name << std::right << std::setw(10) << stage.count
+                  << std::setw(12) << stage.p50Us << std::setw(12) << stage.p90Us << std::setw(12) << stage.p99Us
+                  << std::setw(12) << stage.maxUs << std::setw(14) << stage.totalUs / 1000 << "\n";
+    }
+    std::cout << "\n";
+    for (const auto& counter : stats.counters) {
+        std::cout << std::left << std::setw(24) << counter.first << counter.second << "\n";
+    }
+    for (const auto& gauge : stats.gauges) {
+        std::cout << std::left << std::setw(24) << gauge.first << gauge.second << "\n";
+    }
+    std::cout << std::right << std::endl;
+}
+
+// Format milliseconds as m:ss (or h:mm:ss)
+static std::string formatDuration(uint64_t ms) {
+    uint64_t seconds = ms / 1000;
+    std::ostringstream out;
+    if (seconds >= 3600) {
+        out << seconds / 3600 << ":" << std::setw(2) << std::setfill('0') << (seconds / 60) % 60;
+    }
     else {
-        std::cerr << "Unexpected message type: " << type << std::endl;
-        return false;
+        out << seconds / 60;
+    }
+    out << ":" << std::setw(2) << std::setfill('0') << seconds % 60;
+    return out.str();
+}
+
+void LogClient::printProgress(const AnalysisProgress& progress) {
+    const double MB = 1024.0 * 1024.0;
+    uint64_t total = std::max(progress.bytesExpected, progress.bytesReceived);
+    
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(1) << "Progress: " << progress.bytesAnalyzed / MB;
+    if (total > 0) {
+        line << " of " << total / MB << " MB analyzed ("
+             << std::min(100.0, 100.0 * progress.bytesAnalyzed / total) << "%)";
+    }
+    else {
+        line << " MB analyzed";
+    }
+    line << ", " << progress.top.totalEntries << " records, " << progress.distinctKeys << " keys, "
+         << formatDuration(progress.elapsedMs) << " elapsed";
+    if (progress.remainingMs > 0) {
+        line << ", ~" << formatDuration(progress.remainingMs) << " left";
+    }
+    
+    // Leaders so far
+    std::vector<std::pair<std::string, uint64_t>> top(progress.top.counts.begin(), progress.top.counts.end());
+    std::sort(top.begin(), top.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    if (top.size() > 5) {
+        top.resize(5);
+    }
+    if (!top.empty()) {
+        line << "\n  top:";
+        for (size_t i = 0; i < top.size(); ++i) {
+            line << (i == 0 ? " " : ", ") << top[i].first << " " << top[i].second;
+        }
     }
+    std::cout << line.str() << std::endl;
 }
 
 void LogClient::printResult(const AnalysisResult& result) {
@@ -241,7 +890,7 @@ void LogClient::printResult(const AnalysisResult& result) {
     std::cout << std::string(40, '-') << "\n";
     
     // Find the maximum count for scaling (if we want to add a visual indicator)
-    int maxCount = 0;
+    uint64_t maxCount = 0;
     for (const auto& pair : result.counts) {
         if (pair.second > maxCount) {
             maxCount = pair.second;
@@ -249,7 +898,7 @@ void LogClient::printResult(const AnalysisResult& result) {
     }
     
     // Create a vector of pairs for sorting
-    std::vector<std::pair<std::string, int>> sortedCounts(result.counts.begin(), result.counts.end());
+    std::vector<std::pair<std::string, uint64_t>> sortedCounts(result.counts.begin(), result.counts.end());
     
     // Sort by count (descending)
     std::sort(sortedCounts.begin(), sortedCounts.end(), 
@@ -260,7 +909,7 @@ void LogClient::printResult(const AnalysisResult& result) {
         std::cout << std::setw(30) << std::left << pair.first << pair.second;
         
         // Add a simple visual indicator (20 chars max)
-        int barLength = (pair.second * 20) / (maxCount > 0 ? maxCount : 1);
+        int barLength = static_cast<int>((pair.second * 20) / (maxCount > 0 ? maxCount : 1));
         std::cout << "  " << std::string(barLength, '#');
         
         std::cout << "\n";
@@ -291,7 +940,7 @@ bool LogClient::saveResult(const AnalysisResult& result, const std::string& file
     file << std::string(40, '-') << "\n";
     
     // Create a vector of pairs for sorting
-    std::vector<std::pair<std::string, int>> sortedCounts(result.counts.begin(), result.counts.end());
+    std::vector<std::pair<std::string, uint64_t>> sortedCounts(result.counts.begin(), result.counts.end());
     
     // Sort by count (descending)
     std::sort(sortedCounts.begin(), sortedCounts.end(), 
@@ -340,11 +989,11 @@ std::vector<std::string> listFilesInDirectory(const std::string& directory) {
     
     for (const auto& entry : fs::directory_iterator(directory)) {
         if (fs::is_regular_file(entry)) {
-            // Only include files with expected extensions
-            std::string ext = entry.path().extension().string();
+            // Only include files with expected extensions, possibly compressed
+            std::string ext = fs::path(stripCompressionExtension(entry.path().filename().string())).extension().string();
             std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
             
-            if (ext == ".json" || ext == ".xml" || ext == ".txt") {
+            if (ext == ".json" || ext == ".xml" || ext == ".txt" || ext == ".log") {
                 files.push_back(entry.path().string());
             }
         }
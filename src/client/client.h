@@ -2,9 +2,17 @@
 #define CLIENT_H
 
 #include "common/protocol.h"
+#include "common/result_codec.h"
+#include "common/metrics.h"
 #include <string>
 #include <vector>
 #include <filesystem>
+#include <unordered_map>
+#include <fstream>
+#include <cstdint>
+
+// --dedup cuts files into pieces of at least this size, at record boundaries
+constexpr size_t DEDUP_PIECE_SIZE = 1024 * 1024;
 
 class LogClient {
 public:
@@ -20,12 +28,44 @@ public:
     // Send analysis request
     bool sendRequest(const AnalysisRequest& request);
     
-    // Send log files from a directory
-    bool sendLogFiles(const std::string& directory);
+    // Session mode, between requests: false if the server has ended the
+    // session (idle too long), after printing its reason
+    bool sessionOpen();
+    
+    // Ask for the server's counts over the last minutes of log time (5, 15
+    // or 60) instead of sending logs; the result is read with receiveResult
+    bool sendWindowQuery(AnalysisType type, int minutes);
+    
+    // Send log files from a directory. With dedup, each file is announced
+    // by the content hashes of its pieces first, and only the pieces the
+    // server does not already hold are sent.
+    bool sendLogFiles(const std::string& directory, bool dedup = false);
+    
+    // Signal the end of an upload without sending files (e.g. a query of a
+    // stored dataset only)
+    bool endUpload();
+    
+    // Follow mode: send a directory's files, then keep sending what is appended
+    // to them (watched with inotify) until Ctrl+C; Enter prints the server's
+    // current aggregates. The final result is then read with receiveResult.
+    bool followDirectory(const std::string& directory);
     
-    // Get analysis result
+    // Edge mode: analyze a directory locally and send only the partial result
+    bool sendPartialResult(const std::string& directory, const AnalysisRequest& request);
+    
+    // Get analysis result, printing progress reports as they arrive.
+    // Ctrl+C while waiting asks the server for the result so far.
     bool receiveResult(AnalysisResult& result);
     
+    // Ask the server for its stage latencies, counters and gauges
+    bool requestStats(ServerStats& stats);
+    
+    // Print server stats
+    void printStats(const ServerStats& stats);
+    
+    // Print a progress report
+    void printProgress(const AnalysisProgress& progress);
+    
     // Print analysis result
     void printResult(const AnalysisResult& result);
     
@@ -36,6 +76,35 @@ private:
     // Helper to send a single file
     bool sendFile(const std::string& filepath);
     
+    // Send a file's pieces the server lacks (see MSG_MANIFEST)
+    bool sendFileDeduplicated(const std::string& filepath);
+    
+    // Send size bytes from offset (to the end at most) as one file, and
+    // wait for the acknowledgment
+    bool sendRange(std::ifstream& file, const std::string& filename, uint64_t offset, uint64_t size);
+    
+    // Receive the next message that is not a progress report (those are printed)
+    bool receiveReply(char& type, std::string& message);
+    
+    // A followed file, tracked by inode so renames are not re-sent
+    struct FollowedFile {
+        std::string name;    // Name announced to the server
+        int fd;
+        uint64_t offset;     // Bytes sent so far
+    };
+    
+    // Send new files and appended data; drain and drop files that went away
+    bool scanFollowedFiles(const std::string& directory, std::unordered_map<uint64_t, FollowedFile>& files);
+    
+    // Send what was appended to a file since the last call
+    bool sendAppended(FollowedFile& file);
+    
+    // Ask for the current aggregates and print them
+    bool queryAggregates();
+    
+    // Decoder for progress reports and the result (they share a string table)
+    ResultDecoder decoder_;
+    
     // Socket for server connection
     socket_t socket_;
     
@@ -1,23 +1,58 @@
 #include "client/client.h"
+#include "common/filter.h"
+#include "common/segment_store.h"
 #include <iostream>
 #include <string>
 #include <filesystem>
+#include <fstream>
+#include <sstream>
 #include <algorithm>
+#include <vector>
 
 namespace fs = std::filesystem;
 
 void printUsage(const char* programName) {
-    std::cout << "Usage: " << programName << " <server_ip> <analysis_type> [log_directory] [start_date] [end_date] [output_file]\n";
+    std::cout << "Usage: " << programName << " [options] <server_ip> <analysis_type> [log_directory] [start_date] [end_date] [output_file]\n";
     std::cout << "  server_ip     - IP address of the log analysis server\n";
-    std::cout << "  analysis_type - Type of analysis to perform (user|ip|log_level)\n";
+    std::cout << "  analysis_type - Type of analysis to perform (user|ip|log_level|pattern)\n";
     std::cout << "  log_directory - Optional directory containing log files (default: auto-select a client folder)\n";
     std::cout << "  start_date    - Optional start date for analysis (YYYY-MM-DD)\n";
     std::cout << "  end_date      - Optional end date for analysis (YYYY-MM-DD)\n";
     std::cout << "  output_file   - Optional file to save results (default: do not save)\n";
+    std::cout << "\nOptions:\n";
+    std::cout << "  --edge        - Parse and aggregate locally, send only the partial result\n";
+    std::cout << "  --follow      - Keep sending what is appended to the directory's files (Linux);\n";
+    std::cout << "                  Enter prints the current aggregates, Ctrl+C stops and prints the final result\n";
+    std::cout << "  --progress <seconds> - Progress report interval while the server analyzes (default 1, 0 for none);\n";
+    std::cout << "                  Ctrl+C while waiting cancels and returns the result so far\n";
+    std::cout << "  --window <minutes> - Instead of sending logs, get the server's counts over the last\n";
+    std::cout << "                  5, 15 or 60 minutes (of the entries of --follow uploads)\n";
+    std::cout << "  --stats       - Print the server's per-stage latencies, counters and load (needs only server_ip)\n";
+    std::cout << "  --trace       - Have the server record this request's spans and write them as Chrome trace JSON\n";
+    std::cout << "                  to its trace directory (open in chrome://tracing or ui.perfetto.dev)\n";
+    std::cout << "  --filter <expr> - Count only matching entries, e.g.\n";
+    std::cout << "                  'level in (ERROR,FATAL) and ip in 10.0.0.0/8 and message contains \"timeout\"'\n";
+    std::cout << "                  (fields user, ip, level, message; =, !=, [not] in, contains, and, or, not)\n";
+    std::cout << "  --patterns <file> - For pattern analysis: literals to count in messages, one per line\n";
+    std::cout << "  --pattern <text> - Add one literal (may be repeated)\n";
+    std::cout << "  --group-by <user|level> - Break pattern counts down by user or level\n";
+    std::cout << "  --store-as <name> - Have the server also keep the uploaded logs as a dataset of this name\n";
+    std::cout << "                  (needs a server started with --store-dir; replaces a dataset of that name)\n";
+    std::cout << "  --dataset <name> - Query a dataset stored earlier instead of uploading (log_directory \"\")\n";
+    std::cout << "  --dedup       - Send only the parts of files the server does not already hold (by content\n";
+    std::cout << "                  hash); the rest is analyzed from its cache (needs a server with --store-dir)\n";
+    std::cout << "  --session     - Keep the upload on the server and then read further requests from stdin,\n";
+    std::cout << "                  one per line: <analysis_type> [start_date|-] [end_date|-] [filter]\n";
+    std::cout << "                  (an empty line ends the session; only the first result is saved)\n";
     std::cout << "\nExamples:\n";
     std::cout << "  " << programName << " 127.0.0.1 user\n";
     std::cout << "  " << programName << " 127.0.0.1 ip test_logs/client1 2023-01-01 2023-12-31\n";
     std::cout << "  " << programName << " 127.0.0.1 log_level test_logs/client2 \"\" \"\" results.txt\n";
+    std::cout << "  " << programName << " --window 15 127.0.0.1 ip\n";
+    std::cout << "  " << programName << " --patterns signatures.txt --group-by level 127.0.0.1 pattern logs\n";
+    std::cout << "  " << programName << " --store-as march 127.0.0.1 user logs/march\n";
+    std::cout << "  " << programName << " --dataset march 127.0.0.1 ip \"\" 2023-03-10 2023-03-12\n";
+    std::cout << "  " << programName << " --session 127.0.0.1 user logs/march\n";
 }
 
 AnalysisType parseAnalysisType(const std::string& typeStr) {
@@ -27,21 +62,195 @@ AnalysisType parseAnalysisType(const std::string& typeStr) {
     if (typeLower == "user") return AnalysisType::USER;
     if (typeLower == "ip") return AnalysisType::IP;
     if (typeLower == "log_level") return AnalysisType::LOG_LEVEL;
+    if (typeLower == "pattern") return AnalysisType::PATTERN;
     
     throw std::runtime_error("Invalid analysis type: " + typeStr);
 }
 
+// Session mode: further requests over the uploaded logs, one per line of
+// stdin, until an empty line or end of input. Patterns and grouping stay
+// those of the first request.
+static bool runSession(LogClient& client, AnalysisRequest request) {
+    std::cout << "\nSession open: enter <analysis_type> [start_date|-] [end_date|-] [filter], "
+              << "or an empty line to end" << std::endl;
+    std::string line;
+    while (std::cout << "> " << std::flush && std::getline(std::cin, line)) {
+        std::istringstream fields(line);
+        std::string type, start, end;
+        if (!(fields >> type)) {
+            break;
+        }
+        fields >> start >> end;
+        std::string filter;
+        std::getline(fields, filter);
+        filter.erase(0, filter.find_first_not_of(' '));
+
+        try {
+            request.type = parseAnalysisType(type);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            continue;
+        }
+        request.startDate = (start.empty() || start == "-") ? std::nullopt : std::optional<std::string>(start);
+        request.endDate = (end.empty() || end == "-") ? std::nullopt : std::optional<std::string>(end);
+        request.filter = filter;
+        request.expectedBytes = 0;
+        std::string filterError;
+        if (!FilterProgram::compile(filter, filterError)) {
+            std::cerr << "Error: Invalid filter: " << filterError << std::endl;
+            continue;
+        }
+        if (request.type == AnalysisType::PATTERN && request.patterns.empty()) {
+            std::cerr << "Error: Pattern analysis needs the session to be opened with --patterns or --pattern"
+                      << std::endl;
+            continue;
+        }
+
+        AnalysisResult result;
+        if (!client.sessionOpen() || !client.sendRequest(request) || !client.receiveResult(result)) {
+            return false;
+        }
+        client.printResult(result);
+    }
+    return true;
+}
+
 int main(int argc, char* argv[]) {
+    // Separate option flags (--name) from positional arguments
+    std::vector<std::string> args;
+    bool edgeMode = false;
+    bool followMode = false;
+    double progressSeconds = 1.0;
+    int windowMinutes = 0;
+    bool statsMode = false;
+    bool traceMode = false;
+    std::string filter;
+    std::vector<std::string> patterns;
+    PatternGroup patternGroup = PatternGroup::NONE;
+    std::string storeAs;
+    std::string dataset;
+    bool dedupMode = false;
+    bool sessionMode = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--edge") {
+            edgeMode = true;
+        }
+        else if (arg == "--follow") {
+            followMode = true;
+        }
+        else if (arg == "--stats") {
+            statsMode = true;
+        }
+        else if (arg == "--trace") {
+            traceMode = true;
+        }
+        else if (arg == "--progress" && i + 1 < argc) {
+            progressSeconds = std::stod(argv[++i]);
+        }
+        else if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        }
+        else if (arg == "--patterns" && i + 1 < argc) {
+            std::ifstream file(argv[++i]);
+            if (!file) {
+                std::cerr << "Error: Cannot open pattern file: " << argv[i] << "\n";
+                return 1;
+            }
+            std::string line;
+            while (std::getline(file, line)) {
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                if (!line.empty()) {
+                    patterns.push_back(line);
+                }
+            }
+        }
+        else if (arg == "--pattern" && i + 1 < argc) {
+            patterns.push_back(argv[++i]);
+        }
+        else if (arg == "--group-by" && i + 1 < argc) {
+            std::string group = argv[++i];
+            if (group == "user") {
+                patternGroup = PatternGroup::USER;
+            }
+            else if (group == "level") {
+                patternGroup = PatternGroup::LEVEL;
+            }
+            else {
+                std::cerr << "Error: --group-by takes user or level\n";
+                return 1;
+            }
+        }
+        else if (arg == "--store-as" && i + 1 < argc) {
+            storeAs = argv[++i];
+        }
+        else if (arg == "--dataset" && i + 1 < argc) {
+            dataset = argv[++i];
+        }
+        else if (arg == "--dedup") {
+            dedupMode = true;
+        }
+        else if (arg == "--session") {
+            sessionMode = true;
+        }
+        else if (arg == "--window" && i + 1 < argc) {
+            windowMinutes = std::stoi(argv[++i]);
+        }
+        else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+        else {
+            args.push_back(arg);
+        }
+    }
+    
+    // Stats: no analysis involved
+    if (statsMode && !args.empty()) {
+        LogClient client;
+        ServerStats stats;
+        if (!client.connect(args[0]) || !client.requestStats(stats)) {
+            return 1;
+        }
+        client.printStats(stats);
+        client.disconnect();
+        return 0;
+    }
+    
     // Check minimum required arguments
-    if (argc < 3) {
+    if (args.size() < 2 || (edgeMode && followMode) ||
+        ((!dataset.empty() || !storeAs.empty()) && (edgeMode || followMode)) ||
+        (!dataset.empty() && !storeAs.empty()) ||
+        (dedupMode && (edgeMode || followMode || !dataset.empty() || !storeAs.empty())) ||
+        (sessionMode && (edgeMode || followMode || dedupMode || !dataset.empty() || !storeAs.empty()))) {
         printUsage(argv[0]);
         return 1;
     }
     
     try {
         // Parse command line arguments
-        std::string serverIP = argv[1];
-        AnalysisType analysisType = parseAnalysisType(argv[2]);
+        std::string serverIP = args[0];
+        AnalysisType analysisType = parseAnalysisType(args[1]);
+        
+        // Window query: no logs are sent
+        if (windowMinutes > 0) {
+            LogClient client;
+            if (!client.connect(serverIP) || !client.sendWindowQuery(analysisType, windowMinutes)) {
+                return 1;
+            }
+            AnalysisResult result;
+            if (!client.receiveResult(result)) {
+                return 1;
+            }
+            std::cout << "\nCounts over the last " << windowMinutes << " minutes of log time" << std::endl;
+            client.printResult(result);
+            client.disconnect();
+            return 0;
+        }
         
         // Optional parameters
         std::string logDirectory;
@@ -49,9 +258,12 @@ int main(int argc, char* argv[]) {
         std::optional<std::string> endDate;
         std::optional<std::string> outputFile;
         
-        // Determine log directory (auto-select or user-specified)
-        if (argc > 3 && argv[3][0] != '\0') {
-            logDirectory = argv[3];
+        // Determine log directory (auto-select or user-specified; none for a dataset)
+        if (!dataset.empty()) {
+            logDirectory.clear();
+        }
+        else if (args.size() > 2 && !args[2].empty()) {
+            logDirectory = args[2];
         } else {
             // Try to auto-select a client folder from test_logs
             logDirectory = getRandomClientFolder("test_logs");
@@ -63,21 +275,21 @@ int main(int argc, char* argv[]) {
         }
         
         // Parse date range if provided
-        if (argc > 4 && argv[4][0] != '\0') {
-            startDate = argv[4];
+        if (args.size() > 3 && !args[3].empty()) {
+            startDate = args[3];
         }
         
-        if (argc > 5 && argv[5][0] != '\0') {
-            endDate = argv[5];
+        if (args.size() > 4 && !args[4].empty()) {
+            endDate = args[4];
         }
         
         // Parse output file if provided
-        if (argc > 6 && argv[6][0] != '\0') {
-            outputFile = argv[6];
+        if (args.size() > 5 && !args[5].empty()) {
+            outputFile = args[5];
         }
         
         // Check if log directory exists
-        if (!fs::exists(logDirectory) || !fs::is_directory(logDirectory)) {
+        if (dataset.empty() && (!fs::exists(logDirectory) || !fs::is_directory(logDirectory))) {
             std::cerr << "Error: Log directory not found: " << logDirectory << std::endl;
             return 1;
         }
@@ -87,6 +299,44 @@ int main(int argc, char* argv[]) {
         request.type = analysisType;
         request.startDate = startDate;
         request.endDate = endDate;
+        request.progressIntervalMs = static_cast<uint32_t>(std::max(0.0, progressSeconds) * 1000);
+        request.follow = followMode;
+        request.trace = traceMode;
+        request.filter = filter;
+        request.patterns = patterns;
+        request.patternGroup = patternGroup;
+        request.storeAs = storeAs;
+        request.dataset = dataset;
+        request.session = sessionMode;
+        if (analysisType == AnalysisType::PATTERN && (patterns.empty() || patterns.size() > MAX_PATTERNS)) {
+            std::cerr << "Error: Pattern analysis needs 1 to " << MAX_PATTERNS << " patterns (--patterns or --pattern)\n";
+            return 1;
+        }
+        if (patternBytes(patterns) > MAX_PATTERN_BYTES) {
+            std::cerr << "Error: Patterns add up to " << patternBytes(patterns) << " bytes, over the limit of "
+                      << MAX_PATTERN_BYTES << "\n";
+            return 1;
+        }
+        std::string datasetDir;
+        const std::string& datasetName = storeAs.empty() ? dataset : storeAs;
+        if (!datasetName.empty() && !datasetPath("", datasetName, datasetDir)) {
+            std::cerr << "Error: Invalid dataset name: " << datasetName
+                      << " (letters, digits, '_', '-' and '.', not starting with '.')" << std::endl;
+            return 1;
+        }
+        std::string filterError;
+        if (!FilterProgram::compile(filter, filterError)) {
+            std::cerr << "Error: Invalid filter: " << filterError << std::endl;
+            return 1;
+        }
+        if (!edgeMode && !followMode && dataset.empty()) {
+            // Lets the server estimate the time remaining before the upload ends
+            for (const auto& file : listFilesInDirectory(logDirectory)) {
+                std::error_code error;
+                uintmax_t size = fs::file_size(file, error);
+                request.expectedBytes += error ? 0 : size;
+            }
+        }
         
         // Create client and connect to server
         LogClient client;
@@ -100,10 +350,29 @@ int main(int argc, char* argv[]) {
             return 1;
         }
         
-        // Send log files
-        std::cout << "Sending log files from directory: " << logDirectory << std::endl;
-        if (!client.sendLogFiles(logDirectory)) {
-            return 1;
+        // Send log files (or, in edge mode, a locally computed partial result)
+        if (!dataset.empty()) {
+            std::cout << "Querying stored dataset: " << dataset << std::endl;
+            if (!client.endUpload()) {
+                return 1;
+            }
+        }
+        else if (edgeMode) {
+            std::cout << "Analyzing log files locally from directory: " << logDirectory << std::endl;
+            if (!client.sendPartialResult(logDirectory, request)) {
+                return 1;
+            }
+        }
+        else if (followMode) {
+            if (!client.followDirectory(logDirectory)) {
+                return 1;
+            }
+        }
+        else {
+            std::cout << "Sending log files from directory: " << logDirectory << std::endl;
+            if (!client.sendLogFiles(logDirectory, dedupMode)) {
+                return 1;
+            }
         }
         
         // Receive analysis result
@@ -121,6 +390,10 @@ int main(int argc, char* argv[]) {
             client.saveResult(result, outputFile.value());
         }
         
+        if (sessionMode && !runSession(client, request)) {
+            return 1;
+        }
+        
         // Disconnect from server
         client.disconnect();
         
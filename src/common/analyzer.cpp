@@ -0,0 +1,858 @@
+#include "analyzer.h"
+#include "log_parser.h"
+#include "metrics.h"
+#include "trace.h"
+#include "filter.h"
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <memory> // For std::shared_ptr
+#include <algorithm>
+#include <filesystem>
+
+// Timing spans kept for busySecondsBefore; later jobs only add to the total
+constexpr size_t MAX_TASK_SPANS = 65536;
+
+// Compressed input is read in pieces of this size, decompressed members are
+// grouped into jobs of about DECOMPRESS_GROUP_SIZE compressed bytes, and the
+// text is parsed in pieces of about DECOMPRESSED_PIECE_SIZE
+constexpr size_t COMPRESSED_READ_SIZE = 1024 * 1024;
+constexpr uint64_t DECOMPRESS_GROUP_SIZE = 1024 * 1024;
+constexpr size_t DECOMPRESSED_PIECE_SIZE = 1024 * 1024;
+
+// Members decompressed out of order wait here until the ones before them
+// are done, so that records spanning two members are put back together
+struct LogAnalyzer::DecompressedStream {
+    std::string name;
+    std::unique_ptr<LogParser> parser;
+    EntrySink sink;
+    std::mutex mutex;
+    std::vector<std::string> members;
+    std::vector<bool> ready;
+    size_t next = 0;
+    std::string pending;   // Text after the last record boundary handed out
+};
+
+LogAnalyzer::LogAnalyzer(const AnalysisRequest& request)
+    : request_(request), ownedPool_(std::make_unique<ThreadPool>()), pool_(ownedPool_.get()),
+      queue_(0), outstanding_(0), cancelled_(false), pendingBytes_(0), processedBytes_(0),
+      blocksScanned_(0), blocksSkipped_(0),
+      untrackedBusy_(Clock::duration::zero()) {
+    // Initialize result
+    result_.type = request_.type;
+    result_.totalEntries = 0;
+    for (size_t node = 0; pool_->nodeCount() > 1 && node < pool_->nodeCount(); ++node) {
+        nodeCounts_.push_back(std::make_unique<NodeCounts>());
+    }
+    compileFilter();
+    if (request_.type == AnalysisType::PATTERN) {
+        patterns_ = std::make_unique<PatternMatcher>(request_.patterns);
+    }
+}
+
+LogAnalyzer::LogAnalyzer(const AnalysisRequest& request, ThreadPool& pool, ThreadPool::QueueId queue)
+    : request_(request), pool_(&pool), queue_(queue), outstanding_(0), cancelled_(false), pendingBytes_(0), processedBytes_(0),
+      blocksScanned_(0), blocksSkipped_(0),
+      untrackedBusy_(Clock::duration::zero()) {
+    // Initialize result
+    result_.type = request_.type;
+    result_.totalEntries = 0;
+    for (size_t node = 0; pool_->nodeCount() > 1 && node < pool_->nodeCount(); ++node) {
+        nodeCounts_.push_back(std::make_unique<NodeCounts>());
+    }
+    compileFilter();
+    if (request_.type == AnalysisType::PATTERN) {
+        patterns_ = std::make_unique<PatternMatcher>(request_.patterns);
+    }
+}
+
+void LogAnalyzer::compileFilter() {
+    segmentTimesInRange_ = storedTimeRange(request_.startDate, request_.endDate, segmentFirstTime_, segmentLastTime_);
+    if (request_.filter.empty() && !request_.startDate && !request_.endDate) {
+        return;
+    }
+    // Requests are validated before they get here; a filter that does not
+    // compile selects nothing rather than everything (every job is skipped)
+    std::string error;
+    filter_ = FilterProgram::compile(request_.filter, error);
+    if (!filter_) {
+        std::cerr << "Invalid filter: " << error << std::endl;
+        cancelled_ = true;
+        return;
+    }
+    if (!request_.filter.empty()) {
+        segmentFilter_ = FilterProgram::compile(request_.filter, error);
+    }
+    filter_->restrictDates(request_.startDate, request_.endDate);
+}
+
+LogAnalyzer::~LogAnalyzer() {
+    // Jobs reference this analyzer, so they must all have finished
+    std::unique_lock<std::mutex> lock(resultMutex_);
+    doneCondition_.wait(lock, [this]() { return outstanding_ == 0; });
+}
+
+const std::pmr::string& LogAnalyzer::getKeyForEntry(const LogEntry& entry) {
+    switch (request_.type) {
+        case AnalysisType::USER:
+            return entry.user;
+        case AnalysisType::IP:
+            return entry.ip;
+        case AnalysisType::LOG_LEVEL:
+            return entry.level;
+        default:
+            return entry.user; // Default to user
+    }
+}
+
+uint64_t LogAnalyzer::countEntries(const std::pmr::vector<LogEntry>& entries, const FilterProgram* filter,
+                                   Counts& counts) {
+    std::pmr::vector<uint32_t> selection(counts.get_allocator().resource());
+    if (filter) {
+        filter->select(entries, selection);
+    }
+    if (patterns_) {
+        countPatterns(entries, filter ? &selection : nullptr, counts);
+    }
+    else if (filter) {
+        for (uint32_t index : selection) {
+            counts[getKeyForEntry(entries[index])]++;
+        }
+    }
+    else {
+        for (const auto& entry : entries) {
+            counts[getKeyForEntry(entry)]++;
+        }
+    }
+    return filter ? selection.size() : entries.size();
+}
+
+void LogAnalyzer::countPatterns(const std::pmr::vector<LogEntry>& entries,
+                                const std::pmr::vector<uint32_t>* selection, Counts& counts) {
+    std::pmr::memory_resource* arena = counts.get_allocator().resource();
+    std::pmr::vector<uint32_t> countedAt(patterns_->patternCount(), 0, arena);  // Last entry counted, + 1
+    std::pmr::string key(arena);
+    const PatternGroup group = request_.patternGroup;
+    uint32_t entryNumber = 0;
+
+    auto countEntry = [&](const LogEntry& entry) {
+        ++entryNumber;
+        patterns_->scan(entry.message, [&](size_t pattern) {
+            if (countedAt[pattern] == entryNumber) {
+                return;
+            }
+            countedAt[pattern] = entryNumber;
+            if (group == PatternGroup::NONE) {
+                key.assign(patterns_->pattern(pattern));
+            }
+            else {
+                key.assign(group == PatternGroup::USER ? entry.user : entry.level);
+                key += ": ";
+                key += patterns_->pattern(pattern);
+            }
+            counts[key]++;
+        });
+    };
+    if (selection) {
+        for (uint32_t index : *selection) {
+            countEntry(entries[index]);
+        }
+    }
+    else {
+        for (const auto& entry : entries) {
+            countEntry(entry);
+        }
+    }
+}
+
+AnalysisResult LogAnalyzer::analyze(const std::vector<std::string>& logFiles) {
+    for (const auto& filename : logFiles) {
+        submitJob([this, filename]() { return this->analyzeFile(filename, EntrySink()); }, 0, filename);
+    }
+    return finish();
+}
+
+AnalysisResult LogAnalyzer::analyze(std::vector<LogSource>& sources) {
+    for (auto& source : sources) {
+        submit(std::move(source));
+    }
+    sources.clear();
+    return finish();
+}
+
+void LogAnalyzer::submit(LogSource source) {
+    size_t bytes = source.content.size();
+    uint64_t size = bytes;
+    if (!source.spillPath.empty()) {
+        std::error_code error;
+        size = std::filesystem::file_size(source.spillPath, error);
+        if (error) {
+            size = 0;
+        }
+    }
+    auto src = std::make_shared<LogSource>(std::move(source));
+    submitJob([this, src, size]() {
+        Counts counts(ArenaScope::current());
+        AnalysisResult remote;
+        if (delegate_ && !src->sink && delegate_(*src, remote)) {
+            for (const auto& pair : remote.counts) {
+                counts.emplace(pair.first, pair.second);
+            }
+            std::lock_guard<std::mutex> lock(resultMutex_);
+            result_.totalEntries += remote.totalEntries;
+        }
+        else if (!src->spillPath.empty()) {
+            counts = this->analyzeFile(src->spillPath, src->sink);
+        }
+        else if (detectCompression(src->content) != Compression::NONE) {
+            // Shared with the decompression jobs, which outlive this one
+            auto data = std::make_shared<const std::string>(std::move(src->content));
+            this->analyzeCompressed(src->name, detectCompression(*data), data->size(), [data]() -> ReadRange {
+                return [data](uint64_t offset, size_t size) {
+                    return offset < data->size() ? data->substr(offset, size) : std::string();
+                };
+            }, src->sink);
+        }
+        else {
+            counts = this->analyzeContent(src->name, src->content, src->sink);
+        }
+        
+        // Release the buffer as soon as it has been parsed
+        std::string().swap(src->content);
+        processedBytes_ += size;
+        return counts;
+    }, bytes, src->name);
+}
+
+void LogAnalyzer::submitSegment(const std::string& path, ResultSink sink) {
+    std::string label = std::filesystem::path(path).filename().string();
+    submitJob([this, path, sink]() { return this->analyzeSegment(path, sink); }, 0, label);
+}
+
+void LogAnalyzer::submitTable(std::shared_ptr<const MemoryTable> table) {
+    for (size_t index = 0; index < table->blockCount(); ++index) {
+        submitJob([this, table, index]() { return this->analyzeTableBlock(*table, index); }, 0,
+                  "block " + std::to_string(index));
+    }
+}
+
+void LogAnalyzer::submitJob(std::function<Counts()> job, size_t bytes, const std::string& label) {
+    {
+        std::lock_guard<std::mutex> lock(resultMutex_);
+        outstanding_++;
+    }
+    pendingBytes_ += bytes;
+    
+    // The label is only kept for traced requests
+    const RequestTrace* trace = trace_.get();
+    std::string traceLabel = trace ? label : std::string();
+    auto queued = Clock::now();
+    pool_->addTask(queue_, [this, job = std::move(job), bytes, queued, trace, traceLabel]() mutable {
+        // Everything the job allocates there is released in one go after the merge
+        ArenaScope arena;
+        Counts counts(ArenaScope::current());
+        if (!cancelled_) {
+            auto start = Clock::now();
+            Metrics::record(MetricStage::QUEUE_WAIT, start - queued);
+            counts = job();
+            auto end = Clock::now();
+            if (trace) {
+                trace->record("queue_wait", queued, start, traceLabel);
+                trace->record("analyze", start, end, traceLabel);
+            }
+            
+            std::lock_guard<std::mutex> lock(spansMutex_);
+            if (taskSpans_.size() < MAX_TASK_SPANS) {
+                taskSpans_.emplace_back(start, end);
+            }
+            else {
+                untrackedBusy_ += end - start;
+            }
+        }
+        
+        // Drop the job (and the buffer it holds) before reporting the bytes free
+        job = nullptr;
+        pendingBytes_ -= bytes;
+        if (bytes > 0 && releaseCallback_) {
+            releaseCallback_(bytes);
+        }
+        completeJob(counts);
+    });
+}
+
+void LogAnalyzer::completeJob(const Counts& counts) {
+    auto merge = [&counts](std::unordered_map<std::string, uint64_t>& into) {
+        std::string key;  // Reused: keys already in the map cost no allocation
+        for (const auto& pair : counts) {
+            key.assign(pair.first);
+            into[key] += pair.second;
+        }
+    };
+    if (!nodeCounts_.empty()) {
+        // Into this node's partial: workers of other nodes are not held up
+        NodeCounts& node = *nodeCounts_[ThreadPool::currentNode() % nodeCounts_.size()];
+        StageTimer timer(MetricStage::MERGE);
+        TraceSpan span(trace_.get(), "merge");
+        std::lock_guard<std::mutex> lock(node.mutex);
+        merge(node.counts);
+    }
+
+    std::function<void(const AnalysisResult&)> done;
+    AnalysisResult result;
+    {
+        // Merge file results with overall results
+        std::lock_guard<std::mutex> lock(resultMutex_);
+        if (nodeCounts_.empty()) {
+            StageTimer timer(MetricStage::MERGE);
+            TraceSpan span(trace_.get(), "merge");
+            merge(result_.counts);
+        }
+        
+        // No report for the job that completes the analysis: its result follows
+        --outstanding_;
+        if (progressCallback_ && (outstanding_ > 0 || !doneCallback_)) {
+            progressCallback_();
+        }
+        if (outstanding_ > 0) {
+            return;
+        }
+        mergeNodes();
+        doneCallback_.swap(done);
+        if (done) {
+            result = result_;
+        }
+        doneCondition_.notify_all();
+    }
+    
+    // Must not touch members from here on: the callback may destroy the analyzer
+    if (done) {
+        done(result);
+    }
+}
+
+AnalysisResult LogAnalyzer::finish() {
+    std::unique_lock<std::mutex> lock(resultMutex_);
+    doneCondition_.wait(lock, [this]() { return outstanding_ == 0; });
+    return result_;
+}
+
+void LogAnalyzer::finishAsync(std::function<void(const AnalysisResult&)> done) {
+    {
+        std::lock_guard<std::mutex> lock(resultMutex_);
+        if (outstanding_ > 0) {
+            doneCallback_ = std::move(done);
+            return;
+        }
+    }
+    done(result_);
+}
+
+void LogAnalyzer::cancel() {
+    cancelled_ = true;
+}
+
+size_t LogAnalyzer::pendingBytes() const {
+    return pendingBytes_;
+}
+
+uint64_t LogAnalyzer::processedBytes() const {
+    return processedBytes_;
+}
+
+uint64_t LogAnalyzer::blocksScanned() const {
+    return blocksScanned_;
+}
+
+uint64_t LogAnalyzer::blocksSkipped() const {
+    return blocksSkipped_;
+}
+
+void LogAnalyzer::mergeNodes() {
+    if (nodeCounts_.empty()) {
+        return;
+    }
+    StageTimer timer(MetricStage::MERGE);
+    TraceSpan span(trace_.get(), "merge_nodes");
+    for (auto& node : nodeCounts_) {
+        std::lock_guard<std::mutex> lock(node->mutex);
+        if (result_.counts.empty()) {
+            result_.counts.swap(node->counts);
+            continue;
+        }
+        for (const auto& pair : node->counts) {
+            result_.counts[pair.first] += pair.second;
+        }
+        node->counts.clear();
+    }
+}
+
+AnalysisResult LogAnalyzer::current() {
+    std::lock_guard<std::mutex> lock(resultMutex_);
+    mergeNodes();
+    return result_;
+}
+
+AnalysisResult LogAnalyzer::snapshot(size_t topK, size_t& distinctKeys) {
+    using Entry = std::pair<uint64_t, const std::string*>;
+    auto greater = [](const Entry& a, const Entry& b) { return a.first > b.first; };
+
+    AnalysisResult top;
+    std::lock_guard<std::mutex> lock(resultMutex_);
+    mergeNodes();
+    top.type = result_.type;
+    top.totalEntries = result_.totalEntries;
+    distinctKeys = result_.counts.size();
+
+    // Min-heap of the largest counts: one pass, no copy of the whole map
+    std::vector<Entry> heap;
+    heap.reserve(topK + 1);
+    for (const auto& pair : result_.counts) {
+        if (heap.size() < topK) {
+            heap.emplace_back(pair.second, &pair.first);
+            std::push_heap(heap.begin(), heap.end(), greater);
+        }
+        else if (topK > 0 && pair.second > heap.front().first) {
+            std::pop_heap(heap.begin(), heap.end(), greater);
+            heap.back() = Entry(pair.second, &pair.first);
+            std::push_heap(heap.begin(), heap.end(), greater);
+        }
+    }
+    for (const auto& entry : heap) {
+        top.counts.emplace(*entry.second, entry.first);
+    }
+    return top;
+}
+
+void LogAnalyzer::setProgressCallback(std::function<void()> progress) {
+    progressCallback_ = std::move(progress);
+}
+
+void LogAnalyzer::setReleaseCallback(std::function<void(size_t bytes)> released) {
+    releaseCallback_ = std::move(released);
+}
+
+void LogAnalyzer::setDelegate(SourceDelegate delegate) {
+    delegate_ = std::move(delegate);
+}
+
+void LogAnalyzer::setEntrySink(EntrySink sink) {
+    entrySink_ = std::move(sink);
+}
+
+void LogAnalyzer::setTrace(std::shared_ptr<const RequestTrace> trace) {
+    trace_ = std::move(trace);
+}
+
+double LogAnalyzer::busySeconds() const {
+    double untracked;
+    {
+        std::lock_guard<std::mutex> lock(spansMutex_);
+        untracked = std::chrono::duration<double>(untrackedBusy_).count();
+    }
+    return busySecondsBefore(Clock::time_point::max()) + untracked;
+}
+
+double LogAnalyzer::busySecondsBefore(Clock::time_point until) const {
+    std::lock_guard<std::mutex> lock(spansMutex_);
+    Clock::duration busy = Clock::duration::zero();
+    for (const auto& span : taskSpans_) {
+        auto end = std::min(span.second, until);
+        if (end > span.first) {
+            busy += end - span.first;
+        }
+    }
+    return std::chrono::duration<double>(busy).count();
+}
+
+LogAnalyzer::Counts LogAnalyzer::analyzeFile(const std::string& filename, const EntrySink& sink) {
+    Counts counts(ArenaScope::current());
+    
+    // Compressed files are streamed from disk rather than read whole
+    Compression compression = detectFileCompression(filename);
+    if (compression != Compression::NONE) {
+        std::error_code error;
+        uint64_t size = std::filesystem::file_size(filename, error);
+        if (error) {
+            std::cerr << "Error opening file: " << filename << std::endl;
+            return counts;
+        }
+        analyzeCompressed(filename, compression, size, [filename]() -> ReadRange {
+            auto file = std::make_shared<std::ifstream>(filename, std::ios::binary);
+            return [file](uint64_t offset, size_t size) {
+                std::string data(size, '\0');
+                file->clear();
+                file->seekg(static_cast<std::streamoff>(offset));
+                file->read(&data[0], static_cast<std::streamsize>(size));
+                data.resize(static_cast<size_t>(std::max<std::streamsize>(file->gcount(), 0)));
+                return data;
+            };
+        }, sink);
+        return counts;
+    }
+    
+    // Read file content
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return counts;
+    }
+    
+    std::string content((std::istreambuf_iterator<char>(file)),
+                       std::istreambuf_iterator<char>());
+    
+    return analyzeContent(filename, content, sink);
+}
+
+void LogAnalyzer::analyzeCompressed(const std::string& name, Compression compression, uint64_t size,
+                                     std::function<ReadRange()> open, const EntrySink& sink) {
+    if (!compressionSupported(compression)) {
+        std::cerr << "Skipping " << name << ": " << compressionName(compression)
+                  << " input is not supported by this build" << std::endl;
+        return;
+    }
+
+    // Independent members (BGZF blocks, zstd frames) are grouped into jobs
+    ReadRange read = open();
+    std::vector<uint64_t> offsets = findMemberOffsets(compression, size, read);
+    std::vector<std::pair<uint64_t, uint64_t>> groups;
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        if (groups.empty() || offsets[i] - groups.back().first >= DECOMPRESS_GROUP_SIZE) {
+            groups.emplace_back(offsets[i], size);
+        }
+        if (groups.size() > 1) {
+            groups[groups.size() - 2].second = groups.back().first;
+        }
+    }
+
+    if (groups.size() > 1) {
+        auto stream = std::make_shared<DecompressedStream>();
+        stream->name = name;
+        stream->parser = LogParser::createParser(name);
+        stream->sink = sink;
+        stream->members.resize(groups.size());
+        stream->ready.resize(groups.size(), false);
+        for (size_t i = 0; i < groups.size(); ++i) {
+            uint64_t start = groups[i].first;
+            uint64_t length = groups[i].second - start;
+            submitJob([this, open, stream, compression, i, start, length]() {
+                std::string text;
+                try {
+                    std::string input = open()(start, static_cast<size_t>(length));
+                    Decompressor decompressor(compression);
+                    decompressor.feed(input.data(), input.size(),
+                                      [&text](const char* data, size_t size) { text.append(data, size); });
+                }
+                catch (const std::exception& e) {
+                    Metrics::add(MetricCounter::PARSE_ERRORS, 1);
+                    std::cerr << "Error decompressing " << stream->name << " at offset " << start << ": "
+                              << e.what() << std::endl;
+                }
+                deliverMember(stream, i, std::move(text));
+                return Counts();
+            }, 0, name);
+        }
+        return;
+    }
+
+    // One stream: parse jobs start on the first pieces while the rest is decompressed
+    auto parser = LogParser::createParser(name);
+    std::string pending;
+    try {
+        Decompressor decompressor(compression);
+        for (uint64_t offset = 0; offset < size && !cancelled_; offset += COMPRESSED_READ_SIZE) {
+            std::string input = read(offset, COMPRESSED_READ_SIZE);
+            if (input.empty()) {
+                break;
+            }
+            decompressor.feed(input.data(), input.size(), [&](const char* data, size_t length) {
+                pending.append(data, length);
+                if (pending.size() >= DECOMPRESSED_PIECE_SIZE) {
+                    size_t boundary = parser->lastRecordBoundary(pending);
+                    if (boundary > 0) {
+                        submitText(name, pending.substr(0, boundary), sink);
+                        pending.erase(0, boundary);
+                    }
+                }
+            });
+        }
+        if (!decompressor.finished()) {
+            std::cerr << "Warning: " << name << " is truncated" << std::endl;
+        }
+    }
+    catch (const std::exception& e) {
+        Metrics::add(MetricCounter::PARSE_ERRORS, 1);
+        std::cerr << "Error decompressing " << name << ": " << e.what() << std::endl;
+    }
+    if (!pending.empty()) {
+        submitText(name, std::move(pending), sink);
+    }
+}
+
+void LogAnalyzer::deliverMember(const std::shared_ptr<DecompressedStream>& stream, size_t index, std::string text) {
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    stream->members[index] = std::move(text);
+    stream->ready[index] = true;
+
+    // Complete records go to parse jobs as soon as everything before them is in
+    while (stream->next < stream->members.size() && stream->ready[stream->next]) {
+        stream->pending += stream->members[stream->next];
+        std::string().swap(stream->members[stream->next]);
+        stream->next++;
+
+        bool last = stream->next == stream->members.size();
+        if (stream->pending.size() >= DECOMPRESSED_PIECE_SIZE || last) {
+            size_t boundary = last ? stream->pending.size() : stream->parser->lastRecordBoundary(stream->pending);
+            if (boundary > 0) {
+                submitText(stream->name, stream->pending.substr(0, boundary), stream->sink);
+                stream->pending.erase(0, boundary);
+            }
+        }
+    }
+}
+
+void LogAnalyzer::submitText(const std::string& name, std::string text, const EntrySink& sink) {
+    auto piece = std::make_shared<std::string>(std::move(text));
+    submitJob([this, name, piece, sink]() { return this->analyzeContent(name, *piece, sink); }, 0, name);
+}
+
+// Records counter of the parser createParser picks for a format
+static MetricCounter recordsCounter(LogFormat format) {
+    switch (format) {
+        case LogFormat::JSON: return MetricCounter::RECORDS_JSON;
+        case LogFormat::XML: return MetricCounter::RECORDS_XML;
+        default: return MetricCounter::RECORDS_TXT;
+    }
+}
+
+LogAnalyzer::Counts LogAnalyzer::analyzeContent(const std::string& name, const std::string& content,
+                                                const EntrySink& sink) {
+    // Entries and counts are made in the job's arena
+    std::pmr::memory_resource* arena = ArenaScope::current();
+    Counts counts(arena);
+    uint64_t entriesProcessed = 0;
+    
+    try {
+        // Create appropriate parser based on file extension
+        auto parser = LogParser::createParser(name);
+        
+        // Parse log entries
+        auto parseStart = Clock::now();
+        std::pmr::vector<LogEntry> entries(arena);
+        parser->parseInto(content, entries);
+        auto aggregateStart = Clock::now();
+        Metrics::record(MetricStage::PARSE, aggregateStart - parseStart);
+        Metrics::add(MetricCounter::BYTES_PARSED, content.size());
+        Metrics::add(recordsCounter(LogParser::detectFormat(name)), entries.size());
+        if (entrySink_) {
+            entrySink_(entries);
+        }
+        if (sink) {
+            sink(entries);
+        }
+        
+        // Count based on analysis type, over the entries that pass the
+        // filter (evaluated on the whole batch at once)
+        entriesProcessed = countEntries(entries, filter_.get(), counts);
+        Metrics::record(MetricStage::AGGREGATE, Clock::now() - aggregateStart);
+        
+        // Update total entries
+        std::lock_guard<std::mutex> lock(resultMutex_);
+        result_.totalEntries += entriesProcessed;
+    }
+    catch (const std::exception& e) {
+        Metrics::add(MetricCounter::PARSE_ERRORS, 1);
+        std::cerr << "Error processing file " << name << ": " << e.what() << std::endl;
+    }
+    
+    return counts;
+}
+
+// Counting state of one job over stored blocks
+struct LogAnalyzer::StoredScan {
+    explicit StoredScan(std::pmr::memory_resource* arena) : codeCounts(arena), entries(arena) {}
+
+    uint32_t columns = 0;   // EntryField bits the counting and the filter read
+    int keyColumn = 0;      // Code column of the key: 0 user, 1 ip, 2 level
+    // Without a filter or patterns the key codes are counted as they are,
+    // and each distinct key is looked up once at the end
+    bool direct = false;
+    const std::vector<std::string>* dictionaries[3] = {};  // user, ip, level
+    std::pmr::vector<uint64_t> codeCounts;  // direct: count per key code
+    std::pmr::vector<LogEntry> entries;     // Rebuilt rows, reused from block to block
+    uint64_t entriesProcessed = 0;
+};
+
+void LogAnalyzer::prepareScan(StoredScan& scan) const {
+    scan.columns = segmentFilter_ ? segmentFilter_->fields() : 0;
+    if (request_.startDate || request_.endDate) {
+        scan.columns |= FIELD_TIMESTAMP;
+    }
+    EntryField keyField = request_.type == AnalysisType::IP ? FIELD_IP
+                        : request_.type == AnalysisType::LOG_LEVEL ? FIELD_LEVEL : FIELD_USER;
+    if (patterns_) {
+        scan.columns |= FIELD_MESSAGE;
+        if (request_.patternGroup == PatternGroup::USER) {
+            scan.columns |= FIELD_USER;
+        }
+        else if (request_.patternGroup == PatternGroup::LEVEL) {
+            scan.columns |= FIELD_LEVEL;
+        }
+    }
+    else {
+        scan.columns |= keyField;
+    }
+    scan.keyColumn = keyField == FIELD_IP ? 1 : keyField == FIELD_LEVEL ? 2 : 0;
+    scan.direct = !patterns_ && !segmentFilter_;
+}
+
+bool LogAnalyzer::blockInRange(int64_t minTime, int64_t maxTime, bool& whole) const {
+    // Zone map: skip blocks entirely outside the date range, and check the
+    // rows only of blocks that straddle it
+    if (maxTime < segmentFirstTime_ || minTime > segmentLastTime_) {
+        return false;
+    }
+    whole = minTime >= segmentFirstTime_ && maxTime <= segmentLastTime_;
+    return true;
+}
+
+void LogAnalyzer::countStoredBlock(StoredScan& scan, const SegmentBlock& block, bool whole, Counts& counts) {
+    if (scan.direct && scan.codeCounts.empty()) {
+        scan.codeCounts.assign(scan.dictionaries[scan.keyColumn]->size(), 0);
+    }
+    auto inRange = [&](size_t row) {
+        return whole || (block.times[row] >= segmentFirstTime_ && block.times[row] <= segmentLastTime_);
+    };
+
+    if (scan.direct) {
+        const std::vector<uint32_t>& codes = block.codes[scan.keyColumn];
+        for (size_t row = 0; row < block.rows; ++row) {
+            if (inRange(row)) {
+                scan.codeCounts[codes[row]]++;
+                scan.entriesProcessed++;
+            }
+        }
+        return;
+    }
+
+    // Rebuild the entries, with only the fields that are read; entries
+    // are reused from block to block so their strings keep their buffers
+    std::pmr::vector<LogEntry>& entries = scan.entries;
+    size_t used = 0;
+    for (size_t row = 0; row < block.rows; ++row) {
+        if (!inRange(row)) {
+            continue;
+        }
+        if (used == entries.size()) {
+            entries.emplace_back(entries.get_allocator().resource());
+        }
+        LogEntry& entry = entries[used++];
+        if (scan.columns & FIELD_USER) {
+            entry.user.assign((*scan.dictionaries[0])[block.codes[0][row]]);
+        }
+        if (scan.columns & FIELD_IP) {
+            entry.ip.assign((*scan.dictionaries[1])[block.codes[1][row]]);
+        }
+        if (scan.columns & FIELD_LEVEL) {
+            entry.level.assign((*scan.dictionaries[2])[block.codes[2][row]]);
+        }
+        if (scan.columns & FIELD_MESSAGE) {
+            entry.message.assign(block.message(row));
+        }
+    }
+    entries.erase(entries.begin() + static_cast<std::ptrdiff_t>(used), entries.end());
+    scan.entriesProcessed += countEntries(entries, segmentFilter_.get(), counts);
+}
+
+void LogAnalyzer::finishStoredScan(StoredScan& scan, Counts& counts) {
+    const std::vector<std::string>& keys = *scan.dictionaries[scan.keyColumn];
+    for (size_t code = 0; code < scan.codeCounts.size(); ++code) {
+        if (scan.codeCounts[code] > 0) {
+            counts.emplace(keys[code], scan.codeCounts[code]);
+        }
+    }
+    std::lock_guard<std::mutex> lock(resultMutex_);
+    result_.totalEntries += scan.entriesProcessed;
+}
+
+LogAnalyzer::Counts LogAnalyzer::analyzeSegment(const std::string& path, const ResultSink& sink) {
+    std::pmr::memory_resource* arena = ArenaScope::current();
+    Counts counts(arena);
+    StoredScan scan(arena);
+    prepareScan(scan);
+
+    // With no stored time in range nothing is read: the result is empty
+    SegmentReader reader;
+    if (segmentTimesInRange_ && !reader.open(path, scan.columns)) {
+        Metrics::add(MetricCounter::PARSE_ERRORS, 1);
+        std::cerr << "Error reading segment: " << path << std::endl;
+        return counts;
+    }
+    scan.dictionaries[0] = &reader.dictionary(FIELD_USER);
+    scan.dictionaries[1] = &reader.dictionary(FIELD_IP);
+    scan.dictionaries[2] = &reader.dictionary(FIELD_LEVEL);
+
+    auto aggregateStart = Clock::now();
+    SegmentBlock block;
+    uint64_t scanned = 0;
+    uint64_t skipped = 0;
+    bool complete = true;
+    for (size_t index = 0; index < reader.blockCount(); ++index) {
+        if (cancelled_) {
+            complete = false;
+            break;
+        }
+        const SegmentReader::BlockInfo& info = reader.blockInfo(index);
+        bool whole = false;
+        if (!blockInRange(info.minTime, info.maxTime, whole)) {
+            skipped++;
+            continue;
+        }
+        if (!reader.readBlock(index, whole ? scan.columns & ~FIELD_TIMESTAMP : scan.columns, block)) {
+            Metrics::add(MetricCounter::PARSE_ERRORS, 1);
+            std::cerr << "Corrupt block " << index << " in segment " << path << std::endl;
+            complete = false;
+            break;
+        }
+        scanned++;
+        countStoredBlock(scan, block, whole, counts);
+    }
+    finishStoredScan(scan, counts);
+    Metrics::record(MetricStage::AGGREGATE, Clock::now() - aggregateStart);
+    blocksScanned_ += scanned;
+    blocksSkipped_ += skipped;
+
+    if (sink && complete) {
+        AnalysisResult own;
+        own.type = request_.type;
+        own.totalEntries = scan.entriesProcessed;
+        for (const auto& pair : counts) {
+            own.counts.emplace(pair.first, pair.second);
+        }
+        sink(own);
+    }
+    return counts;
+}
+
+LogAnalyzer::Counts LogAnalyzer::analyzeTableBlock(const MemoryTable& table, size_t index) {
+    std::pmr::memory_resource* arena = ArenaScope::current();
+    Counts counts(arena);
+    const MemoryTable::Block& block = table.block(index);
+    bool whole = false;
+    if (!segmentTimesInRange_ || !blockInRange(block.minTime, block.maxTime, whole)) {
+        blocksSkipped_++;
+        return counts;
+    }
+
+    auto aggregateStart = Clock::now();
+    StoredScan scan(arena);
+    prepareScan(scan);
+    scan.dictionaries[0] = &table.dictionary(FIELD_USER);
+    scan.dictionaries[1] = &table.dictionary(FIELD_IP);
+    scan.dictionaries[2] = &table.dictionary(FIELD_LEVEL);
+    countStoredBlock(scan, block.columns, whole, counts);
+    finishStoredScan(scan, counts);
+    Metrics::record(MetricStage::AGGREGATE, Clock::now() - aggregateStart);
+    blocksScanned_++;
+    return counts;
+}
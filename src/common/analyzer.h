@@ -0,0 +1,247 @@
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include "common/protocol.h"
+#include "common/thread_pool.h"
+#include "common/compression.h"
+#include "common/trace.h"
+#include "common/arena.h"
+#include "common/filter.h"
+#include "common/pattern_matcher.h"
+#include "common/segment_store.h"
+#include <vector>
+#include <string>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <chrono>
+
+// Sees every entry parsed locally, before the date filter (e.g. to feed
+// server-wide aggregates). Called on worker threads; the entries live in the
+// job's arena and must not be kept.
+using EntrySink = std::function<void(const std::pmr::vector<LogEntry>& entries)>;
+
+// A log file received over the network: held in memory, or spilled to disk
+// when the receiving side ran over its memory threshold
+struct LogSource {
+    std::string name;       // Original file name (used for format detection)
+    std::string content;    // In-memory content (unused when spilled)
+    std::string spillPath;  // Path of the on-disk copy, empty if in memory
+    EntrySink sink;         // Also sees the entries of this source alone (never delegated)
+};
+
+// Gets the result of one submitted segment alone (e.g. to cache it)
+using ResultSink = std::function<void(const AnalysisResult& result)>;
+
+// Analyzes one submitted source somewhere other than this process (e.g. on a
+// worker node). Returns false to have the analyzer parse it locally instead.
+using SourceDelegate = std::function<bool(const LogSource& source, AnalysisResult& result)>;
+
+class LogAnalyzer {
+public:
+    // Analyzer with a private thread pool sized to the hardware
+    LogAnalyzer(const AnalysisRequest& request);
+
+    // Analyzer that runs its jobs on a shared pool, in the given pool queue
+    LogAnalyzer(const AnalysisRequest& request, ThreadPool& pool, ThreadPool::QueueId queue = 0);
+
+    // Waits for outstanding jobs
+    ~LogAnalyzer();
+
+    // Main analysis method
+    AnalysisResult analyze(const std::vector<std::string>& logFiles);
+
+    // Analyze sources received in memory (sources are consumed)
+    AnalysisResult analyze(std::vector<LogSource>& sources);
+
+    // Pipelined use: submit each source as soon as it is complete, then
+    // collect the merged result once the last one has been submitted
+    void submit(LogSource source);
+    AnalysisResult finish();
+
+    // Non-blocking finish: done is called once every submitted job has been
+    // merged, on the worker thread that completed the last one (or right away
+    // if nothing is outstanding). The callback may destroy the analyzer.
+    void finishAsync(std::function<void(const AnalysisResult&)> done);
+
+    // Analyze a segment of a stored dataset (see segment_store.h): only the
+    // columns the request reads are loaded, and blocks outside its date range
+    // are skipped. Segment entries do not go to the entry sink or delegate.
+    // sink (if set) gets the segment's own result once it has been read
+    // completely; not if it was cancelled or is corrupt.
+    void submitSegment(const std::string& path, ResultSink sink = ResultSink());
+
+    // Analyze a session's table (see MemoryTable), a job per block; blocks
+    // outside the date range are skipped as for segments. The table must
+    // not change until the analysis is done.
+    void submitTable(std::shared_ptr<const MemoryTable> table);
+
+    // Blocks of submitted segments and tables read and skipped so far
+    uint64_t blocksScanned() const;
+    uint64_t blocksSkipped() const;
+
+    // Skip jobs that have not started yet (e.g. the client went away)
+    void cancel();
+
+    // Bytes submitted but not parsed yet
+    size_t pendingBytes() const;
+
+    // Bytes of submitted sources analyzed so far
+    uint64_t processedBytes() const;
+
+    // Everything merged so far (jobs still running are not included)
+    AnalysisResult current();
+
+    // The merged result so far, limited to the topK largest counts;
+    // distinctKeys is set to the number of keys seen
+    AnalysisResult snapshot(size_t topK, size_t& distinctKeys);
+
+    // Called on a worker thread, with the analyzer's lock held, whenever a
+    // job has been merged (except one that completes a finish): it must only post
+    void setProgressCallback(std::function<void()> progress);
+
+    // Called on a worker thread with the in-memory size of each submitted
+    // source once its buffer has been released (parsed or skipped)
+    void setReleaseCallback(std::function<void(size_t bytes)> released);
+
+    // Hand submitted sources to a delegate (called on the worker pool)
+    void setDelegate(SourceDelegate delegate);
+
+    // Hand each parsed batch of entries to a sink as well
+    void setEntrySink(EntrySink sink);
+
+    // Record queue wait, analysis and merge spans of every job (set before submitting)
+    void setTrace(std::shared_ptr<const RequestTrace> trace);
+
+    // Worker time spent analyzing, in total and before a point in time
+    double busySeconds() const;
+    double busySecondsBefore(std::chrono::steady_clock::time_point until) const;
+
+private:
+    // A job's counts, in its arena until merged into result_
+    using Counts = std::pmr::unordered_map<std::pmr::string, uint64_t>;
+    using Clock = std::chrono::steady_clock;
+
+    // Queue a job on the thread pool; its counts are merged when it completes
+    // and bytes (its share of pendingBytes) are released even if it is skipped.
+    // The job runs, and is merged, inside an ArenaScope.
+    // label names the job's file in traces.
+    void submitJob(std::function<Counts()> job, size_t bytes = 0, const std::string& label = std::string());
+
+    // Merge a finished job's counts and fire the completion callback if it was the last
+    void completeJob(const Counts& counts);
+
+    // Analyze a single file; sink (if set) sees its entries, as for the
+    // functions below
+    Counts analyzeFile(const std::string& filename, const EntrySink& sink);
+
+    // Compressed input: split into independent members and decompressed in
+    // parallel when possible (one stream otherwise), then parsed by further
+    // jobs in record-aligned pieces. open returns a reader for one job.
+    void analyzeCompressed(const std::string& name, Compression compression, uint64_t size,
+                           std::function<ReadRange()> open, const EntrySink& sink);
+
+    // Hand decompressed members to parse jobs in input order
+    struct DecompressedStream;
+    void deliverMember(const std::shared_ptr<DecompressedStream>& stream, size_t index, std::string text);
+
+    // Queue a parse job for a piece of decompressed text
+    void submitText(const std::string& name, std::string text, const EntrySink& sink);
+
+    // Analyze log content already in memory
+    Counts analyzeContent(const std::string& name, const std::string& content, const EntrySink& sink);
+
+    // Count a parsed batch: the entries filter selects (every one if null),
+    // by key or pattern. Returns the number of entries counted.
+    uint64_t countEntries(const std::pmr::vector<LogEntry>& entries, const FilterProgram* filter, Counts& counts);
+
+    // Counting of stored blocks (segments and tables) by one job
+    struct StoredScan;
+
+    // Columns and counting mode of a scan, from the request
+    void prepareScan(StoredScan& scan) const;
+
+    // Whether a block with these stored times has rows in the date range,
+    // and whole if all of them are
+    bool blockInRange(int64_t minTime, int64_t maxTime, bool& whole) const;
+
+    // Count a block's rows in the date range (every row if whole), once
+    // the scan's dictionaries are set
+    void countStoredBlock(StoredScan& scan, const SegmentBlock& block, bool whole, Counts& counts);
+
+    // Add the scan's key code counts to counts, and its entries to the total
+    void finishStoredScan(StoredScan& scan, Counts& counts);
+
+    // Analyze one stored segment
+    Counts analyzeSegment(const std::string& path, const ResultSink& sink);
+
+    // Analyze one block of a table
+    Counts analyzeTableBlock(const MemoryTable& table, size_t index);
+
+    // Extract key based on analysis type
+    const std::pmr::string& getKeyForEntry(const LogEntry& entry);
+
+    // PATTERN: count each pattern (and group) once per selected entry whose
+    // message contains it; selection null for every entry
+    void countPatterns(const std::pmr::vector<LogEntry>& entries, const std::pmr::vector<uint32_t>* selection,
+                       Counts& counts);
+
+    // Fold every node's partial counts into result_ (resultMutex_ held)
+    void mergeNodes();
+
+    // Compile the request's filter and date range into filter_
+    void compileFilter();
+
+    // Member variables
+    AnalysisRequest request_;
+    AnalysisResult result_;
+    std::unique_ptr<FilterProgram> filter_;  // Request filter and date range, null if neither
+    // Segments compare stored times instead of timestamps: the filter
+    // without the date range, null if none, and the range as stored times
+    std::unique_ptr<FilterProgram> segmentFilter_;
+    bool segmentTimesInRange_;
+    int64_t segmentFirstTime_;
+    int64_t segmentLastTime_;
+    std::unique_ptr<PatternMatcher> patterns_;  // PATTERN requests only
+
+    // Thread pool (ownedPool_ is only set for standalone analyzers)
+    std::unique_ptr<ThreadPool> ownedPool_;
+    ThreadPool* pool_;
+    ThreadPool::QueueId queue_;
+
+    // Outstanding jobs, guarded by resultMutex_
+    std::mutex resultMutex_;
+    std::condition_variable doneCondition_;
+    size_t outstanding_;
+
+    // With a pool pinned to several NUMA nodes, jobs merge into the partial
+    // counts of their worker's node (allocated, and so placed, by that
+    // node's workers); mergeNodes does the cross-node merge when the last
+    // outstanding job completes and whenever the result is read
+    struct NodeCounts {
+        std::mutex mutex;
+        std::unordered_map<std::string, uint64_t> counts;
+    };
+    std::vector<std::unique_ptr<NodeCounts>> nodeCounts_;  // Empty with one node
+    std::function<void(const AnalysisResult&)> doneCallback_;
+    std::atomic<bool> cancelled_;
+
+    // Pipeline statistics
+    std::atomic<size_t> pendingBytes_;
+    std::atomic<uint64_t> processedBytes_;
+    std::atomic<uint64_t> blocksScanned_;
+    std::atomic<uint64_t> blocksSkipped_;
+    std::function<void()> progressCallback_;
+    std::function<void(size_t)> releaseCallback_;
+    SourceDelegate delegate_;
+    EntrySink entrySink_;
+    std::shared_ptr<const RequestTrace> trace_;  // Null unless the request is traced
+    mutable std::mutex spansMutex_;
+    std::vector<std::pair<Clock::time_point, Clock::time_point>> taskSpans_;
+    Clock::duration untrackedBusy_;  // Jobs beyond the span limit (long-lived follow sessions)
+};
+
+#endif // ANALYZER_H
@@ -0,0 +1,72 @@
+#include "common/arena.h"
+#include <memory>
+#include <algorithm>
+
+namespace {
+
+// Upstream of a scope's monotonic resource: the heap, noting how much the
+// scope needed beyond its block
+class OverflowResource : public std::pmr::memory_resource {
+public:
+    size_t overflow = 0;
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        overflow += bytes;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override {
+        std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+struct ThreadBlock {
+    std::unique_ptr<std::byte[]> data;
+    size_t size = 0;
+};
+
+thread_local ThreadBlock threadBlock;
+thread_local std::pmr::memory_resource* currentResource = nullptr;
+
+} // namespace
+
+struct ArenaScope::State {
+    OverflowResource upstream;
+    std::pmr::monotonic_buffer_resource resource;
+
+    State(std::byte* block, size_t size) : resource(block, size, &upstream) {}
+};
+
+ArenaScope::ArenaScope() : state_(nullptr) {
+    if (currentResource) {
+        return;
+    }
+    if (!threadBlock.data) {
+        threadBlock.data = std::make_unique<std::byte[]>(ARENA_INITIAL_BLOCK);
+        threadBlock.size = ARENA_INITIAL_BLOCK;
+    }
+    state_ = new State(threadBlock.data.get(), threadBlock.size);
+    currentResource = &state_->resource;
+}
+
+ArenaScope::~ArenaScope() {
+    if (!state_) {
+        return;
+    }
+    currentResource = nullptr;
+    size_t needed = threadBlock.size + state_->upstream.overflow;
+    delete state_;  // Releases everything allocated in the scope
+
+    // Next time, fit what this scope needed in the block
+    if (needed > threadBlock.size && threadBlock.size < ARENA_MAX_RETAINED) {
+        threadBlock.size = std::min(needed, ARENA_MAX_RETAINED);
+        threadBlock.data = std::make_unique<std::byte[]>(threadBlock.size);
+    }
+}
+
+std::pmr::memory_resource* ArenaScope::current() {
+    return currentResource ? currentResource : std::pmr::get_default_resource();
+}
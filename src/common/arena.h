@@ -0,0 +1,38 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <memory_resource>
+#include <cstddef>
+
+// Scratch memory for one unit of work (an analysis job) on the calling thread.
+//
+// Parsed entries and a job's counts are made of many small strings and map
+// nodes that all die together once the job is merged. Inside a scope they
+// are carved out of a per-thread block with a monotonic resource, so they
+// cost neither a trip through the shared heap each nor one free each: the
+// whole scope is released at once when it ends. The block is kept for the
+// thread's next scope and grows to the largest scope seen (up to
+// ARENA_MAX_RETAINED), so a worker in steady state does not touch the heap
+// for this memory at all.
+class ArenaScope {
+public:
+    ArenaScope();
+    ~ArenaScope();
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+    // The innermost scope's resource on this thread; the default resource
+    // (the heap) outside any scope. Nested scopes share the outer one.
+    static std::pmr::memory_resource* current();
+
+private:
+    struct State;
+    State* state_;  // Null for a nested scope
+};
+
+// Block a thread starts with, and the most it keeps between scopes
+constexpr size_t ARENA_INITIAL_BLOCK = 256 * 1024;
+constexpr size_t ARENA_MAX_RETAINED = 32 * 1024 * 1024;
+
+#endif // ARENA_H
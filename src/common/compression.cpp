@@ -0,0 +1,330 @@
+#include "common/compression.h"
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef LOG_ANALYZER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef LOG_ANALYZER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// Output is handed to the sink in pieces of at most this size
+constexpr size_t DECOMPRESS_BUFFER_SIZE = 256 * 1024;
+
+static uint8_t byteAt(const std::string& data, size_t index) {
+    return static_cast<uint8_t>(data[index]);
+}
+
+static uint32_t readLe32(const std::string& data, size_t index) {
+    return byteAt(data, index) | (byteAt(data, index + 1) << 8) | (byteAt(data, index + 2) << 16) |
+           (static_cast<uint32_t>(byteAt(data, index + 3)) << 24);
+}
+
+Compression detectCompression(const char* data, size_t size) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(data);
+    if (size >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b) {
+        return Compression::GZIP;
+    }
+    if (size >= 4 && bytes[0] == 0x28 && bytes[1] == 0xb5 && bytes[2] == 0x2f && bytes[3] == 0xfd) {
+        return Compression::ZSTD;
+    }
+    return Compression::NONE;
+}
+
+Compression detectCompression(const std::string& data) {
+    return detectCompression(data.data(), data.size());
+}
+
+Compression detectFileCompression(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[4];
+    file.read(magic, sizeof(magic));
+    return detectCompression(magic, static_cast<size_t>(file.gcount()));
+}
+
+std::string compressionName(Compression compression) {
+    switch (compression) {
+        case Compression::GZIP: return "gzip";
+        case Compression::ZSTD: return "zstd";
+        default: return "none";
+    }
+}
+
+bool compressionSupported(Compression compression) {
+    switch (compression) {
+        case Compression::NONE:
+            return true;
+        case Compression::GZIP:
+#ifdef LOG_ANALYZER_HAVE_ZLIB
+            return true;
+#else
+            return false;
+#endif
+        case Compression::ZSTD:
+#ifdef LOG_ANALYZER_HAVE_ZSTD
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+std::string stripCompressionExtension(const std::string& filename) {
+    std::string extension = std::filesystem::path(filename).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    if (extension == ".gz" || extension == ".gzip" || extension == ".bgz" || extension == ".zst" ||
+        extension == ".zstd") {
+        return filename.substr(0, filename.size() - extension.size());
+    }
+    return filename;
+}
+
+// Length of the BGZF block at offset, from its BC extra subfield (0 if the
+// member there is not a BGZF block)
+static uint64_t bgzfBlockLength(const ReadRange& read, uint64_t offset) {
+    std::string header = read(offset, 12);
+    if (header.size() < 12 || byteAt(header, 0) != 0x1f || byteAt(header, 1) != 0x8b || byteAt(header, 2) != 8 ||
+        !(byteAt(header, 3) & 4)) {
+        return 0;
+    }
+    size_t extraLength = byteAt(header, 10) | (byteAt(header, 11) << 8);
+    std::string extra = read(offset + 12, extraLength);
+    for (size_t i = 0; i + 4 <= extra.size();) {
+        size_t fieldLength = byteAt(extra, i + 2) | (byteAt(extra, i + 3) << 8);
+        if (extra[i] == 'B' && extra[i + 1] == 'C' && fieldLength == 2 && i + 6 <= extra.size()) {
+            return (byteAt(extra, i + 4) | (byteAt(extra, i + 5) << 8)) + 1;
+        }
+        i += 4 + fieldLength;
+    }
+    return 0;
+}
+
+// Length of the zstd frame at offset, found by walking its block headers
+// (0 if there is no valid frame there)
+static uint64_t zstdFrameLength(const ReadRange& read, uint64_t offset, uint64_t size) {
+    std::string header = read(offset, 18);
+    if (header.size() < 8) {
+        return 0;
+    }
+    uint32_t magic = readLe32(header, 0);
+    if ((magic & 0xFFFFFFF0) == 0x184D2A50) {
+        // Skippable frame: its length follows the magic number
+        return 8 + static_cast<uint64_t>(readLe32(header, 4));
+    }
+    if (magic != 0xFD2FB528) {
+        return 0;
+    }
+
+    uint8_t descriptor = byteAt(header, 4);
+    int contentSizeFlag = descriptor >> 6;
+    bool singleSegment = (descriptor >> 5) & 1;
+    bool checksum = (descriptor >> 2) & 1;
+    static const size_t dictionaryIdSizes[] = {0, 1, 2, 4};
+    size_t contentSizeBytes = contentSizeFlag == 0 ? (singleSegment ? 1 : 0) : (size_t(1) << contentSizeFlag);
+    uint64_t position = offset + 5 + (singleSegment ? 0 : 1) + dictionaryIdSizes[descriptor & 3] + contentSizeBytes;
+
+    while (true) {
+        std::string block = read(position, 3);
+        if (block.size() < 3) {
+            return 0;
+        }
+        uint32_t blockHeader = byteAt(block, 0) | (byteAt(block, 1) << 8) | (byteAt(block, 2) << 16);
+        bool last = blockHeader & 1;
+        int blockType = (blockHeader >> 1) & 3;
+        if (blockType == 3) {
+            return 0;
+        }
+        // An RLE block stores its byte once
+        position += 3 + (blockType == 1 ? 1 : (blockHeader >> 3));
+        if (position > size) {
+            return 0;
+        }
+        if (last) {
+            break;
+        }
+    }
+    return position + (checksum ? 4 : 0) - offset;
+}
+
+std::vector<uint64_t> findMemberOffsets(Compression compression, uint64_t size, const ReadRange& read) {
+    std::vector<uint64_t> offsets;
+    uint64_t offset = 0;
+    while (offset < size) {
+        offsets.push_back(offset);
+        uint64_t length = compression == Compression::GZIP ? bgzfBlockLength(read, offset)
+                                                           : zstdFrameLength(read, offset, size);
+        if (length == 0 || offset + length > size) {
+            break;
+        }
+        offset += length;
+    }
+    if (offsets.empty()) {
+        offsets.push_back(0);
+    }
+    return offsets;
+}
+
+bool deflateBuffer(const std::string& input, std::string& output) {
+#ifdef LOG_ANALYZER_HAVE_ZLIB
+    uLongf size = compressBound(static_cast<uLong>(input.size()));
+    output.resize(size);
+    if (compress2(reinterpret_cast<Bytef*>(&output[0]), &size, reinterpret_cast<const Bytef*>(input.data()),
+                  static_cast<uLong>(input.size()), Z_BEST_SPEED) != Z_OK) {
+        return false;
+    }
+    output.resize(size);
+    return true;
+#else
+    (void)input;
+    (void)output;
+    return false;
+#endif
+}
+
+bool inflateBuffer(const char* data, size_t size, size_t rawSize, std::string& output) {
+#ifdef LOG_ANALYZER_HAVE_ZLIB
+    output.resize(rawSize);
+    uLongf produced = static_cast<uLongf>(rawSize);
+    int status = uncompress(reinterpret_cast<Bytef*>(&output[0]), &produced, reinterpret_cast<const Bytef*>(data),
+                            static_cast<uLong>(size));
+    return status == Z_OK && produced == rawSize;
+#else
+    (void)data;
+    (void)size;
+    (void)rawSize;
+    (void)output;
+    return false;
+#endif
+}
+
+struct Decompressor::State {
+    Compression compression;
+    std::vector<char> buffer;
+#ifdef LOG_ANALYZER_HAVE_ZLIB
+    z_stream gzip{};
+    bool inMember = false;   // Inside a gzip member
+    bool trailing = false;   // Past the last member (e.g. zero padding)
+#endif
+#ifdef LOG_ANALYZER_HAVE_ZSTD
+    ZSTD_DStream* zstd = nullptr;
+    size_t frameRemaining = 0; // Last ZSTD_decompressStream hint: 0 at a frame boundary
+#endif
+};
+
+Decompressor::Decompressor(Compression compression) : state_(std::make_unique<State>()) {
+    if (compression == Compression::NONE || !compressionSupported(compression)) {
+        throw std::runtime_error(compressionName(compression) + " input is not supported by this build");
+    }
+    state_->compression = compression;
+    state_->buffer.resize(DECOMPRESS_BUFFER_SIZE);
+#ifdef LOG_ANALYZER_HAVE_ZLIB
+    if (compression == Compression::GZIP && inflateInit2(&state_->gzip, 15 + 16) != Z_OK) {
+        throw std::runtime_error("Cannot initialize gzip decompression");
+    }
+#endif
+#ifdef LOG_ANALYZER_HAVE_ZSTD
+    if (compression == Compression::ZSTD) {
+        state_->zstd = ZSTD_createDStream();
+        if (!state_->zstd || ZSTD_isError(ZSTD_initDStream(state_->zstd))) {
+            ZSTD_freeDStream(state_->zstd);
+            throw std::runtime_error("Cannot initialize zstd decompression");
+        }
+    }
+#endif
+}
+
+Decompressor::~Decompressor() {
+#ifdef LOG_ANALYZER_HAVE_ZLIB
+    if (state_->compression == Compression::GZIP) {
+        inflateEnd(&state_->gzip);
+    }
+#endif
+#ifdef LOG_ANALYZER_HAVE_ZSTD
+    if (state_->zstd) {
+        ZSTD_freeDStream(state_->zstd);
+    }
+#endif
+}
+
+void Decompressor::feed(const char* data, size_t size, const Sink& sink) {
+    State& state = *state_;
+#ifdef LOG_ANALYZER_HAVE_ZLIB
+    if (state.compression == Compression::GZIP) {
+        z_stream& stream = state.gzip;
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        stream.avail_in = static_cast<uInt>(size);
+        bool outputFull = false;
+        while (!state.trailing && (stream.avail_in > 0 || outputFull)) {
+            if (!state.inMember) {
+                // Anything but another member after a member is padding
+                if (stream.next_in[0] != 0x1f) {
+                    state.trailing = true;
+                    break;
+                }
+                state.inMember = true;
+            }
+            stream.next_out = reinterpret_cast<Bytef*>(state.buffer.data());
+            stream.avail_out = static_cast<uInt>(state.buffer.size());
+            int status = inflate(&stream, Z_NO_FLUSH);
+            size_t produced = state.buffer.size() - stream.avail_out;
+            if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR) {
+                throw std::runtime_error(std::string("Corrupt gzip data: ") + (stream.msg ? stream.msg : "unknown error"));
+            }
+            if (produced > 0) {
+                sink(state.buffer.data(), produced);
+            }
+            outputFull = stream.avail_out == 0;
+            if (status == Z_STREAM_END) {
+                inflateReset(&stream);
+                state.inMember = false;
+                outputFull = false;
+            }
+            else if (status == Z_BUF_ERROR && !outputFull) {
+                break;
+            }
+        }
+        return;
+    }
+#endif
+#ifdef LOG_ANALYZER_HAVE_ZSTD
+    if (state.compression == Compression::ZSTD) {
+        ZSTD_inBuffer input = {data, size, 0};
+        bool outputFull = false;
+        while (input.pos < input.size || outputFull) {
+            ZSTD_outBuffer output = {state.buffer.data(), state.buffer.size(), 0};
+            size_t status = ZSTD_decompressStream(state.zstd, &output, &input);
+            if (ZSTD_isError(status)) {
+                throw std::runtime_error(std::string("Corrupt zstd data: ") + ZSTD_getErrorName(status));
+            }
+            if (output.pos > 0) {
+                sink(state.buffer.data(), output.pos);
+            }
+            state.frameRemaining = status;
+            outputFull = output.pos == output.size;
+        }
+        return;
+    }
+#endif
+    (void)data;
+    (void)size;
+    (void)sink;
+}
+
+bool Decompressor::finished() const {
+#ifdef LOG_ANALYZER_HAVE_ZLIB
+    if (state_->compression == Compression::GZIP) {
+        return !state_->inMember;
+    }
+#endif
+#ifdef LOG_ANALYZER_HAVE_ZSTD
+    if (state_->compression == Compression::ZSTD) {
+        return state_->frameRemaining == 0;
+    }
+#endif
+    return true;
+}
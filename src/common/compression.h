@@ -0,0 +1,74 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+// Compressed log files (.gz, .zst, ...) are recognised by their magic bytes,
+// whatever their name, and decompressed as a stream straight into the
+// parsers. gzip needs zlib (LOG_ANALYZER_HAVE_ZLIB), zstd needs libzstd
+// (LOG_ANALYZER_HAVE_ZSTD); without them such files are reported and skipped.
+enum class Compression {
+    NONE,
+    GZIP,
+    ZSTD
+};
+
+// Format of data starting with these bytes (at least 4 are needed)
+Compression detectCompression(const char* data, size_t size);
+Compression detectCompression(const std::string& data);
+
+// Format of a file from its first bytes
+Compression detectFileCompression(const std::string& path);
+
+std::string compressionName(Compression compression);
+
+// Whether this build can decompress the format
+bool compressionSupported(Compression compression);
+
+// "app.json.gz" -> "app.json"; other names are returned unchanged
+std::string stripCompressionExtension(const std::string& filename);
+
+// One-shot zlib compression of a buffer held whole in memory (e.g. a column
+// of the segment store). Both return false without zlib; inflateBuffer also
+// on corrupt data or when the output is not exactly rawSize bytes.
+bool deflateBuffer(const std::string& input, std::string& output);
+bool inflateBuffer(const char* data, size_t size, size_t rawSize, std::string& output);
+
+// Reads up to size bytes at offset (fewer at the end of the input)
+using ReadRange = std::function<std::string(uint64_t offset, size_t size)>;
+
+// Offsets of members that can be decompressed independently: BGZF blocks
+// (bgzip's block-sized gzip members, which record their own length) or zstd
+// frames. Indexing only reads member headers. An input that cannot be split
+// further (e.g. plain gzip) ends up as one member running to the end.
+std::vector<uint64_t> findMemberOffsets(Compression compression, uint64_t size, const ReadRange& read);
+
+// Streaming decompressor. Input can be fed in pieces of any size; members
+// or frames concatenated in the input are decompressed one after the other.
+class Decompressor {
+public:
+    using Sink = std::function<void(const char* data, size_t size)>;
+
+    explicit Decompressor(Compression compression);
+    ~Decompressor();
+
+    Decompressor(const Decompressor&) = delete;
+    Decompressor& operator=(const Decompressor&) = delete;
+
+    // Decompress the next piece of input, handing output to sink as it is
+    // produced. Throws std::runtime_error on corrupt or unsupported input.
+    void feed(const char* data, size_t size, const Sink& sink);
+
+    // The input so far ended on a member boundary (false if it was truncated)
+    bool finished() const;
+
+private:
+    struct State;
+    std::unique_ptr<State> state_;
+};
+
+#endif // COMPRESSION_H
@@ -0,0 +1,170 @@
+#include "common/content_hash.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr uint64_t PRIME1 = 11400714785092119057ULL;
+constexpr uint64_t PRIME2 = 14029467366897019727ULL;
+constexpr uint64_t PRIME3 = 1609587929392839161ULL;
+constexpr uint64_t PRIME4 = 9650029242287828579ULL;
+constexpr uint64_t PRIME5 = 2870177450012600261ULL;
+
+// Seed of the second lane
+constexpr uint64_t SECOND_SEED = 0x9e3779b97f4a7c15ULL;
+
+uint64_t rotl(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Little-endian reads, whatever the host order
+uint64_t read64(const unsigned char* p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; --i) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+uint32_t read32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) |
+           (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t round(uint64_t acc, uint64_t input) {
+    acc += input * PRIME2;
+    acc = rotl(acc, 31);
+    return acc * PRIME1;
+}
+
+uint64_t mergeRound(uint64_t hash, uint64_t acc) {
+    hash ^= round(0, acc);
+    return hash * PRIME1 + PRIME4;
+}
+
+void initAccumulators(uint64_t seed, uint64_t acc[4]) {
+    acc[0] = seed + PRIME1 + PRIME2;
+    acc[1] = seed + PRIME2;
+    acc[2] = seed;
+    acc[3] = seed - PRIME1;
+}
+
+// The hash of the input from its accumulators (if it had a full stripe),
+// total length and the bytes after the last stripe
+uint64_t finalize(uint64_t seed, const uint64_t acc[4], uint64_t length, const unsigned char* tail, size_t tailSize) {
+    uint64_t hash;
+    if (length >= 32) {
+        hash = rotl(acc[0], 1) + rotl(acc[1], 7) + rotl(acc[2], 12) + rotl(acc[3], 18);
+        for (int i = 0; i < 4; ++i) {
+            hash = mergeRound(hash, acc[i]);
+        }
+    }
+    else {
+        hash = seed + PRIME5;
+    }
+    hash += length;
+
+    const unsigned char* p = tail;
+    const unsigned char* end = tail + tailSize;
+    for (; p + 8 <= end; p += 8) {
+        hash ^= round(0, read64(p));
+        hash = rotl(hash, 27) * PRIME1 + PRIME4;
+    }
+    if (p + 4 <= end) {
+        hash ^= static_cast<uint64_t>(read32(p)) * PRIME1;
+        hash = rotl(hash, 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        hash ^= *p * PRIME5;
+        hash = rotl(hash, 11) * PRIME1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+} // namespace
+
+uint64_t xxh64(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    uint64_t acc[4];
+    initAccumulators(seed, acc);
+    for (; p + 32 <= end; p += 32) {
+        for (int i = 0; i < 4; ++i) {
+            acc[i] = round(acc[i], read64(p + 8 * i));
+        }
+    }
+    return finalize(seed, acc, size, p, static_cast<size_t>(end - p));
+}
+
+ContentHasher::ContentHasher() : buffered_(0), length_(0) {
+    lanes_[0].seed = 0;
+    lanes_[1].seed = SECOND_SEED;
+    for (auto& lane : lanes_) {
+        initAccumulators(lane.seed, lane.acc);
+    }
+}
+
+void ContentHasher::consumeStripe(const unsigned char* stripe) {
+    uint64_t words[4];
+    for (int i = 0; i < 4; ++i) {
+        words[i] = read64(stripe + 8 * i);
+    }
+    for (auto& lane : lanes_) {
+        for (int i = 0; i < 4; ++i) {
+            lane.acc[i] = round(lane.acc[i], words[i]);
+        }
+    }
+}
+
+void ContentHasher::update(const void* data, size_t size) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    length_ += size;
+
+    // Complete a stripe left over from the previous call first
+    if (buffered_ > 0) {
+        size_t take = std::min(sizeof(buffer_) - buffered_, size);
+        std::memcpy(buffer_ + buffered_, p, take);
+        buffered_ += take;
+        p += take;
+        if (buffered_ < sizeof(buffer_)) {
+            return;
+        }
+        consumeStripe(buffer_);
+        buffered_ = 0;
+    }
+    for (; p + 32 <= end; p += 32) {
+        consumeStripe(p);
+    }
+    buffered_ = static_cast<size_t>(end - p);
+    std::memcpy(buffer_, p, buffered_);
+}
+
+uint64_t ContentHasher::digest(const Lane& lane) const {
+    return finalize(lane.seed, lane.acc, length_, buffer_, buffered_);
+}
+
+std::string ContentHasher::hex() const {
+    static const char digits[] = "0123456789abcdef";
+    std::string text;
+    for (const auto& lane : lanes_) {
+        uint64_t value = digest(lane);
+        for (int shift = 60; shift >= 0; shift -= 4) {
+            text += digits[(value >> shift) & 0xf];
+        }
+    }
+    return text;
+}
+
+std::string ContentHasher::hash(const std::string& data) {
+    ContentHasher hasher;
+    hasher.update(data.data(), data.size());
+    return hasher.hex();
+}
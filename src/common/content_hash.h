@@ -0,0 +1,44 @@
+#ifndef CONTENT_HASH_H
+#define CONTENT_HASH_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// 64-bit XXH64 of data (compatible with the reference implementation)
+uint64_t xxh64(const void* data, size_t size, uint64_t seed = 0);
+
+// Streaming content hash of upload pieces (see MSG_MANIFEST): XXH64 under two
+// seeds, 128 bits as 32 hex characters. Fast enough to hash an upload on the
+// client and check it on the server at well above network speed.
+class ContentHasher {
+public:
+    ContentHasher();
+
+    void update(const void* data, size_t size);
+
+    // Hash of everything fed so far
+    std::string hex() const;
+
+    // Hash of a whole buffer
+    static std::string hash(const std::string& data);
+
+private:
+    // XXH64 state for one seed
+    struct Lane {
+        uint64_t seed;
+        uint64_t acc[4];
+    };
+
+    // Fold one 32-byte stripe into both lanes
+    void consumeStripe(const unsigned char* stripe);
+
+    uint64_t digest(const Lane& lane) const;
+
+    Lane lanes_[2];
+    unsigned char buffer_[32];
+    size_t buffered_;
+    uint64_t length_;
+};
+
+#endif // CONTENT_HASH_H
@@ -0,0 +1,160 @@
+#include "common/cpu_topology.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+size_t CpuTopology::cpuCount() const {
+    size_t count = 0;
+    for (const auto& node : nodes) {
+        count += node.size();
+    }
+    return count;
+}
+
+#ifdef _WIN32
+
+CpuTopology CpuTopology::detect() {
+    CpuTopology topology;
+    DWORD_PTR processMask = 0;
+    DWORD_PTR systemMask = 0;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask)) {
+        return topology;
+    }
+
+    ULONG highestNode = 0;
+    if (!GetNumaHighestNodeNumber(&highestNode)) {
+        highestNode = 0;
+    }
+    for (ULONG node = 0; node <= highestNode; ++node) {
+        ULONGLONG nodeMask = 0;
+        if (highestNode > 0 && !GetNumaNodeProcessorMask(static_cast<UCHAR>(node), &nodeMask)) {
+            continue;
+        }
+        if (highestNode == 0) {
+            nodeMask = processMask;
+        }
+        std::vector<int> cpus;
+        for (int cpu = 0; cpu < static_cast<int>(sizeof(DWORD_PTR) * 8); ++cpu) {
+            DWORD_PTR bit = static_cast<DWORD_PTR>(1) << cpu;
+            if ((nodeMask & bit) && (processMask & bit)) {
+                cpus.push_back(cpu);
+            }
+        }
+        if (!cpus.empty()) {
+            topology.nodes.push_back(std::move(cpus));
+        }
+    }
+    return topology;
+}
+
+bool pinCurrentThread(int cpu) {
+    DWORD_PTR mask = static_cast<DWORD_PTR>(1) << cpu;
+    return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+}
+
+#elif defined(__linux__)
+
+namespace {
+
+// A sysfs CPU list such as "0-3,8-11"
+std::vector<int> parseCpuList(const std::string& text) {
+    std::vector<int> cpus;
+    std::stringstream stream(text);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        size_t dash = range.find('-');
+        try {
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+        catch (const std::exception&) {
+            // Blank or malformed entry: skip it
+        }
+    }
+    return cpus;
+}
+
+} // namespace
+
+CpuTopology CpuTopology::detect() {
+    CpuTopology topology;
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return topology;
+    }
+
+    // Nodes in number order, each limited to the CPUs we may use
+    std::vector<std::pair<int, std::vector<int>>> nodes;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", error)) {
+        std::string name = entry.path().filename().string();
+        if (name.compare(0, 4, "node") != 0 || name.size() == 4 ||
+            !std::all_of(name.begin() + 4, name.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            continue;
+        }
+        std::ifstream file(entry.path() / "cpulist");
+        std::string list;
+        std::getline(file, list);
+        std::vector<int> cpus;
+        for (int cpu : parseCpuList(list)) {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                cpus.push_back(cpu);
+            }
+        }
+        if (!cpus.empty()) {
+            nodes.emplace_back(std::stoi(name.substr(4)), std::move(cpus));
+        }
+    }
+    std::sort(nodes.begin(), nodes.end());
+    for (auto& node : nodes) {
+        topology.nodes.push_back(std::move(node.second));
+    }
+
+    // No NUMA information (or none matching the mask): one node
+    if (topology.nodes.empty()) {
+        std::vector<int> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                cpus.push_back(cpu);
+            }
+        }
+        if (!cpus.empty()) {
+            topology.nodes.push_back(std::move(cpus));
+        }
+    }
+    return topology;
+}
+
+bool pinCurrentThread(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+#else
+
+CpuTopology CpuTopology::detect() {
+    return CpuTopology();
+}
+
+bool pinCurrentThread(int) {
+    return false;
+}
+
+#endif
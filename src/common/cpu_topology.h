@@ -0,0 +1,25 @@
+#ifndef CPU_TOPOLOGY_H
+#define CPU_TOPOLOGY_H
+
+#include <vector>
+#include <cstddef>
+
+// The CPUs this process may run on, grouped by NUMA node.
+//
+// On Linux the nodes come from /sys/devices/system/node, limited to the
+// process's affinity mask (e.g. a container's cpuset); on Windows from the
+// NUMA node processor masks of the first processor group. A machine without
+// NUMA information is one node holding every allowed CPU. Empty when CPU
+// placement is not supported on this platform.
+struct CpuTopology {
+    std::vector<std::vector<int>> nodes;  // CPU numbers of each node that has any
+
+    static CpuTopology detect();
+
+    size_t cpuCount() const;
+};
+
+// Bind the calling thread to one CPU; false if that failed
+bool pinCurrentThread(int cpu);
+
+#endif // CPU_TOPOLOGY_H
@@ -0,0 +1,720 @@
+#include "common/filter.h"
+#include <algorithm>
+#include <functional>
+#include <unordered_set>
+#include <string_view>
+#include <vector>
+#include <cctype>
+
+namespace {
+
+enum class NodeKind {
+    AND,
+    OR,
+    NOT,
+    MATCH,     // Field equals one of the values, or is an address in one of the blocks
+    CONTAINS,  // Field contains the needle
+    DATE       // Timestamp in the date range
+};
+
+enum class Field {
+    USER,
+    IP,
+    LEVEL,
+    MESSAGE
+};
+
+// Values of a MATCH looked up in a hash set beyond this many
+constexpr size_t LINEAR_MATCH_LIMIT = 8;
+
+const std::pmr::string& fieldOf(const LogEntry& entry, Field field) {
+    switch (field) {
+        case Field::USER: return entry.user;
+        case Field::IP: return entry.ip;
+        case Field::LEVEL: return entry.level;
+        default: return entry.message;
+    }
+}
+
+const char* fieldName(Field field) {
+    switch (field) {
+        case Field::USER: return "user";
+        case Field::IP: return "ip";
+        case Field::LEVEL: return "level";
+        default: return "message";
+    }
+}
+
+std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+std::string uppercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+    return text;
+}
+
+// a equals b, which is already upper case, ignoring the case of a
+bool equalsUpper(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::toupper(static_cast<unsigned char>(a[i])) != static_cast<unsigned char>(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Dotted-quad IPv4 address
+bool parseIpv4(std::string_view text, uint32_t& address) {
+    address = 0;
+    for (int octet = 0; octet < 4; ++octet) {
+        if (octet > 0) {
+            if (text.empty() || text[0] != '.') {
+                return false;
+            }
+            text.remove_prefix(1);
+        }
+        size_t digits = 0;
+        uint32_t value = 0;
+        while (digits < text.size() && digits < 3 && std::isdigit(static_cast<unsigned char>(text[digits]))) {
+            value = value * 10 + (text[digits] - '0');
+            digits++;
+        }
+        if (digits == 0 || value > 255) {
+            return false;
+        }
+        address = (address << 8) | value;
+        text.remove_prefix(digits);
+    }
+    return text.empty();
+}
+
+// "10.0.0.0/8" as network and mask
+bool parseCidr(const std::string& text, uint32_t& network, uint32_t& mask) {
+    size_t slash = text.find('/');
+    uint32_t address = 0;
+    if (!parseIpv4(std::string_view(text).substr(0, slash), address)) {
+        return false;
+    }
+    std::string prefix = text.substr(slash + 1);
+    if (prefix.empty() || prefix.size() > 2 ||
+        !std::all_of(prefix.begin(), prefix.end(), [](unsigned char c) { return std::isdigit(c); })) {
+        return false;
+    }
+    int bits = std::stoi(prefix);
+    if (bits > 32) {
+        return false;
+    }
+    mask = bits == 0 ? 0 : ~static_cast<uint32_t>(0) << (32 - bits);
+    network = address & mask;
+    return true;
+}
+
+std::string quoteValue(const std::string& value) {
+    bool bare = !value.empty() && std::none_of(value.begin(), value.end(), [](unsigned char c) {
+        return std::isspace(c) || c == '(' || c == ')' || c == ',' || c == '=' || c == '!' || c == '"';
+    });
+    if (bare) {
+        return value;
+    }
+    std::string out = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+} // namespace
+
+struct FilterProgram::Node {
+    NodeKind kind = NodeKind::AND;
+    std::vector<std::unique_ptr<Node>> children;
+    Field field = Field::USER;
+    double cost = 0;  // Relative per-entry cost, to order and/or operands
+
+    // MATCH (level values are kept upper case)
+    std::vector<std::string> values;
+    std::unordered_set<std::string_view> valueSet;  // Views of values, beyond LINEAR_MATCH_LIMIT
+    std::vector<std::pair<uint32_t, uint32_t>> blocks;  // Network and mask
+
+    // CONTAINS
+    std::string needle;
+    std::unique_ptr<std::boyer_moore_horspool_searcher<const char*>> searcher;
+
+    // DATE
+    std::optional<std::string> startDate;
+    std::optional<std::string> endDate;
+};
+
+using Node = FilterProgram::Node;
+
+namespace {
+
+// Operand costs reflect the work per entry: a comparison of a short field, a
+// hash lookup or address parse, a scan of the whole message
+void computeCost(Node& node) {
+    switch (node.kind) {
+        case NodeKind::MATCH:
+            node.cost = (node.field == Field::LEVEL ? 1 : 2) + (node.blocks.empty() ? 0 : 1) +
+                        (node.field == Field::MESSAGE ? 2 : 0);
+            break;
+        case NodeKind::CONTAINS:
+            node.cost = node.field == Field::MESSAGE ? 8 : 4;
+            break;
+        case NodeKind::DATE:
+            node.cost = 2;
+            break;
+        case NodeKind::NOT:
+            node.cost = node.children[0]->cost;
+            break;
+        default:
+            node.cost = 0;
+            for (const auto& child : node.children) {
+                node.cost += child->cost;
+            }
+            std::stable_sort(node.children.begin(), node.children.end(),
+                             [](const std::unique_ptr<Node>& a, const std::unique_ptr<Node>& b) {
+                                 return a->cost < b->cost;
+                             });
+            break;
+    }
+}
+
+// and/or node of the operands, with nested operands of the same kind spliced in
+std::unique_ptr<Node> combine(NodeKind kind, std::vector<std::unique_ptr<Node>> operands) {
+    if (operands.size() == 1) {
+        return std::move(operands[0]);
+    }
+    auto node = std::make_unique<Node>();
+    node->kind = kind;
+    for (auto& operand : operands) {
+        if (operand->kind == kind) {
+            for (auto& child : operand->children) {
+                node->children.push_back(std::move(child));
+            }
+        }
+        else {
+            node->children.push_back(std::move(operand));
+        }
+    }
+    computeCost(*node);
+    return node;
+}
+
+std::unique_ptr<Node> negate(std::unique_ptr<Node> operand) {
+    auto node = std::make_unique<Node>();
+    node->kind = NodeKind::NOT;
+    node->children.push_back(std::move(operand));
+    computeCost(*node);
+    return node;
+}
+
+struct Token {
+    enum Type { WORD, STRING, LPAREN, RPAREN, COMMA, EQUAL, NOT_EQUAL, END } type;
+    std::string text;
+    size_t offset;
+};
+
+class ExpressionParser {
+public:
+    explicit ExpressionParser(const std::string& text) : text_(text) {}
+
+    std::unique_ptr<Node> parse(std::string& error) {
+        if (!tokenize()) {
+            error = error_;
+            return nullptr;
+        }
+        std::unique_ptr<Node> root = parseOr();
+        if (root && peek().type != Token::END) {
+            fail("unexpected '" + peek().text + "'");
+            root.reset();
+        }
+        if (!root) {
+            error = error_;
+        }
+        return root;
+    }
+
+private:
+    bool tokenize() {
+        size_t i = 0;
+        while (i < text_.size()) {
+            char c = text_[i];
+            if (std::isspace(static_cast<unsigned char>(c))) {
+                i++;
+                continue;
+            }
+            size_t start = i;
+            if (c == '(' || c == ')' || c == ',' || c == '=') {
+                Token::Type type = c == '(' ? Token::LPAREN : c == ')' ? Token::RPAREN
+                                 : c == ',' ? Token::COMMA : Token::EQUAL;
+                tokens_.push_back({type, std::string(1, c), start});
+                i++;
+            }
+            else if (c == '!') {
+                if (i + 1 >= text_.size() || text_[i + 1] != '=') {
+                    return fail("expected '!=' at offset " + std::to_string(start));
+                }
+                tokens_.push_back({Token::NOT_EQUAL, "!=", start});
+                i += 2;
+            }
+            else if (c == '"') {
+                std::string value;
+                i++;
+                while (i < text_.size() && text_[i] != '"') {
+                    if (text_[i] == '\\' && i + 1 < text_.size()) {
+                        i++;
+                    }
+                    value += text_[i++];
+                }
+                if (i >= text_.size()) {
+                    return fail("unterminated string at offset " + std::to_string(start));
+                }
+                i++;
+                tokens_.push_back({Token::STRING, value, start});
+            }
+            else {
+                while (i < text_.size() && !std::isspace(static_cast<unsigned char>(text_[i])) &&
+                       std::string_view("(),=!\"").find(text_[i]) == std::string_view::npos) {
+                    i++;
+                }
+                tokens_.push_back({Token::WORD, text_.substr(start, i - start), start});
+            }
+        }
+        tokens_.push_back({Token::END, "end of filter", text_.size()});
+        return true;
+    }
+
+    const Token& peek() const {
+        return tokens_[position_];
+    }
+
+    const Token& next() {
+        const Token& token = tokens_[position_];
+        if (token.type != Token::END) {
+            position_++;
+        }
+        return token;
+    }
+
+    bool peekKeyword(const char* keyword) const {
+        return peek().type == Token::WORD && lowercase(peek().text) == keyword;
+    }
+
+    bool fail(const std::string& message) {
+        if (error_.empty()) {
+            error_ = message;
+        }
+        return false;
+    }
+
+    std::unique_ptr<Node> failNode(const std::string& message) {
+        fail(message + " at offset " + std::to_string(peek().offset));
+        return nullptr;
+    }
+
+    std::unique_ptr<Node> parseOr() {
+        std::vector<std::unique_ptr<Node>> operands;
+        do {
+            auto operand = parseAnd();
+            if (!operand) {
+                return nullptr;
+            }
+            operands.push_back(std::move(operand));
+        } while (peekKeyword("or") && next().type == Token::WORD);
+        return combine(NodeKind::OR, std::move(operands));
+    }
+
+    std::unique_ptr<Node> parseAnd() {
+        std::vector<std::unique_ptr<Node>> operands;
+        do {
+            auto operand = parseUnary();
+            if (!operand) {
+                return nullptr;
+            }
+            operands.push_back(std::move(operand));
+        } while (peekKeyword("and") && next().type == Token::WORD);
+        return combine(NodeKind::AND, std::move(operands));
+    }
+
+    std::unique_ptr<Node> parseUnary() {
+        if (peekKeyword("not")) {
+            next();
+            auto operand = parseUnary();
+            return operand ? negate(std::move(operand)) : nullptr;
+        }
+        if (peek().type == Token::LPAREN) {
+            next();
+            auto inner = parseOr();
+            if (!inner) {
+                return nullptr;
+            }
+            if (peek().type != Token::RPAREN) {
+                return failNode("expected ')'");
+            }
+            next();
+            return inner;
+        }
+        return parsePredicate();
+    }
+
+    bool parseValue(std::string& value) {
+        if (peek().type != Token::WORD && peek().type != Token::STRING) {
+            failNode("expected a value");
+            return false;
+        }
+        value = next().text;
+        return true;
+    }
+
+    std::unique_ptr<Node> parsePredicate() {
+        if (peek().type != Token::WORD) {
+            return failNode("expected a field (user, ip, level or message)");
+        }
+        std::string name = lowercase(peek().text);
+        Field field;
+        if (name == "user") field = Field::USER;
+        else if (name == "ip") field = Field::IP;
+        else if (name == "level") field = Field::LEVEL;
+        else if (name == "message") field = Field::MESSAGE;
+        else return failNode("unknown field '" + peek().text + "'");
+        next();
+
+        auto node = std::make_unique<Node>();
+        node->field = field;
+        bool negated = false;
+        if (peek().type == Token::EQUAL || peek().type == Token::NOT_EQUAL) {
+            negated = next().type == Token::NOT_EQUAL;
+            node->kind = NodeKind::MATCH;
+            node->values.emplace_back();
+            if (!parseValue(node->values.back())) {
+                return nullptr;
+            }
+        }
+        else if (peekKeyword("contains")) {
+            next();
+            node->kind = NodeKind::CONTAINS;
+            if (!parseValue(node->needle)) {
+                return nullptr;
+            }
+            node->searcher = std::make_unique<std::boyer_moore_horspool_searcher<const char*>>(
+                node->needle.data(), node->needle.data() + node->needle.size());
+        }
+        else {
+            if (peekKeyword("not")) {
+                next();
+                negated = true;
+            }
+            if (!peekKeyword("in")) {
+                return failNode("expected '=', '!=', 'in' or 'contains'");
+            }
+            next();
+            node->kind = NodeKind::MATCH;
+            if (peek().type == Token::LPAREN) {
+                next();
+                do {
+                    node->values.emplace_back();
+                    if (!parseValue(node->values.back())) {
+                        return nullptr;
+                    }
+                } while (peek().type == Token::COMMA && next().type == Token::COMMA);
+                if (peek().type != Token::RPAREN) {
+                    return failNode("expected ',' or ')'");
+                }
+                next();
+            }
+            else {
+                node->values.emplace_back();
+                if (!parseValue(node->values.back())) {
+                    return nullptr;
+                }
+            }
+        }
+
+        if (node->kind == NodeKind::MATCH && !prepareMatch(*node)) {
+            return nullptr;
+        }
+        computeCost(*node);
+        return negated ? negate(std::move(node)) : std::move(node);
+    }
+
+    // Split CIDR blocks out of the values, normalize level case and index
+    // long value lists
+    bool prepareMatch(Node& node) {
+        if (node.field == Field::IP) {
+            std::vector<std::string> exact;
+            for (const auto& value : node.values) {
+                if (value.find('/') == std::string::npos) {
+                    exact.push_back(value);
+                    continue;
+                }
+                uint32_t network = 0;
+                uint32_t mask = 0;
+                if (!parseCidr(value, network, mask)) {
+                    return fail("invalid CIDR block '" + value + "'");
+                }
+                node.blocks.emplace_back(network, mask);
+            }
+            node.values.swap(exact);
+        }
+        if (node.field == Field::LEVEL) {
+            for (auto& value : node.values) {
+                value = uppercase(value);
+            }
+        }
+        if (node.values.size() > LINEAR_MATCH_LIMIT && node.field != Field::LEVEL) {
+            node.valueSet.insert(node.values.begin(), node.values.end());
+        }
+        return true;
+    }
+
+    const std::string& text_;
+    std::vector<Token> tokens_;
+    size_t position_ = 0;
+    std::string error_;
+};
+
+// Keep the selected indexes whose entry passes
+template <typename Predicate>
+void keepIf(std::pmr::vector<uint32_t>& selection, Predicate predicate) {
+    size_t kept = 0;
+    for (uint32_t index : selection) {
+        if (predicate(index)) {
+            selection[kept++] = index;
+        }
+    }
+    selection.resize(kept);
+}
+
+// Remove the (sorted) indexes in removed from the (sorted) selection
+void removeSorted(std::pmr::vector<uint32_t>& selection, const std::pmr::vector<uint32_t>& removed) {
+    size_t kept = 0;
+    size_t r = 0;
+    for (uint32_t index : selection) {
+        while (r < removed.size() && removed[r] < index) {
+            r++;
+        }
+        if (r == removed.size() || removed[r] != index) {
+            selection[kept++] = index;
+        }
+    }
+    selection.resize(kept);
+}
+
+bool matches(const Node& node, std::string_view value) {
+    if (node.field == Field::LEVEL) {
+        return std::any_of(node.values.begin(), node.values.end(),
+                           [value](const std::string& candidate) { return equalsUpper(value, candidate); });
+    }
+    if (!node.valueSet.empty()) {
+        if (node.valueSet.count(value)) {
+            return true;
+        }
+    }
+    else if (std::find(node.values.begin(), node.values.end(), value) != node.values.end()) {
+        return true;
+    }
+    if (!node.blocks.empty()) {
+        uint32_t address = 0;
+        if (parseIpv4(value, address)) {
+            for (const auto& block : node.blocks) {
+                if ((address & block.second) == block.first) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+// Narrow selection to the entries passing node
+void evaluate(const Node& node, const std::pmr::vector<LogEntry>& entries, std::pmr::vector<uint32_t>& selection) {
+    std::pmr::memory_resource* resource = selection.get_allocator().resource();
+    switch (node.kind) {
+        case NodeKind::AND:
+            for (const auto& child : node.children) {
+                if (selection.empty()) {
+                    break;
+                }
+                evaluate(*child, entries, selection);
+            }
+            break;
+
+        case NodeKind::OR: {
+            // Each operand only sees the entries no earlier one accepted
+            std::pmr::vector<uint32_t> remaining(selection, resource);
+            std::pmr::vector<uint32_t> accepted(resource);
+            std::pmr::vector<uint32_t> candidates(resource);
+            std::pmr::vector<uint32_t> merged(resource);
+            for (const auto& child : node.children) {
+                candidates = remaining;
+                evaluate(*child, entries, candidates);
+                if (candidates.empty()) {
+                    continue;
+                }
+                merged.clear();
+                std::merge(accepted.begin(), accepted.end(), candidates.begin(), candidates.end(),
+                           std::back_inserter(merged));
+                accepted.swap(merged);
+                removeSorted(remaining, candidates);
+                if (remaining.empty()) {
+                    break;
+                }
+            }
+            selection.swap(accepted);
+            break;
+        }
+
+        case NodeKind::NOT: {
+            std::pmr::vector<uint32_t> excluded(selection, resource);
+            evaluate(*node.children[0], entries, excluded);
+            removeSorted(selection, excluded);
+            break;
+        }
+
+        case NodeKind::MATCH:
+            keepIf(selection, [&](uint32_t index) { return matches(node, fieldOf(entries[index], node.field)); });
+            break;
+
+        case NodeKind::CONTAINS:
+            keepIf(selection, [&](uint32_t index) {
+                const std::pmr::string& value = fieldOf(entries[index], node.field);
+                const char* end = value.data() + value.size();
+                return std::search(value.data(), end, *node.searcher) != end || node.needle.empty();
+            });
+            break;
+
+        case NodeKind::DATE:
+            keepIf(selection, [&](uint32_t index) {
+                return isDateInRange(entries[index].timestamp, node.startDate, node.endDate);
+            });
+            break;
+    }
+}
+
+std::string describeNode(const Node& node) {
+    switch (node.kind) {
+        case NodeKind::AND:
+        case NodeKind::OR: {
+            std::string text = "(";
+            for (size_t i = 0; i < node.children.size(); ++i) {
+                text += (i > 0 ? (node.kind == NodeKind::AND ? " and " : " or ") : "") + describeNode(*node.children[i]);
+            }
+            return text + ")";
+        }
+        case NodeKind::NOT:
+            return "not " + describeNode(*node.children[0]);
+        case NodeKind::MATCH: {
+            std::string text = std::string(fieldName(node.field)) + " in (";
+            bool first = true;
+            for (const auto& value : node.values) {
+                text += (first ? "" : ", ") + quoteValue(value);
+                first = false;
+            }
+            for (const auto& block : node.blocks) {
+                uint32_t network = block.first;
+                int bits = 0;
+                for (uint32_t mask = block.second; mask != 0; mask <<= 1) {
+                    bits++;
+                }
+                text += std::string(first ? "" : ", ") + std::to_string(network >> 24) + "." +
+                        std::to_string((network >> 16) & 0xff) + "." + std::to_string((network >> 8) & 0xff) +
+                        "." + std::to_string(network & 0xff) + "/" + std::to_string(bits);
+                first = false;
+            }
+            return text + ")";
+        }
+        case NodeKind::CONTAINS:
+            return std::string(fieldName(node.field)) + " contains " + quoteValue(node.needle);
+        case NodeKind::DATE:
+            return "date in [" + node.startDate.value_or("") + ", " + node.endDate.value_or("") + "]";
+    }
+    return std::string();
+}
+
+// EntryField bits of the fields a node reads
+uint32_t nodeFields(const Node& node) {
+    switch (node.kind) {
+        case NodeKind::MATCH:
+        case NodeKind::CONTAINS:
+            switch (node.field) {
+                case Field::USER: return FIELD_USER;
+                case Field::IP: return FIELD_IP;
+                case Field::LEVEL: return FIELD_LEVEL;
+                default: return FIELD_MESSAGE;
+            }
+        case NodeKind::DATE:
+            return FIELD_TIMESTAMP;
+        default: {
+            uint32_t fields = 0;
+            for (const auto& child : node.children) {
+                fields |= nodeFields(*child);
+            }
+            return fields;
+        }
+    }
+}
+
+} // namespace
+
+FilterProgram::~FilterProgram() = default;
+
+std::unique_ptr<FilterProgram> FilterProgram::compile(const std::string& text, std::string& error) {
+    std::unique_ptr<FilterProgram> program(new FilterProgram());
+    if (std::all_of(text.begin(), text.end(), [](unsigned char c) { return std::isspace(c); })) {
+        return program;
+    }
+    ExpressionParser parser(text);
+    program->root_ = parser.parse(error);
+    if (!program->root_) {
+        return nullptr;
+    }
+    return program;
+}
+
+void FilterProgram::restrictDates(const std::optional<std::string>& startDate,
+                                  const std::optional<std::string>& endDate) {
+    if (!startDate.has_value() && !endDate.has_value()) {
+        return;
+    }
+    auto date = std::make_unique<Node>();
+    date->kind = NodeKind::DATE;
+    date->startDate = startDate;
+    date->endDate = endDate;
+    computeCost(*date);
+    if (!root_) {
+        root_ = std::move(date);
+        return;
+    }
+    std::vector<std::unique_ptr<Node>> operands;
+    operands.push_back(std::move(root_));
+    operands.push_back(std::move(date));
+    root_ = combine(NodeKind::AND, std::move(operands));
+}
+
+void FilterProgram::select(const std::pmr::vector<LogEntry>& entries, std::pmr::vector<uint32_t>& selection) const {
+    selection.resize(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        selection[i] = static_cast<uint32_t>(i);
+    }
+    if (root_) {
+        evaluate(*root_, entries, selection);
+    }
+}
+
+uint32_t FilterProgram::fields() const {
+    return root_ ? nodeFields(*root_) : 0;
+}
+
+std::string FilterProgram::describe() const {
+    return root_ ? describeNode(*root_) : std::string("(all)");
+}
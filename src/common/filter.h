@@ -0,0 +1,59 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include "common/protocol.h"
+#include <string>
+#include <memory>
+#include <optional>
+#include <memory_resource>
+#include <cstdint>
+
+// Record filter of an analysis request (AnalysisRequest::filter), e.g.
+//   level in (ERROR, FATAL) and ip in 10.0.0.0/8 and message contains "timeout"
+//
+// Grammar (keywords and field names are case-insensitive; a value is a bare
+// word or a "double-quoted" string with \" and \\ escapes):
+//   expr      := and_expr ("or" and_expr)*
+//   and_expr  := unary ("and" unary)*
+//   unary     := "not" unary | "(" expr ")" | predicate
+//   predicate := field ("=" | "!=") value
+//              | field ["not"] "in" (value | "(" value ("," value)* ")")
+//              | field "contains" value
+//   field     := user | ip | level | message
+// Levels compare case-insensitively; ip values may be IPv4 CIDR blocks.
+//
+// The expression is compiled into a tree of predicates evaluated over a
+// whole batch of parsed entries at a time: each predicate reads a single
+// field and narrows a selection vector of entry indexes. The operands of
+// every and/or are reordered cheapest first, so an expensive predicate
+// (a substring search) only sees the entries the cheap ones left, and an
+// and stops as soon as its selection is empty.
+class FilterProgram {
+public:
+    ~FilterProgram();
+
+    // Compile text; null with error set if it is not a valid expression.
+    // Blank text compiles to a program that selects every entry.
+    static std::unique_ptr<FilterProgram> compile(const std::string& text, std::string& error);
+
+    // Also require the entry's timestamp to be in the date range (isDateInRange)
+    void restrictDates(const std::optional<std::string>& startDate, const std::optional<std::string>& endDate);
+
+    // Replace selection with the indexes of the entries that pass, in order
+    void select(const std::pmr::vector<LogEntry>& entries, std::pmr::vector<uint32_t>& selection) const;
+
+    // EntryField bits of the fields the program reads
+    uint32_t fields() const;
+
+    // Canonical text of the compiled expression (in evaluation order)
+    std::string describe() const;
+
+    struct Node;
+
+private:
+    FilterProgram() = default;
+
+    std::unique_ptr<Node> root_;  // Null: every entry passes
+};
+
+#endif // FILTER_H
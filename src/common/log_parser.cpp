@@ -1,26 +1,61 @@
 #include "log_parser.h"
 #include "protocol.h"
+#include "compression.h"
+#include "metrics.h"
 #include <fstream>
-#include <sstream>
 #include <algorithm>
-#include <regex>
 #include <iostream>
 #include <filesystem>
 
 // Helper function to trim whitespace
-static inline std::string trim(const std::string& str) {
-    auto start = std::find_if_not(str.begin(), str.end(), [](unsigned char c) {
-        return std::isspace(c);
-    });
-    auto end = std::find_if_not(str.rbegin(), str.rend(), [](unsigned char c) {
-        return std::isspace(c);
-    }).base();
-    return (start < end) ? std::string(start, end) : std::string();
+static inline std::string_view trim(std::string_view str) {
+    size_t start = 0;
+    while (start < str.size() && std::isspace(static_cast<unsigned char>(str[start]))) {
+        start++;
+    }
+    size_t end = str.size();
+    while (end > start && std::isspace(static_cast<unsigned char>(str[end - 1]))) {
+        end--;
+    }
+    return str.substr(start, end - start);
+}
+
+// Call lineFunction for every line of content, as std::getline would split it
+template <typename Function>
+static void forEachLine(const std::string& content, Function lineFunction) {
+    size_t start = 0;
+    while (start < content.size()) {
+        size_t end = content.find('\n', start);
+        if (end == std::string::npos) {
+            end = content.size();
+        }
+        lineFunction(std::string_view(content.data() + start, end - start));
+        start = end + 1;
+    }
+}
+
+// Offset just past the last complete line for which isRecordEnd(trimmed line) holds
+template <typename Predicate>
+static size_t findLastRecordEnd(const std::string& content, Predicate isRecordEnd) {
+    size_t end = content.rfind('\n');
+    while (end != std::string::npos) {
+        size_t start = (end == 0) ? std::string::npos : content.rfind('\n', end - 1);
+        start = (start == std::string::npos) ? 0 : start + 1;
+        
+        if (isRecordEnd(trim(std::string_view(content.data() + start, end - start)))) {
+            return end + 1;
+        }
+        if (start == 0) {
+            break;
+        }
+        end = start - 1;
+    }
+    return 0;
 }
 
 LogFormat LogParser::detectFormat(const std::string& filename) {
-    // Detect format based on file extension
-    std::filesystem::path path(filename);
+    // Detect format based on file extension (the one under .gz, .zst, ...)
+    std::filesystem::path path(stripCompressionExtension(filename));
     std::string extension = path.extension().string();
     
     std::transform(extension.begin(), extension.end(), extension.begin(),
@@ -49,175 +84,220 @@ std::unique_ptr<LogParser> LogParser::createParser(const std::string& filename)
     }
 }
 
-// Simple JSON parser for log entries
-std::vector<LogEntry> JsonLogParser::parse(const std::string& content) {
-    std::vector<LogEntry> entries;
-    
-    // Simple JSON parsing - in a production system, use a proper JSON library
-    std::istringstream iss(content);
-    std::string line;
-    
-    // Regex patterns for extracting JSON fields
-    std::regex timestampRegex("\"timestamp\"\\s*:\\s*\"([^\"]+)\"");
-    std::regex userRegex("\"user\"\\s*:\\s*\"([^\"]+)\"");
-    std::regex ipRegex("\"ip\"\\s*:\\s*\"([^\"]+)\"");
-    std::regex levelRegex("\"level\"\\s*:\\s*\"([^\"]+)\"");
-    std::regex messageRegex("\"message\"\\s*:\\s*\"([^\"]*)\"");
-    
-    LogEntry currentEntry;
-    bool inEntry = false;
-    
-    while (std::getline(iss, line)) {
-        line = trim(line);
-        
-        if (line == "{") {
-            inEntry = true;
-            currentEntry = LogEntry();
+std::vector<LogEntry> LogParser::parse(const std::string& content) {
+    std::pmr::vector<LogEntry> parsed;
+    parseInto(content, parsed);
+    return std::vector<LogEntry>(std::make_move_iterator(parsed.begin()), std::make_move_iterator(parsed.end()));
+}
+
+static void skipSpaces(std::string_view line, size_t& i) {
+    while (i < line.size() && std::isspace(static_cast<unsigned char>(line[i]))) {
+        i++;
+    }
+}
+
+// First match of "name"\s*:\s*"([^"]+)" in line ([^"]* if allowEmpty)
+static bool findJsonField(std::string_view line, std::string_view name, bool allowEmpty, std::string_view& value) {
+    for (size_t at = line.find(name); at != std::string_view::npos; at = line.find(name, at + 1)) {
+        size_t i = at + name.size();
+        if (at == 0 || line[at - 1] != '"' || i >= line.size() || line[i] != '"') {
+            continue;
         }
-        else if (line == "}" || line == "},") {
-            if (inEntry) {
-                entries.push_back(currentEntry);
-                inEntry = false;
-            }
+        skipSpaces(line, ++i);
+        if (i >= line.size() || line[i] != ':') {
+            continue;
         }
-        else if (inEntry) {
-            std::smatch match;
-            
-            if (std::regex_search(line, match, timestampRegex)) {
-                currentEntry.timestamp = match[1];
-            }
-            else if (std::regex_search(line, match, userRegex)) {
-                currentEntry.user = match[1];
-            }
-            else if (std::regex_search(line, match, ipRegex)) {
-                currentEntry.ip = match[1];
-            }
-            else if (std::regex_search(line, match, levelRegex)) {
-                currentEntry.level = match[1];
-            }
-            else if (std::regex_search(line, match, messageRegex)) {
-                currentEntry.message = match[1];
-            }
+        skipSpaces(line, ++i);
+        if (i >= line.size() || line[i] != '"') {
+            continue;
         }
+        size_t end = line.find('"', ++i);
+        if (end == std::string_view::npos || (end == i && !allowEmpty)) {
+            continue;
+        }
+        value = line.substr(i, end - i);
+        return true;
     }
-    
-    return entries;
+    return false;
 }
 
-// Simple XML parser for log entries
-std::vector<LogEntry> XmlLogParser::parse(const std::string& content) {
-    std::vector<LogEntry> entries;
-    
-    // Simple XML parsing - in a production system, use a proper XML library
-    std::istringstream iss(content);
-    std::string line;
-    
-    // Regex patterns for extracting XML fields
-    std::regex entryStartRegex("<entry>");
-    std::regex entryEndRegex("</entry>");
-    std::regex timestampRegex("<timestamp>([^<]+)</timestamp>");
-    std::regex userRegex("<user>([^<]+)</user>");
-    std::regex ipRegex("<ip>([^<]+)</ip>");
-    std::regex levelRegex("<level>([^<]+)</level>");
-    std::regex messageRegex("<message>([^<]*)</message>");
-    
-    LogEntry currentEntry;
+// First match of <name>([^<]+)</name> in line ([^<]* if allowEmpty)
+static bool findXmlField(std::string_view line, std::string_view name, bool allowEmpty, std::string_view& value) {
+    for (size_t at = line.find(name); at != std::string_view::npos; at = line.find(name, at + 1)) {
+        size_t i = at + name.size();
+        if (at == 0 || line[at - 1] != '<' || i >= line.size() || line[i] != '>') {
+            continue;
+        }
+        size_t end = line.find('<', ++i);
+        if (end == std::string_view::npos || (end == i && !allowEmpty)) {
+            continue;
+        }
+        std::string_view close = line.substr(end);
+        if (close.size() < name.size() + 3 || close.substr(0, 2) != "</" || close.substr(2, name.size()) != name ||
+            close[name.size() + 2] != '>') {
+            continue;
+        }
+        value = line.substr(i, end - i);
+        return true;
+    }
+    return false;
+}
+
+// How a line-based format marks records and fields. Fields are matched by
+// hand rather than with std::regex, which allocates on every search.
+struct RecordFormat {
+    bool (*isStart)(std::string_view line);
+    bool (*isEnd)(std::string_view line);
+    bool (*findField)(std::string_view line, std::string_view name, bool allowEmpty, std::string_view& value);
+};
+
+// One record of the line-based formats: a start line, field lines, an end line
+static void parseRecords(const std::string& content, const RecordFormat& format,
+                         std::pmr::vector<LogEntry>& entries) {
+    std::pmr::memory_resource* resource = entries.get_allocator().resource();
+    LogEntry currentEntry(resource);
     bool inEntry = false;
     
-    while (std::getline(iss, line)) {
-        line = trim(line);
+    forEachLine(content, [&](std::string_view rawLine) {
+        std::string_view line = trim(rawLine);
         
-        if (std::regex_search(line, entryStartRegex)) {
+        if (format.isStart(line)) {
             inEntry = true;
-            currentEntry = LogEntry();
+            currentEntry = LogEntry(resource);
         }
-        else if (std::regex_search(line, entryEndRegex)) {
+        else if (format.isEnd(line)) {
             if (inEntry) {
-                entries.push_back(currentEntry);
+                // Moved, so the fields stay in the entries' resource
+                entries.push_back(std::move(currentEntry));
+                currentEntry = LogEntry(resource);
                 inEntry = false;
             }
         }
         else if (inEntry) {
-            std::smatch match;
-            
-            if (std::regex_search(line, match, timestampRegex)) {
-                currentEntry.timestamp = match[1];
-            }
-            else if (std::regex_search(line, match, userRegex)) {
-                currentEntry.user = match[1];
-            }
-            else if (std::regex_search(line, match, ipRegex)) {
-                currentEntry.ip = match[1];
-            }
-            else if (std::regex_search(line, match, levelRegex)) {
-                currentEntry.level = match[1];
-            }
-            else if (std::regex_search(line, match, messageRegex)) {
-                currentEntry.message = match[1];
+            // The first field found on the line is taken; only the message may be empty
+            std::pmr::string* fields[] = {&currentEntry.timestamp, &currentEntry.user, &currentEntry.ip,
+                                          &currentEntry.level, &currentEntry.message};
+            static const std::string_view names[] = {"timestamp", "user", "ip", "level", "message"};
+            std::string_view value;
+            for (size_t i = 0; i < 5; ++i) {
+                if (format.findField(line, names[i], i == 4, value)) {
+                    fields[i]->assign(value);
+                    break;
+                }
             }
         }
+    });
+}
+
+// Simple JSON parser for log entries
+void JsonLogParser::parseInto(const std::string& content, std::pmr::vector<LogEntry>& entries) {
+    // Simple JSON parsing - in a production system, use a proper JSON library
+    static const RecordFormat format = {
+        [](std::string_view line) { return line == "{"; },
+        [](std::string_view line) { return line == "}" || line == "},"; },
+        findJsonField};
+    parseRecords(content, format, entries);
+}
+
+size_t JsonLogParser::lastRecordBoundary(const std::string& content) const {
+    return findLastRecordEnd(content, [](std::string_view line) {
+        return line == "}" || line == "},";
+    });
+}
+
+// Simple XML parser for log entries
+void XmlLogParser::parseInto(const std::string& content, std::pmr::vector<LogEntry>& entries) {
+    // Simple XML parsing - in a production system, use a proper XML library
+    static const RecordFormat format = {
+        [](std::string_view line) { return line.find("<entry>") != std::string_view::npos; },
+        [](std::string_view line) { return line.find("</entry>") != std::string_view::npos; },
+        findXmlField};
+    parseRecords(content, format, entries);
+}
+
+size_t XmlLogParser::lastRecordBoundary(const std::string& content) const {
+    return findLastRecordEnd(content, [](std::string_view line) {
+        return line.find("</entry>") != std::string::npos;
+    });
+}
+
+// Next field of a delimited line, as std::getline(stream, field, delimiter) reads it
+static std::string_view nextField(std::string_view& rest, char delimiter) {
+    size_t end = rest.find(delimiter);
+    std::string_view field = rest.substr(0, end);
+    rest = (end == std::string_view::npos) ? std::string_view() : rest.substr(end + 1);
+    return field;
+}
+
+// Next whitespace-separated token, as stream >> token reads it
+static std::string_view nextToken(std::string_view& rest) {
+    size_t start = 0;
+    while (start < rest.size() && std::isspace(static_cast<unsigned char>(rest[start]))) {
+        start++;
     }
-    
-    return entries;
+    size_t end = start;
+    while (end < rest.size() && !std::isspace(static_cast<unsigned char>(rest[end]))) {
+        end++;
+    }
+    std::string_view token = rest.substr(start, end - start);
+    rest = rest.substr(end);
+    return token;
 }
 
 // Simple TXT parser for log entries - assumes a specific format
-std::vector<LogEntry> TxtLogParser::parse(const std::string& content) {
-    std::vector<LogEntry> entries;
+void TxtLogParser::parseInto(const std::string& content, std::pmr::vector<LogEntry>& entries) {
+    std::pmr::memory_resource* resource = entries.get_allocator().resource();
     
     // Assume tab or pipe delimited format: timestamp|user|ip|level|message
-    std::istringstream iss(content);
-    std::string line;
-    
-    while (std::getline(iss, line)) {
-        line = trim(line);
+    forEachLine(content, [&](std::string_view rawLine) {
+        std::string_view line = trim(rawLine);
         if (line.empty() || line[0] == '#') {
-            continue;  // Skip empty lines or comments
+            return;  // Skip empty lines or comments
         }
         
-        LogEntry entry;
-        std::istringstream lineStream(line);
-        std::string token;
+        std::string_view fields[5];
+        std::string_view rest = line;
         
-        // Try to parse as pipe-delimited
-        if (line.find('|') != std::string::npos) {
-            std::getline(lineStream, entry.timestamp, '|');
-            std::getline(lineStream, entry.user, '|');
-            std::getline(lineStream, entry.ip, '|');
-            std::getline(lineStream, entry.level, '|');
-            std::getline(lineStream, entry.message);
-        }
-        // Try to parse as tab-delimited
-        else if (line.find('\t') != std::string::npos) {
-            std::getline(lineStream, entry.timestamp, '\t');
-            std::getline(lineStream, entry.user, '\t');
-            std::getline(lineStream, entry.ip, '\t');
-            std::getline(lineStream, entry.level, '\t');
-            std::getline(lineStream, entry.message);
+        // Try to parse as pipe-delimited, then tab-delimited
+        char delimiter = (line.find('|') != std::string_view::npos) ? '|'
+                       : (line.find('\t') != std::string_view::npos) ? '\t' : ' ';
+        if (delimiter != ' ') {
+            for (int i = 0; i < 4; ++i) {
+                fields[i] = nextField(rest, delimiter);
+            }
+            fields[4] = rest;
         }
         // Try to parse as space-delimited (assuming message can contain spaces)
         else {
-            std::istringstream spaceStream(line);
-            spaceStream >> entry.timestamp >> entry.user >> entry.ip >> entry.level;
-            
+            for (int i = 0; i < 4; ++i) {
+                fields[i] = nextToken(rest);
+            }
             // Rest of the line is the message
-            std::getline(spaceStream, entry.message);
-            entry.message = trim(entry.message);
+            fields[4] = rest;
         }
         
         // Trim all fields
-        entry.timestamp = trim(entry.timestamp);
-        entry.user = trim(entry.user);
-        entry.ip = trim(entry.ip);
-        entry.level = trim(entry.level);
-        entry.message = trim(entry.message);
+        for (auto& field : fields) {
+            field = trim(field);
+        }
         
         // Add valid entries only
-        if (!entry.timestamp.empty() && !entry.user.empty() && 
-            !entry.ip.empty() && !entry.level.empty()) {
-            entries.push_back(entry);
+        if (!fields[0].empty() && !fields[1].empty() && !fields[2].empty() && !fields[3].empty()) {
+            LogEntry& entry = entries.emplace_back(resource);
+            entry.timestamp.assign(fields[0]);
+            entry.user.assign(fields[1]);
+            entry.ip.assign(fields[2]);
+            entry.level.assign(fields[3]);
+            entry.message.assign(fields[4]);
         }
-    }
-    
-    return entries;
-}
\ No newline at end of file
+        else {
+            Metrics::add(MetricCounter::PARSE_ERRORS, 1);
+        }
+    });
+}
+
+size_t TxtLogParser::lastRecordBoundary(const std::string& content) const {
+    // Every line is a record
+    size_t end = content.rfind('\n');
+    return (end == std::string::npos) ? 0 : end + 1;
+}
@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <memory_resource>
 
 enum class LogFormat {
     JSON,
@@ -22,23 +23,34 @@ public:
     static std::unique_ptr<LogParser> createParser(const std::string& filename);
     static LogFormat detectFormat(const std::string& filename);
     
-    // Interface for parsing logs
-    virtual std::vector<LogEntry> parse(const std::string& content) = 0;
+    // Interface for parsing logs: entries are appended to entries, with
+    // their fields allocated from its memory resource
+    virtual void parseInto(const std::string& content, std::pmr::vector<LogEntry>& entries) = 0;
+    
+    // Entries on the heap
+    std::vector<LogEntry> parse(const std::string& content);
+    
+    // Offset just past the last complete record in content (0 if none), so a
+    // partially received file can be split into independently parseable pieces
+    virtual size_t lastRecordBoundary(const std::string& content) const = 0;
 };
 
 class JsonLogParser : public LogParser {
 public:
-    std::vector<LogEntry> parse(const std::string& content) override;
+    void parseInto(const std::string& content, std::pmr::vector<LogEntry>& entries) override;
+    size_t lastRecordBoundary(const std::string& content) const override;
 };
 
 class XmlLogParser : public LogParser {
 public:
-    std::vector<LogEntry> parse(const std::string& content) override;
+    void parseInto(const std::string& content, std::pmr::vector<LogEntry>& entries) override;
+    size_t lastRecordBoundary(const std::string& content) const override;
 };
 
 class TxtLogParser : public LogParser {
 public:
-    std::vector<LogEntry> parse(const std::string& content) override;
+    void parseInto(const std::string& content, std::pmr::vector<LogEntry>& entries) override;
+    size_t lastRecordBoundary(const std::string& content) const override;
 };
 
 #endif // LOG_PARSER_H
\ No newline at end of file
@@ -0,0 +1,400 @@
+#include "common/metrics.h"
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <sstream>
+#include <algorithm>
+
+#include <fstream>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+constexpr size_t STAGE_COUNT = static_cast<size_t>(MetricStage::COUNT);
+constexpr size_t COUNTER_COUNT = static_cast<size_t>(MetricCounter::COUNT);
+
+// Log-linear buckets over nanoseconds: values below 16 get their own bucket,
+// above that each power of two is split into 16
+constexpr int SUB_BUCKET_BITS = 4;
+constexpr uint64_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+constexpr size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+// Name in stats replies, and Prometheus metric family and label
+struct MetricName {
+    const char* name;
+    const char* family;
+    const char* label;
+};
+
+static const MetricName STAGE_NAMES[STAGE_COUNT] = {
+    {"receive", "stage_duration_seconds", "stage=\"receive\""},
+    {"spill", "stage_duration_seconds", "stage=\"spill\""},
+    {"queue_wait", "stage_duration_seconds", "stage=\"queue_wait\""},
+    {"parse", "stage_duration_seconds", "stage=\"parse\""},
+    {"aggregate", "stage_duration_seconds", "stage=\"aggregate\""},
+    {"merge", "stage_duration_seconds", "stage=\"merge\""},
+    {"serialize", "stage_duration_seconds", "stage=\"serialize\""},
+    {"request_user", "request_duration_seconds", "type=\"USER\""},
+    {"request_ip", "request_duration_seconds", "type=\"IP\""},
+    {"request_log_level", "request_duration_seconds", "type=\"LOG_LEVEL\""},
+    {"request_pattern", "request_duration_seconds", "type=\"PATTERN\""}};
+static const MetricName COUNTER_NAMES[COUNTER_COUNT] = {
+    {"bytes_received", "bytes_received_total", ""},
+    {"bytes_spilled", "bytes_spilled_total", ""},
+    {"bytes_parsed", "bytes_parsed_total", ""},
+    {"records_json", "records_parsed_total", "format=\"json\""},
+    {"records_xml", "records_parsed_total", "format=\"xml\""},
+    {"records_txt", "records_parsed_total", "format=\"txt\""},
+    {"parse_errors", "parse_errors_total", ""},
+    {"requests_completed", "requests_completed_total", ""},
+    {"worker_busy_us", "worker_busy_seconds_total", ""},
+    {"bytes_deduplicated", "bytes_deduplicated_total", ""},
+    {"piece_cache_hits", "piece_cache_hits_total", ""},
+    {"piece_cache_misses", "piece_cache_misses_total", ""},
+    {"result_cache_hits", "result_cache_hits_total", ""},
+    {"result_cache_misses", "result_cache_misses_total", ""}};
+
+// Upper bounds of the Prometheus histogram buckets, in seconds
+static const double PROMETHEUS_BOUNDS[] = {0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1,
+                                           0.5,    1,      2.5,   5,     10,   30,   60};
+
+static int highestBit(uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<int>(index);
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+static size_t bucketOf(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return static_cast<size_t>(value);
+    }
+    int shift = highestBit(value) - SUB_BUCKET_BITS;
+    return static_cast<size_t>((shift + 1) * SUB_BUCKETS + ((value >> shift) & (SUB_BUCKETS - 1)));
+}
+
+// Largest value that falls in a bucket
+static uint64_t bucketLimit(size_t bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    int shift = static_cast<int>(bucket / SUB_BUCKETS) - 1;
+    uint64_t lower = (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return lower + ((uint64_t(1) << shift) - 1);
+}
+
+namespace {
+
+// Written by one thread at a time, read by collectStats
+struct ThreadBlock {
+    std::atomic<uint64_t> buckets[STAGE_COUNT][BUCKET_COUNT];
+    std::atomic<uint64_t> counts[STAGE_COUNT];
+    std::atomic<uint64_t> totals[STAGE_COUNT];
+    std::atomic<uint64_t> maxima[STAGE_COUNT];
+    std::atomic<uint64_t> counters[COUNTER_COUNT];
+};
+
+class Registry {
+public:
+    ThreadBlock* acquire() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_.empty()) {
+            ThreadBlock* block = free_.back();
+            free_.pop_back();
+            return block;
+        }
+        blocks_.emplace_back(new ThreadBlock());  // Value-initialized: all zero
+        return blocks_.back().get();
+    }
+
+    // The block keeps its values: they still count towards the totals
+    void release(ThreadBlock* block) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(block);
+    }
+
+    template <typename Function>
+    void forEach(Function function) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& block : blocks_) {
+            function(*block);
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadBlock>> blocks_;
+    std::vector<ThreadBlock*> free_;
+};
+
+// Never destroyed: threads may still record during static destruction
+Registry& registry() {
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+struct ThreadHandle {
+    ThreadBlock* block = nullptr;
+    ~ThreadHandle() {
+        if (block) {
+            registry().release(block);
+        }
+    }
+};
+
+ThreadBlock& localBlock() {
+    thread_local ThreadHandle handle;
+    if (!handle.block) {
+        handle.block = registry().acquire();
+    }
+    return *handle.block;
+}
+
+// Only the owning thread writes, so a plain load and store is enough
+void bump(std::atomic<uint64_t>& value, uint64_t amount) {
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+} // namespace
+
+void Metrics::record(MetricStage stage, std::chrono::steady_clock::duration elapsed) {
+    size_t index = static_cast<size_t>(stage);
+    uint64_t nanoseconds = static_cast<uint64_t>(std::max<int64_t>(
+        0, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    ThreadBlock& block = localBlock();
+    bump(block.buckets[index][bucketOf(nanoseconds)], 1);
+    bump(block.counts[index], 1);
+    bump(block.totals[index], nanoseconds);
+    if (nanoseconds > block.maxima[index].load(std::memory_order_relaxed)) {
+        block.maxima[index].store(nanoseconds, std::memory_order_relaxed);
+    }
+}
+
+void Metrics::add(MetricCounter counter, uint64_t value) {
+    bump(localBlock().counters[static_cast<size_t>(counter)], value);
+}
+
+namespace {
+
+// Every thread's values summed
+struct Totals {
+    std::vector<uint64_t> buckets = std::vector<uint64_t>(STAGE_COUNT * BUCKET_COUNT, 0);
+    uint64_t counts[STAGE_COUNT] = {};
+    uint64_t totals[STAGE_COUNT] = {};
+    uint64_t maxima[STAGE_COUNT] = {};
+    uint64_t counters[COUNTER_COUNT] = {};
+
+    const uint64_t* histogram(size_t stage) const {
+        return &buckets[stage * BUCKET_COUNT];
+    }
+
+    // Bucket counts may be read a little ahead of the count: use their sum
+    uint64_t countOf(size_t stage) const {
+        uint64_t count = 0;
+        for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+            count += histogram(stage)[bucket];
+        }
+        return count;
+    }
+};
+
+Totals sumBlocks() {
+    Totals sum;
+    registry().forEach([&](const ThreadBlock& block) {
+        for (size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+            for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+                sum.buckets[stage * BUCKET_COUNT + bucket] += block.buckets[stage][bucket].load(std::memory_order_relaxed);
+            }
+            sum.counts[stage] += block.counts[stage].load(std::memory_order_relaxed);
+            sum.totals[stage] += block.totals[stage].load(std::memory_order_relaxed);
+            sum.maxima[stage] = std::max(sum.maxima[stage], block.maxima[stage].load(std::memory_order_relaxed));
+        }
+        for (size_t counter = 0; counter < COUNTER_COUNT; ++counter) {
+            sum.counters[counter] += block.counters[counter].load(std::memory_order_relaxed);
+        }
+    });
+    return sum;
+}
+
+} // namespace
+
+ServerStats collectStats() {
+    Totals sum = sumBlocks();
+    ServerStats stats;
+    for (size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+        StageStats stageStats;
+        stageStats.name = STAGE_NAMES[stage].name;
+        stageStats.totalUs = sum.totals[stage] / 1000;
+        stageStats.maxUs = sum.maxima[stage] / 1000;
+        stageStats.count = sum.countOf(stage);
+
+        const uint64_t* histogram = sum.histogram(stage);
+        uint64_t* targets[] = {&stageStats.p50Us, &stageStats.p90Us, &stageStats.p99Us};
+        const double quantiles[] = {0.50, 0.90, 0.99};
+        uint64_t seen = 0;
+        size_t next = 0;
+        for (size_t bucket = 0; bucket < BUCKET_COUNT && next < 3 && stageStats.count > 0; ++bucket) {
+            seen += histogram[bucket];
+            while (next < 3 && seen >= quantiles[next] * stageStats.count && seen > 0) {
+                *targets[next++] = std::min(bucketLimit(bucket), sum.maxima[stage]) / 1000;
+            }
+        }
+        stats.stages.push_back(stageStats);
+    }
+    for (size_t counter = 0; counter < COUNTER_COUNT; ++counter) {
+        stats.counters.emplace_back(COUNTER_NAMES[counter].name, sum.counters[counter]);
+    }
+    return stats;
+}
+
+uint64_t residentMemoryBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.WorkingSetSize;
+    }
+    return 0;
+#else
+    // Second field of statm: resident pages
+    std::ifstream statm("/proc/self/statm");
+    uint64_t totalPages = 0;
+    uint64_t residentPages = 0;
+    if (!(statm >> totalPages >> residentPages)) {
+        return 0;
+    }
+    return residentPages * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+// One sample line: family{label} value
+static void writeSample(std::ostream& out, const std::string& family, const std::string& label, double value) {
+    out << "log_analyzer_" << family;
+    if (!label.empty()) {
+        out << "{" << label << "}";
+    }
+    out << " " << value << "\n";
+}
+
+static void writeHeader(std::ostream& out, const std::string& family, const char* type) {
+    out << "# TYPE log_analyzer_" << family << " " << type << "\n";
+}
+
+std::string formatPrometheus(const std::vector<std::pair<std::string, uint64_t>>& gauges) {
+    Totals sum = sumBlocks();
+    std::ostringstream out;
+    out.precision(12);
+
+    // Histograms: a bucket counts towards a bound if all its values are below it
+    const char* family = nullptr;
+    for (size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+        const MetricName& name = STAGE_NAMES[stage];
+        if (!family || std::string(family) != name.family) {
+            family = name.family;
+            writeHeader(out, family, "histogram");
+        }
+        const uint64_t* histogram = sum.histogram(stage);
+        std::string label = std::string(name.label) + ",";
+        uint64_t cumulative = 0;
+        size_t bucket = 0;
+        for (double bound : PROMETHEUS_BOUNDS) {
+            uint64_t limit = static_cast<uint64_t>(bound * 1e9);
+            for (; bucket < BUCKET_COUNT && bucketLimit(bucket) <= limit; ++bucket) {
+                cumulative += histogram[bucket];
+            }
+            std::ostringstream le;
+            le << bound;
+            writeSample(out, std::string(family) + "_bucket", label + "le=\"" + le.str() + "\"",
+                        static_cast<double>(cumulative));
+        }
+        uint64_t count = sum.countOf(stage);
+        writeSample(out, std::string(family) + "_bucket", label + "le=\"+Inf\"", static_cast<double>(count));
+        writeSample(out, std::string(family) + "_sum", name.label, sum.totals[stage] / 1e9);
+        writeSample(out, std::string(family) + "_count", name.label, static_cast<double>(count));
+    }
+
+    family = nullptr;
+    for (size_t counter = 0; counter < COUNTER_COUNT; ++counter) {
+        const MetricName& name = COUNTER_NAMES[counter];
+        if (!family || std::string(family) != name.family) {
+            family = name.family;
+            // Prometheus names the family without the _total suffix
+            std::string base(family);
+            writeHeader(out, base.substr(0, base.size() - 6), "counter");
+        }
+        double value = static_cast<double>(sum.counters[counter]);
+        if (static_cast<MetricCounter>(counter) == MetricCounter::WORKER_BUSY_US) {
+            value /= 1e6;
+        }
+        writeSample(out, family, name.label, value);
+    }
+
+    for (const auto& gauge : gauges) {
+        writeHeader(out, gauge.first, "gauge");
+        writeSample(out, gauge.first, "", static_cast<double>(gauge.second));
+    }
+    return out.str();
+}
+
+std::string serializeStats(const ServerStats& stats) {
+    std::ostringstream out;
+    for (const auto& stage : stats.stages) {
+        out << "stage|" << stage.name << "|" << stage.count << "|" << stage.totalUs << "|" << stage.p50Us << "|"
+            << stage.p90Us << "|" << stage.p99Us << "|" << stage.maxUs << "\n";
+    }
+    for (const auto& counter : stats.counters) {
+        out << "counter|" << counter.first << "|" << counter.second << "\n";
+    }
+    for (const auto& gauge : stats.gauges) {
+        out << "gauge|" << gauge.first << "|" << gauge.second << "\n";
+    }
+    return out.str();
+}
+
+ServerStats deserializeStats(const std::string& data) {
+    ServerStats stats;
+    std::istringstream in(data);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::vector<std::string> fields;
+        std::istringstream lineStream(line);
+        std::string field;
+        while (std::getline(lineStream, field, '|')) {
+            fields.push_back(field);
+        }
+
+        // Unknown or malformed lines are skipped (e.g. from a newer server)
+        try {
+            if (fields.size() == 8 && fields[0] == "stage") {
+                StageStats stage;
+                stage.name = fields[1];
+                stage.count = std::stoull(fields[2]);
+                stage.totalUs = std::stoull(fields[3]);
+                stage.p50Us = std::stoull(fields[4]);
+                stage.p90Us = std::stoull(fields[5]);
+                stage.p99Us = std::stoull(fields[6]);
+                stage.maxUs = std::stoull(fields[7]);
+                stats.stages.push_back(stage);
+            }
+            else if (fields.size() == 3 && fields[0] == "counter") {
+                stats.counters.emplace_back(fields[1], std::stoull(fields[2]));
+            }
+            else if (fields.size() == 3 && fields[0] == "gauge") {
+                stats.gauges.emplace_back(fields[1], std::stoull(fields[2]));
+            }
+        }
+        catch (const std::exception&) {
+            continue;
+        }
+    }
+    return stats;
+}
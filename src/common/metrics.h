@@ -0,0 +1,107 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+// Stages of a request that are timed
+enum class MetricStage {
+    RECEIVE,     // One file, from MSG_FILE_START to MSG_FILE_END
+    SPILL,       // Writing received data to a temp file
+    QUEUE_WAIT,  // Analysis job waiting for a worker
+    PARSE,       // Parsing one piece of a file
+    AGGREGATE,   // Counting a piece's entries
+    MERGE,       // Merging a job's counts into the request result
+    SERIALIZE,   // Encoding one result frame
+    // Whole request, from admission to the last result frame, per AnalysisType
+    REQUEST_USER,
+    REQUEST_IP,
+    REQUEST_LOG_LEVEL,
+    REQUEST_PATTERN,
+    COUNT
+};
+
+enum class MetricCounter {
+    BYTES_RECEIVED,
+    BYTES_SPILLED,
+    BYTES_PARSED,
+    RECORDS_JSON,      // Records parsed, per input format
+    RECORDS_XML,
+    RECORDS_TXT,
+    PARSE_ERRORS,      // Rejected lines, and pieces or files that failed to parse
+    REQUESTS_COMPLETED,
+    WORKER_BUSY_US,    // Time worker threads spent running tasks
+    BYTES_DEDUPLICATED,  // Upload bytes not sent because the server had them (MSG_MANIFEST)
+    PIECE_CACHE_HITS,    // Manifest pieces found in the piece cache
+    PIECE_CACHE_MISSES,
+    RESULT_CACHE_HITS,   // Piece or dataset results answered from the result cache
+    RESULT_CACHE_MISSES,
+    COUNT
+};
+
+// Per-stage latency histograms and counters for the whole process.
+//
+// Every thread records into its own block (HDR-style log-linear buckets,
+// 16 per power of two, so values are within about 6%), written only by that
+// thread with relaxed atomic stores: recording takes no lock and shares no
+// cache line with other threads. Blocks of threads that exit are reused by
+// new threads, so thread-per-client servers do not grow without bound.
+// Readers sum all blocks, which is only done when stats are requested.
+class Metrics {
+public:
+    static void record(MetricStage stage, std::chrono::steady_clock::duration elapsed);
+    static void add(MetricCounter counter, uint64_t value);
+};
+
+// Records the time until it goes out of scope
+class StageTimer {
+public:
+    explicit StageTimer(MetricStage stage) : stage_(stage), start_(std::chrono::steady_clock::now()) {}
+    ~StageTimer() {
+        Metrics::record(stage_, std::chrono::steady_clock::now() - start_);
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    MetricStage stage_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Aggregated view, sent in reply to MSG_STATS
+struct StageStats {
+    std::string name;
+    uint64_t count = 0;
+    uint64_t totalUs = 0;
+    uint64_t p50Us = 0;
+    uint64_t p90Us = 0;
+    uint64_t p99Us = 0;
+    uint64_t maxUs = 0;
+};
+
+struct ServerStats {
+    std::vector<StageStats> stages;
+    std::vector<std::pair<std::string, uint64_t>> counters;
+    std::vector<std::pair<std::string, uint64_t>> gauges;  // Filled in by the server
+};
+
+// Sum of every thread's histograms and counters
+ServerStats collectStats();
+
+// Text form: one "stage|name|count|total|p50|p90|p99|max", "counter|name|value"
+// or "gauge|name|value" line per item
+std::string serializeStats(const ServerStats& stats);
+ServerStats deserializeStats(const std::string& data);
+
+// Resident set size of this process (0 where unknown)
+uint64_t residentMemoryBytes();
+
+// Same sums in the Prometheus text exposition format (version 0.0.4): stage
+// and request durations as histograms in seconds, counters as *_total, and
+// the given gauges, all prefixed with "log_analyzer_"
+std::string formatPrometheus(const std::vector<std::pair<std::string, uint64_t>>& gauges);
+
+#endif // METRICS_H
@@ -0,0 +1,78 @@
+#include "common/pattern_matcher.h"
+#include <unordered_set>
+#include <deque>
+
+PatternMatcher::PatternMatcher(const std::vector<std::string>& patterns) : byteClass_{}, classCount_(1) {
+    // Distinct non-empty patterns, in the order given
+    std::unordered_set<std::string_view> seen;
+    patterns_.reserve(patterns.size());
+    for (const auto& pattern : patterns) {
+        if (!pattern.empty() && seen.insert(pattern).second) {
+            patterns_.push_back(pattern);
+        }
+    }
+
+    // Class 0 stands for every byte no pattern uses
+    for (const auto& pattern : patterns_) {
+        for (unsigned char c : pattern) {
+            if (byteClass_[c] == 0) {
+                byteClass_[c] = static_cast<uint16_t>(classCount_++);
+            }
+        }
+    }
+
+    // Trie of the patterns; 0 marks a missing edge (no edge leads back to the root)
+    transitions_.assign(classCount_, 0);
+    terminal_.assign(1, -1);
+    for (size_t index = 0; index < patterns_.size(); ++index) {
+        uint32_t state = 0;
+        for (unsigned char c : patterns_[index]) {
+            uint32_t& next = transitions_[state * classCount_ + byteClass_[c]];
+            if (next == 0) {
+                next = static_cast<uint32_t>(terminal_.size());
+                terminal_.push_back(-1);
+                transitions_.resize(transitions_.size() + classCount_, 0);
+            }
+            // transitions_ may have moved: read the edge again
+            state = transitions_[state * classCount_ + byteClass_[c]];
+        }
+        terminal_[state] = static_cast<int32_t>(index);
+    }
+
+    // Breadth first, so a state's failure state is complete before it: fill
+    // the missing edges from the failure state and link the terminal suffixes
+    size_t stateCount = terminal_.size();
+    std::vector<uint32_t> failure(stateCount, 0);
+    match_.assign(stateCount, 0);
+    nextMatch_.assign(stateCount, 0);
+    std::deque<uint32_t> queue;
+    for (uint32_t c = 0; c < classCount_; ++c) {
+        uint32_t child = transitions_[c];
+        if (child != 0) {
+            match_[child] = terminal_[child] >= 0 ? child : 0;
+            queue.push_back(child);
+        }
+    }
+    while (!queue.empty()) {
+        uint32_t state = queue.front();
+        queue.pop_front();
+        for (uint32_t c = 0; c < classCount_; ++c) {
+            uint32_t& edge = transitions_[state * classCount_ + c];
+            uint32_t fallback = transitions_[failure[state] * classCount_ + c];
+            if (edge == 0) {
+                edge = fallback;
+                continue;
+            }
+            uint32_t child = edge;
+            failure[child] = fallback;
+            nextMatch_[child] = match_[fallback];
+            match_[child] = terminal_[child] >= 0 ? child : match_[fallback];
+            queue.push_back(child);
+        }
+    }
+}
+
+size_t PatternMatcher::memoryBytes() const {
+    return transitions_.size() * sizeof(uint32_t) +
+           terminal_.size() * (sizeof(int32_t) + 2 * sizeof(uint32_t));
+}
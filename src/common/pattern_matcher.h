@@ -0,0 +1,58 @@
+#ifndef PATTERN_MATCHER_H
+#define PATTERN_MATCHER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+// Finds every occurrence of a set of literal patterns in one pass over the
+// text (Aho-Corasick), for the PATTERN analysis.
+//
+// The automaton is compiled into a full transition table (failure links
+// already followed), so each byte of text costs one table lookup whatever
+// the number of patterns. Bytes are first mapped to classes, one per byte
+// value used by some pattern plus one for all the others, which keeps the
+// table at states x classes instead of states x 256. A state also knows the
+// nearest state ending a pattern along its suffix chain, so texts with no
+// match never walk that chain.
+class PatternMatcher {
+public:
+    // Duplicate patterns are kept once; empty patterns are ignored
+    explicit PatternMatcher(const std::vector<std::string>& patterns);
+
+    // Distinct patterns, indexed as reported by scan
+    size_t patternCount() const {
+        return patterns_.size();
+    }
+    const std::string& pattern(size_t index) const {
+        return patterns_[index];
+    }
+
+    // Call found(index) for every occurrence, at the position it ends
+    template <typename Found>
+    void scan(std::string_view text, Found found) const {
+        uint32_t state = 0;
+        const uint32_t* transitions = transitions_.data();
+        for (unsigned char c : text) {
+            state = transitions[state * classCount_ + byteClass_[c]];
+            for (uint32_t match = match_[state]; match != 0; match = nextMatch_[match]) {
+                found(static_cast<size_t>(terminal_[match]));
+            }
+        }
+    }
+
+    // Bytes taken by the automaton
+    size_t memoryBytes() const;
+
+private:
+    std::vector<std::string> patterns_;
+    uint16_t byteClass_[256];
+    uint32_t classCount_;
+    std::vector<uint32_t> transitions_;  // state * classCount_ + class -> state
+    std::vector<int32_t> terminal_;      // Pattern ending at the state, -1 if none
+    std::vector<uint32_t> match_;        // The state if terminal, else nearest terminal suffix state, 0 if none
+    std::vector<uint32_t> nextMatch_;    // Nearest terminal proper suffix state of a terminal state, 0 if none
+};
+
+#endif // PATTERN_MATCHER_H
@@ -4,6 +4,11 @@
 #include <iomanip>
 #include <cstring>
 #include <chrono>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
 
 #ifdef _WIN32
 bool initializeWinsock() {
@@ -21,15 +26,24 @@ void cleanupWinsock() {
 }
 #endif
 
-bool sendMessage(socket_t socket, char type, const std::string& message) {
-    // Format: [TYPE:1][LENGTH:8][MESSAGE:LENGTH]
+// Format: [TYPE:1][LENGTH:8][MESSAGE:LENGTH], length as 8 hex characters
+static std::string encodeHeader(char type, size_t length) {
     std::string header;
     header.push_back(type);
     
-    // Add message length as 8 hex characters
     std::stringstream ss;
-    ss << std::setw(8) << std::setfill('0') << std::hex << message.size();
+    ss << std::setw(8) << std::setfill('0') << std::hex << length;
     header += ss.str();
+    return header;
+}
+
+bool sendMessage(socket_t socket, char type, const std::string& message) {
+    if (message.size() > MAX_MESSAGE_SIZE) {
+        std::cerr << "Message of " << message.size() << " bytes is over the limit of " << MAX_MESSAGE_SIZE
+                  << std::endl;
+        return false;
+    }
+    std::string header = encodeHeader(type, message.size());
     
     // Send header
     int sent = send(socket, header.c_str(), 9, 0);
@@ -76,44 +90,165 @@ bool receiveMessage(socket_t socket, char& type, std::string& message) {
     header[9] = '\0';
     std::string lengthStr(header + 1, 8);
     unsigned long length = std::stoul(lengthStr, nullptr, 16);
+    if (length > MAX_MESSAGE_SIZE) {
+        std::cerr << "Message of " << length << " bytes is over the limit of " << MAX_MESSAGE_SIZE << std::endl;
+        return false;
+    }
     
-    // Prepare message buffer
-    message.clear();
-    message.reserve(length);
-    
-    // Receive message in chunks
-    char buffer[BUFFER_SIZE];
+    // Receive the body straight into the message buffer (no intermediate copy)
+    message.resize(length);
     totalReceived = 0;
     
     while (totalReceived < length) {
         size_t remaining = length - totalReceived;
-        size_t chunkSize = std::min(remaining, static_cast<size_t>(BUFFER_SIZE - 1));
         
-        received = recv(socket, buffer, static_cast<int>(chunkSize), 0);
+        received = recv(socket, &message[totalReceived], static_cast<int>(remaining), 0);
         if (received <= 0) {
             return false;
         }
         
-        buffer[received] = '\0';
-        message.append(buffer, received);
         totalReceived += received;
     }
     
     return true;
 }
 
+bool socketReadable(socket_t socket, int timeoutMs) {
+    struct pollfd pfd;
+    pfd.fd = socket;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+#ifdef _WIN32
+    return WSAPoll(&pfd, 1, timeoutMs) > 0;
+#else
+    return poll(&pfd, 1, timeoutMs) > 0;
+#endif
+}
+
+std::string encodeMessage(char type, const std::string& message) {
+    std::string encoded = encodeHeader(type, message.size());
+    encoded += message;
+    return encoded;
+}
+
+void MessageDecoder::feed(const char* data, size_t size) {
+    // Drop consumed bytes once they dominate the buffer
+    if (offset_ > 0 && offset_ >= buffer_.size() / 2) {
+        buffer_.erase(0, offset_);
+        offset_ = 0;
+    }
+    buffer_.append(data, size);
+}
+
+bool MessageDecoder::next(char& type, std::string& message) {
+    if (buffer_.size() - offset_ < 9) {
+        return false;
+    }
+    
+    const char* header = buffer_.data() + offset_;
+    size_t length = 0;
+    for (int i = 1; i <= 8; ++i) {
+        char c = header[i];
+        int digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else throw std::runtime_error("Malformed message header");
+        length = (length << 4) | static_cast<size_t>(digit);
+    }
+    // Rejected before any of the body is buffered
+    if (length > MAX_MESSAGE_SIZE) {
+        throw std::runtime_error("Message of " + std::to_string(length) + " bytes is over the limit of " +
+                                 std::to_string(MAX_MESSAGE_SIZE));
+    }
+    
+    if (buffer_.size() - offset_ < 9 + length) {
+        return false;
+    }
+    
+    type = header[0];
+    message.assign(buffer_, offset_ + 9, length);
+    offset_ += 9 + length;
+    return true;
+}
+
+size_t MessageDecoder::bufferedBytes() const {
+    return buffer_.size() - offset_;
+}
+
+// Patterns as one request field: comma-separated, with '\\', '|' and ','
+// escaped so that the field splits back exactly
+static std::string encodePatterns(const std::vector<std::string>& patterns) {
+    std::string field;
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        if (i > 0) {
+            field += ',';
+        }
+        for (char c : patterns[i]) {
+            switch (c) {
+                case '\\': field += "\\\\"; break;
+                case '|': field += "\\p"; break;
+                case ',': field += "\\c"; break;
+                default: field += c; break;
+            }
+        }
+    }
+    return field;
+}
+
+static std::vector<std::string> decodePatterns(const std::string& field) {
+    std::vector<std::string> patterns;
+    if (field.empty()) {
+        return patterns;
+    }
+    patterns.emplace_back();
+    for (size_t i = 0; i < field.size(); ++i) {
+        char c = field[i];
+        if (c == ',') {
+            patterns.emplace_back();
+        }
+        else if (c == '\\' && i + 1 < field.size()) {
+            char escaped = field[++i];
+            patterns.back() += escaped == 'p' ? '|' : escaped == 'c' ? ',' : escaped;
+        }
+        else {
+            patterns.back() += c;
+        }
+    }
+    return patterns;
+}
+
+static const char* patternGroupToString(PatternGroup group) {
+    switch (group) {
+        case PatternGroup::USER: return "USER";
+        case PatternGroup::LEVEL: return "LEVEL";
+        default: return "NONE";
+    }
+}
+
 std::string serializeRequest(const AnalysisRequest& request) {
     std::stringstream ss;
     ss << analysisTypeToString(request.type) << "|"
        << (request.startDate.has_value() ? request.startDate.value() : "NONE") << "|"
-       << (request.endDate.has_value() ? request.endDate.value() : "NONE");
+       << (request.endDate.has_value() ? request.endDate.value() : "NONE") << "|"
+       << request.progressIntervalMs << "|"
+       << request.expectedBytes << "|"
+       << (request.follow ? 1 : 0) << "|"
+       << (request.trace ? 1 : 0) << "|"
+       << patternGroupToString(request.patternGroup) << "|"
+       << encodePatterns(request.patterns) << "|"
+       << request.storeAs << "|"
+       << request.dataset << "|"
+       << (request.session ? 1 : 0) << "|"
+       << request.filter;  // Last: the expression may contain '|'
     return ss.str();
 }
 
 AnalysisRequest deserializeRequest(const std::string& data) {
     AnalysisRequest request;
     std::stringstream ss(data);
-    std::string typeStr, startDate, endDate;
+    std::string typeStr, startDate, endDate, progressMs, expectedBytes, follow, trace, group, patterns;
+    std::string storeAs, dataset, session;
     
     std::getline(ss, typeStr, '|');
     std::getline(ss, startDate, '|');
@@ -121,6 +256,40 @@ AnalysisRequest deserializeRequest(const std::string& data) {
     
     request.type = stringToAnalysisType(typeStr);
     
+    // Optional fields (absent in requests from older clients)
+    if (std::getline(ss, progressMs, '|') && !progressMs.empty()) {
+        request.progressIntervalMs = static_cast<uint32_t>(std::stoul(progressMs));
+    }
+    if (std::getline(ss, expectedBytes, '|') && !expectedBytes.empty()) {
+        request.expectedBytes = std::stoull(expectedBytes);
+    }
+    if (std::getline(ss, follow, '|')) {
+        request.follow = (follow == "1");
+    }
+    if (std::getline(ss, trace, '|')) {
+        request.trace = (trace == "1");
+    }
+    if (std::getline(ss, group, '|')) {
+        request.patternGroup = group == "USER" ? PatternGroup::USER
+                             : group == "LEVEL" ? PatternGroup::LEVEL : PatternGroup::NONE;
+    }
+    if (std::getline(ss, patterns, '|')) {
+        request.patterns = decodePatterns(patterns);
+    }
+    if (std::getline(ss, storeAs, '|')) {
+        request.storeAs = storeAs;
+    }
+    if (std::getline(ss, dataset, '|')) {
+        request.dataset = dataset;
+    }
+    if (std::getline(ss, session, '|')) {
+        request.session = (session == "1");
+    }
+    std::streamoff filterStart = ss.tellg();
+    if (filterStart > 0 && static_cast<size_t>(filterStart) < data.size()) {
+        request.filter = data.substr(static_cast<size_t>(filterStart));
+    }
+    
     if (startDate != "NONE") {
         request.startDate = startDate;
     }
@@ -132,6 +301,14 @@ AnalysisRequest deserializeRequest(const std::string& data) {
     return request;
 }
 
+size_t patternBytes(const std::vector<std::string>& patterns) {
+    size_t bytes = 0;
+    for (const auto& pattern : patterns) {
+        bytes += pattern.size();
+    }
+    return bytes;
+}
+
 std::string serializeResult(const AnalysisResult& result) {
     std::stringstream ss;
     ss << analysisTypeToString(result.type) << "|"
@@ -155,7 +332,7 @@ AnalysisResult deserializeResult(const std::string& data) {
     result.type = stringToAnalysisType(typeStr);
     
     std::getline(ss, token, '|');
-    result.totalEntries = std::stoi(token);
+    result.totalEntries = std::stoull(token);
     
     std::getline(ss, token, '|');
     countSize = std::stoull(token);
@@ -164,14 +341,21 @@ AnalysisResult deserializeResult(const std::string& data) {
         std::string key, valueStr;
         std::getline(ss, key, '|');
         std::getline(ss, valueStr, '|');
-        int value = std::stoi(valueStr);
+        uint64_t value = std::stoull(valueStr);
         result.counts[key] = value;
     }
     
     return result;
 }
 
-bool isDateInRange(const std::string& date,
+void mergeResult(AnalysisResult& target, const AnalysisResult& partial) {
+    for (const auto& pair : partial.counts) {
+        target.counts[pair.first] += pair.second;
+    }
+    target.totalEntries += partial.totalEntries;
+}
+
+bool isDateInRange(std::string_view date,
                   const std::optional<std::string>& startDate,
                   const std::optional<std::string>& endDate) {
     // If no date range specified, include all
@@ -195,6 +379,7 @@ AnalysisType stringToAnalysisType(const std::string& typeStr) {
     if (typeStr == "USER") return AnalysisType::USER;
     if (typeStr == "IP") return AnalysisType::IP;
     if (typeStr == "LOG_LEVEL") return AnalysisType::LOG_LEVEL;
+    if (typeStr == "PATTERN") return AnalysisType::PATTERN;
     
     // Default
     return AnalysisType::USER;
@@ -205,6 +390,7 @@ std::string analysisTypeToString(AnalysisType type) {
         case AnalysisType::USER: return "USER";
         case AnalysisType::IP: return "IP";
         case AnalysisType::LOG_LEVEL: return "LOG_LEVEL";
+        case AnalysisType::PATTERN: return "PATTERN";
         default: return "UNKNOWN";
     }
 }
@@ -17,38 +17,85 @@
 #include <vector>
 #include <unordered_map>
 #include <optional>
+#include <string_view>
+#include <memory_resource>
 #include <ctime>
+#include <cstdint>
 
 enum class AnalysisType {
     USER,
     IP,
-    LOG_LEVEL
+    LOG_LEVEL,
+    PATTERN     // Records whose message contains each of the request's patterns
 };
 
+// What PATTERN counts are broken down by: keys are "pattern" or "group: pattern"
+enum class PatternGroup {
+    NONE,
+    USER,
+    LEVEL
+};
+
+// Most patterns one PATTERN request may carry, and most bytes they may add
+// up to (so that the request fits in a message, see MAX_MESSAGE_SIZE)
+constexpr size_t MAX_PATTERNS = 16384;
+constexpr size_t MAX_PATTERN_BYTES = 1024 * 1024;
+
+// Fields live in the memory resource the entry was created with (the
+// analyzer parses into a per-job arena, see arena.h)
 struct LogEntry {
-    std::string timestamp;
-    std::string user;
-    std::string ip;
-    std::string level;
-    std::string message;
+    explicit LogEntry(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : timestamp(resource), user(resource), ip(resource), level(resource), message(resource) {}
+
+    std::pmr::string timestamp;
+    std::pmr::string user;
+    std::pmr::string ip;
+    std::pmr::string level;
+    std::pmr::string message;
+};
+
+// Fields of a LogEntry as bit flags, e.g. the columns a query reads
+enum EntryField : uint32_t {
+    FIELD_TIMESTAMP = 1,
+    FIELD_USER = 2,
+    FIELD_IP = 4,
+    FIELD_LEVEL = 8,
+    FIELD_MESSAGE = 16
 };
 
 struct AnalysisRequest {
     AnalysisType type;
     std::optional<std::string> startDate;
     std::optional<std::string> endDate;
+    uint32_t progressIntervalMs = 0;  // MSG_PROGRESS at most this often while analyzing, 0 for none
+    uint64_t expectedBytes = 0;       // Upload size announced by the client (for the ETA), 0 if unknown
+    bool follow = false;              // Long-lived session fed with appended data (see MSG_QUERY)
+    bool trace = false;               // Server records spans and writes a trace file (see trace.h)
+    std::vector<std::string> patterns;  // PATTERN: literals searched for in each message
+    PatternGroup patternGroup = PatternGroup::NONE;
+    std::string storeAs;              // Also keep the uploaded entries as this dataset (see segment_store.h)
+    std::string dataset;              // Also analyze this stored dataset
+    bool session = false;             // Keep the uploaded entries for further requests on the connection
+    std::string filter;               // Only entries matching this expression are counted (see filter.h)
 };
 
 struct AnalysisResult {
     AnalysisType type;
-    std::unordered_map<std::string, int> counts;
-    int totalEntries = 0;
+    std::unordered_map<std::string, uint64_t> counts;
+    uint64_t totalEntries = 0;
 };
 
 // Protocol specific constants
 constexpr int DEFAULT_PORT = 8080;
 constexpr int BUFFER_SIZE = 4096;
 
+// Largest message body either side accepts, a few 1 MB pipeline chunks: a
+// peer cannot make the other buffer more by announcing a longer message
+constexpr size_t MAX_MESSAGE_SIZE = 4 * 1024 * 1024;
+static_assert(BUFFER_SIZE <= MAX_MESSAGE_SIZE, "file chunks must fit in a message");
+// Escaping at most doubles a pattern, plus one separator each
+static_assert(2 * MAX_PATTERN_BYTES + MAX_PATTERNS < MAX_MESSAGE_SIZE, "patterns must fit in a request");
+
 // Message types
 constexpr char MSG_REQUEST = 'R';
 constexpr char MSG_FILE_START = 'F';
@@ -57,6 +104,15 @@ constexpr char MSG_FILE_END = 'E';
 constexpr char MSG_RESULT = 'S';
 constexpr char MSG_ERROR = 'X';
 constexpr char MSG_ACK = 'A';
+constexpr char MSG_PARTIAL_RESULT = 'P';
+constexpr char MSG_PROGRESS = 'G';   // Server -> client: running result (see result_codec.h)
+constexpr char MSG_CANCEL = 'K';     // Client -> server: stop and send the result so far
+constexpr char MSG_QUERY = 'Q';      // Follow mode: send the aggregates so far, keep the session
+constexpr char MSG_FILE_RESET = 'T'; // Follow mode: file was truncated or replaced, drop its partial record
+constexpr char MSG_WINDOW = 'W';     // Client -> server, instead of MSG_REQUEST: "TYPE|minutes" sliding-window counts
+constexpr char MSG_STATS = 'M';      // Instead of MSG_REQUEST: server replies with its stage latencies and counters (metrics.h)
+constexpr char MSG_MANIFEST = 'H';   // Before a file: "name\nhash size\n..." of its pieces; the server replies
+                                     // with the indexes of the pieces it lacks ("0,3"), sent next as files
 
 // Cross-platform socket type
 #ifdef _WIN32
@@ -75,15 +131,48 @@ typedef int socket_t;
 bool sendMessage(socket_t socket, char type, const std::string& message);
 bool receiveMessage(socket_t socket, char& type, std::string& message);
 
+// Wait up to timeoutMs for data (or a hangup) on a socket
+bool socketReadable(socket_t socket, int timeoutMs);
+
+// Framing for non-blocking I/O: encode a complete message (header + body)
+std::string encodeMessage(char type, const std::string& message);
+
+// Incremental decoder for the [TYPE:1][LENGTH:8][MESSAGE] framing, fed with
+// whatever a non-blocking recv() returned
+class MessageDecoder {
+public:
+    void feed(const char* data, size_t size);
+    
+    // Extract the next complete message; false if more input is needed.
+    // Throws std::runtime_error on a malformed header or a length over
+    // MAX_MESSAGE_SIZE.
+    bool next(char& type, std::string& message);
+    
+    // Bytes received but not yet returned by next()
+    size_t bufferedBytes() const;
+    
+private:
+    std::string buffer_;
+    size_t offset_ = 0;
+};
+
 // Utility functions
 std::string serializeRequest(const AnalysisRequest& request);
 AnalysisRequest deserializeRequest(const std::string& data);
 
+// Total length of a request's patterns (checked against MAX_PATTERN_BYTES)
+size_t patternBytes(const std::vector<std::string>& patterns);
+
+// Text result format, kept for comparison (results travel as binary frames,
+// see result_codec.h)
 std::string serializeResult(const AnalysisResult& result);
 AnalysisResult deserializeResult(const std::string& data);
 
+// Merge a partial result (e.g. one computed on an edge client) into target
+void mergeResult(AnalysisResult& target, const AnalysisResult& partial);
+
 // Date utility functions
-bool isDateInRange(const std::string& date,
+bool isDateInRange(std::string_view date,
                    const std::optional<std::string>& startDate,
                    const std::optional<std::string>& endDate);
 
@@ -0,0 +1,240 @@
+#include "result_codec.h"
+#include <stdexcept>
+#include <algorithm>
+
+constexpr uint8_t FRAME_FIRST = 1;
+constexpr uint8_t FRAME_LAST = 2;
+constexpr uint8_t RESULT_FORMAT_VERSION = 1;
+
+static void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+static uint64_t getVarint(const std::string& in, size_t& pos) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= in.size()) {
+            throw std::runtime_error("Truncated result frame");
+        }
+        uint8_t byte = static_cast<uint8_t>(in[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Malformed varint in result frame");
+}
+
+void ResultEncoder::begin(const AnalysisResult& result) {
+    result_ = &result;
+    next_ = result.counts.begin();
+    first_ = true;
+    done_ = false;
+    // Keys within one result are distinct, so only keys from earlier results
+    // can be repeats; the first result on a stream skips the lookups
+    probeTable_ = !table_.empty();
+}
+
+bool ResultEncoder::done() const {
+    return done_;
+}
+
+std::string ResultEncoder::nextFrame() {
+    std::string frame;
+    if (done_) {
+        return frame;
+    }
+    frame.reserve(RESULT_FRAME_SIZE + 64);
+    frame.push_back(0);
+
+    uint8_t flags = 0;
+    if (first_) {
+        flags |= FRAME_FIRST;
+        frame += "LR";
+        frame.push_back(static_cast<char>(RESULT_FORMAT_VERSION));
+        frame.push_back(static_cast<char>(result_->type));
+        putVarint(frame, result_->totalEntries);
+        putVarint(frame, result_->counts.size());
+        first_ = false;
+    }
+
+    // Whole entries only; a single oversized key may overrun the frame size
+    auto end = result_->counts.end();
+    while (next_ != end && frame.size() < RESULT_FRAME_SIZE) {
+        const std::string& key = next_->first;
+        auto known = probeTable_ ? table_.find(key) : table_.end();
+        if (known != table_.end()) {
+            putVarint(frame, known->second + 1);
+        }
+        else {
+            putVarint(frame, 0);
+            putVarint(frame, key.size());
+            frame += key;
+            if (table_.size() < STRING_TABLE_LIMIT) {
+                table_.emplace(key, table_.size());
+            }
+        }
+        putVarint(frame, next_->second);
+        ++next_;
+    }
+
+    if (next_ == end) {
+        flags |= FRAME_LAST;
+        done_ = true;
+        result_ = nullptr;
+    }
+    frame[0] = static_cast<char>(flags);
+    return frame;
+}
+
+bool ResultDecoder::addFrame(const std::string& frame) {
+    if (frame.empty()) {
+        throw std::runtime_error("Empty result frame");
+    }
+    uint8_t flags = static_cast<uint8_t>(frame[0]);
+    size_t pos = 1;
+
+    if (flags & FRAME_FIRST) {
+        if (frame.size() < pos + 4 || frame[pos] != 'L' || frame[pos + 1] != 'R') {
+            throw std::runtime_error("Not a result frame");
+        }
+        if (static_cast<uint8_t>(frame[pos + 2]) != RESULT_FORMAT_VERSION) {
+            throw std::runtime_error("Unsupported result format version");
+        }
+        uint8_t type = static_cast<uint8_t>(frame[pos + 3]);
+        if (type > static_cast<uint8_t>(AnalysisType::PATTERN)) {
+            throw std::runtime_error("Invalid analysis type in result");
+        }
+        pos += 4;
+
+        result_ = AnalysisResult();
+        result_.type = static_cast<AnalysisType>(type);
+        result_.totalEntries = getVarint(frame, pos);
+        uint64_t keyCount = getVarint(frame, pos);
+        // Only a hint: never trust the peer with a huge allocation
+        result_.counts.reserve(static_cast<size_t>(std::min<uint64_t>(keyCount, 1 << 20)));
+        inResult_ = true;
+    }
+    else if (!inResult_) {
+        throw std::runtime_error("Result frame without a header");
+    }
+
+    while (pos < frame.size()) {
+        uint64_t ref = getVarint(frame, pos);
+        if (ref == 0) {
+            uint64_t length = getVarint(frame, pos);
+            if (length > frame.size() - pos) {
+                throw std::runtime_error("Truncated key in result frame");
+            }
+            std::string key(frame, pos, static_cast<size_t>(length));
+            pos += static_cast<size_t>(length);
+            uint64_t count = getVarint(frame, pos);
+            if (table_.size() < STRING_TABLE_LIMIT) {
+                table_.push_back(key);
+            }
+            result_.counts[std::move(key)] += count;
+        }
+        else {
+            if (ref > table_.size()) {
+                throw std::runtime_error("Invalid key reference in result frame");
+            }
+            uint64_t count = getVarint(frame, pos);
+            result_.counts[table_[static_cast<size_t>(ref - 1)]] += count;
+        }
+    }
+
+    if (flags & FRAME_LAST) {
+        inResult_ = false;
+        return true;
+    }
+    return false;
+}
+
+AnalysisResult ResultDecoder::takeResult() {
+    AnalysisResult result = std::move(result_);
+    result_ = AnalysisResult();
+    return result;
+}
+
+std::string encodeProgress(ResultEncoder& encoder, const AnalysisProgress& progress) {
+    std::string message;
+    putVarint(message, progress.bytesAnalyzed);
+    putVarint(message, progress.bytesReceived);
+    putVarint(message, progress.bytesExpected);
+    putVarint(message, progress.elapsedMs);
+    putVarint(message, progress.remainingMs);
+    putVarint(message, progress.distinctKeys);
+
+    encoder.begin(progress.top);
+    while (!encoder.done()) {
+        std::string frame = encoder.nextFrame();
+        putVarint(message, frame.size());
+        message += frame;
+    }
+    return message;
+}
+
+AnalysisProgress decodeProgress(ResultDecoder& decoder, const std::string& message) {
+    AnalysisProgress progress;
+    size_t pos = 0;
+    progress.bytesAnalyzed = getVarint(message, pos);
+    progress.bytesReceived = getVarint(message, pos);
+    progress.bytesExpected = getVarint(message, pos);
+    progress.elapsedMs = getVarint(message, pos);
+    progress.remainingMs = getVarint(message, pos);
+    progress.distinctKeys = getVarint(message, pos);
+
+    bool complete = false;
+    while (pos < message.size()) {
+        uint64_t length = getVarint(message, pos);
+        if (length > message.size() - pos) {
+            throw std::runtime_error("Truncated frame in progress message");
+        }
+        complete = decoder.addFrame(message.substr(pos, static_cast<size_t>(length)));
+        pos += static_cast<size_t>(length);
+    }
+    if (!complete) {
+        throw std::runtime_error("Incomplete result in progress message");
+    }
+    progress.top = decoder.takeResult();
+    return progress;
+}
+
+bool sendResult(socket_t socket, char type, const AnalysisResult& result) {
+    ResultEncoder encoder;
+    encoder.begin(result);
+    while (!encoder.done()) {
+        if (!sendMessage(socket, type, encoder.nextFrame())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool receiveResult(socket_t socket, char type, AnalysisResult& result, std::string& error) {
+    ResultDecoder decoder;
+    std::string frame;
+    while (true) {
+        char received;
+        if (!receiveMessage(socket, received, frame)) {
+            error = "connection lost";
+            return false;
+        }
+        if (received == MSG_ERROR) {
+            error = frame;
+            return false;
+        }
+        if (received != type) {
+            error = std::string("unexpected message type ") + received;
+            return false;
+        }
+        if (decoder.addFrame(frame)) {
+            result = decoder.takeResult();
+            return true;
+        }
+    }
+}
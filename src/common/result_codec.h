@@ -0,0 +1,88 @@
+#ifndef RESULT_CODEC_H
+#define RESULT_CODEC_H
+
+#include "common/protocol.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// Binary result stream. A result travels as a sequence of frames (one
+// message each) of about RESULT_FRAME_SIZE bytes, so neither side has to
+// hold it as one string:
+//
+//   frame  := flags:u8 [header] entry*        flags: 1 = first, 2 = last
+//   header := 'L' 'R' version:u8 type:u8 varint(totalEntries) varint(keyCount)
+//   entry  := varint(ref) [varint(length) bytes] varint(count)
+//
+// ref 0 introduces a new key, written out in full; ref n > 0 repeats the
+// (n-1)th key of the stream's string table. New keys join the table (up to
+// STRING_TABLE_LIMIT), which lives as long as the encoder/decoder pair, so
+// keys repeated across results on one stream are sent only once. Varints
+// are unsigned LEB128, so counts and totals are 64-bit.
+constexpr size_t RESULT_FRAME_SIZE = 64 * 1024;
+constexpr size_t STRING_TABLE_LIMIT = 64 * 1024;
+
+class ResultEncoder {
+public:
+    // Start on a result, which must stay alive and unchanged until done()
+    void begin(const AnalysisResult& result);
+
+    // The last frame of the current result has been produced
+    bool done() const;
+
+    std::string nextFrame();
+
+private:
+    const AnalysisResult* result_ = nullptr;
+    std::unordered_map<std::string, uint64_t>::const_iterator next_;
+    bool first_ = false;
+    bool done_ = true;
+    bool probeTable_ = false;
+    std::unordered_map<std::string, uint64_t> table_;
+};
+
+class ResultDecoder {
+public:
+    // Decode one frame; true once it completed a result (see takeResult).
+    // Throws std::runtime_error on malformed input.
+    bool addFrame(const std::string& frame);
+
+    AnalysisResult takeResult();
+
+private:
+    AnalysisResult result_;
+    bool inResult_ = false;
+    std::vector<std::string> table_;
+};
+
+// Snapshot of a running analysis, sent as MSG_PROGRESS:
+//
+//   progress := varint(bytesAnalyzed) varint(bytesReceived) varint(bytesExpected)
+//               varint(elapsedMs) varint(remainingMs) varint(distinctKeys)
+//               (varint(length) frame)*
+//
+// The frames encode the top keys with the connection's result encoder, so
+// they share its string table with the final result.
+struct AnalysisProgress {
+    uint64_t bytesAnalyzed = 0;
+    uint64_t bytesReceived = 0;
+    uint64_t bytesExpected = 0;  // Announced upload size, 0 if unknown
+    uint64_t elapsedMs = 0;
+    uint64_t remainingMs = 0;    // Estimated time left, 0 if unknown
+    uint64_t distinctKeys = 0;
+    AnalysisResult top;          // Top keys so far; totalEntries counts every record so far
+};
+
+std::string encodeProgress(ResultEncoder& encoder, const AnalysisProgress& progress);
+
+// Throws std::runtime_error on malformed input
+AnalysisProgress decodeProgress(ResultDecoder& decoder, const std::string& message);
+
+// Blocking helpers: send a whole result as frames of the given message
+// type, or receive one (false on a socket error, an MSG_ERROR reply, whose
+// text goes to error, or any other unexpected message)
+bool sendResult(socket_t socket, char type, const AnalysisResult& result);
+bool receiveResult(socket_t socket, char type, AnalysisResult& result, std::string& error);
+
+#endif // RESULT_CODEC_H
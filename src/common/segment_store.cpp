@@ -0,0 +1,709 @@
+#include "common/segment_store.h"
+#include "common/compression.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char SEGMENT_MAGIC[4] = {'L', 'S', 'E', 'G'};
+constexpr uint32_t SEGMENT_VERSION = 1;
+constexpr size_t TRAILER_SIZE = 12;  // Footer offset + magic
+constexpr const char* SEGMENT_EXTENSION = ".seg";
+
+// Column chunk codecs
+constexpr uint8_t CODEC_RAW = 0;
+constexpr uint8_t CODEC_ZLIB = 1;
+
+// Column indexes: the bit position of their EntryField
+constexpr int COLUMN_TIME = 0;
+constexpr int COLUMN_MESSAGE = 4;
+constexpr EntryField DICTIONARY_FIELDS[3] = {FIELD_USER, FIELD_IP, FIELD_LEVEL};
+
+// Timestamps that parse are between these years, so they format to strings
+// that sort as the times do
+constexpr int MIN_YEAR = 1000;
+constexpr int MAX_YEAR = 9999;
+
+void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+bool getVarint(const std::string& in, size_t& pos, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(in[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void putFixed(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out += static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+}
+
+bool getFixed(const std::string& in, size_t& pos, uint64_t& value, int bytes) {
+    if (pos + bytes > in.size()) {
+        return false;
+    }
+    value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value |= static_cast<uint64_t>(static_cast<uint8_t>(in[pos++])) << (8 * i);
+    }
+    return true;
+}
+
+uint64_t zigzag(uint64_t value) {
+    return (value << 1) ^ (0 - (value >> 63));
+}
+
+uint64_t unzigzag(uint64_t value) {
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+// Days since 1970-01-01 of a civil date (proleptic Gregorian)
+int64_t daysFromCivil(int64_t year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+    unsigned dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + static_cast<int64_t>(dayOfEra) - 719468;
+}
+
+void civilFromDays(int64_t days, int64_t& year, unsigned& month, unsigned& day) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    unsigned dayOfEra = static_cast<unsigned>(days - era * 146097);
+    unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    unsigned shifted = (5 * dayOfYear + 2) / 153;
+    day = dayOfYear - (153 * shifted + 2) / 5 + 1;
+    month = shifted < 10 ? shifted + 3 : shifted - 9;
+    year = static_cast<int64_t>(yearOfEra) + era * 400 + (month <= 2);
+}
+
+bool parseDigits(std::string_view text, size_t pos, size_t count, int& value) {
+    value = 0;
+    for (size_t i = pos; i < pos + count; ++i) {
+        if (text[i] < '0' || text[i] > '9') {
+            return false;
+        }
+        value = value * 10 + (text[i] - '0');
+    }
+    return true;
+}
+
+// Column chunk reference as stored in the footer
+struct StoredChunk {
+    uint64_t offset;
+    uint32_t storedSize;
+    uint32_t rawSize;
+    uint8_t codec;
+};
+
+void putChunk(std::string& out, uint64_t offset, uint32_t storedSize, uint32_t rawSize, uint8_t codec) {
+    putFixed(out, offset, 8);
+    putFixed(out, storedSize, 4);
+    putFixed(out, rawSize, 4);
+    putFixed(out, codec, 1);
+}
+
+bool getChunk(const std::string& in, size_t& pos, StoredChunk& chunk) {
+    uint64_t storedSize, rawSize, codec;
+    if (!getFixed(in, pos, chunk.offset, 8) || !getFixed(in, pos, storedSize, 4) || !getFixed(in, pos, rawSize, 4) ||
+        !getFixed(in, pos, codec, 1)) {
+        return false;
+    }
+    chunk.storedSize = static_cast<uint32_t>(storedSize);
+    chunk.rawSize = static_cast<uint32_t>(rawSize);
+    chunk.codec = static_cast<uint8_t>(codec);
+    return true;
+}
+
+} // namespace
+
+int64_t parseStoredTime(std::string_view timestamp) {
+    int year, month, day, hour = 0, minute = 0, second = 0;
+    if (timestamp.size() < 10 || timestamp[4] != '-' || timestamp[7] != '-' ||
+        !parseDigits(timestamp, 0, 4, year) || !parseDigits(timestamp, 5, 2, month) ||
+        !parseDigits(timestamp, 8, 2, day)) {
+        return NO_TIMESTAMP;
+    }
+    if (timestamp.size() > 10) {
+        if (timestamp.size() < 19 || (timestamp[10] != ' ' && timestamp[10] != 'T') || timestamp[13] != ':' ||
+            timestamp[16] != ':' || !parseDigits(timestamp, 11, 2, hour) || !parseDigits(timestamp, 14, 2, minute) ||
+            !parseDigits(timestamp, 17, 2, second)) {
+            return NO_TIMESTAMP;
+        }
+    }
+    if (year < MIN_YEAR || year > MAX_YEAR || month < 1 || month > 12 || day < 1 || hour > 23 || minute > 59 ||
+        second > 59) {
+        return NO_TIMESTAMP;
+    }
+
+    // Days past the end of the month would format as another date
+    int64_t days = daysFromCivil(year, static_cast<unsigned>(month), static_cast<unsigned>(day));
+    int64_t checkYear;
+    unsigned checkMonth, checkDay;
+    civilFromDays(days, checkYear, checkMonth, checkDay);
+    if (checkMonth != static_cast<unsigned>(month) || checkDay != static_cast<unsigned>(day)) {
+        return NO_TIMESTAMP;
+    }
+    return days * 86400 + hour * 3600 + minute * 60 + second;
+}
+
+std::string formatStoredTime(int64_t time) {
+    if (time == NO_TIMESTAMP) {
+        return std::string();
+    }
+    int64_t days = time >= 0 ? time / 86400 : (time - 86399) / 86400;
+    int64_t seconds = time - days * 86400;
+    int64_t year;
+    unsigned month, day;
+    civilFromDays(days, year, month, day);
+    char text[32];
+    std::snprintf(text, sizeof(text), "%04lld-%02u-%02u %02d:%02d:%02d", static_cast<long long>(year), month, day,
+                  static_cast<int>(seconds / 3600), static_cast<int>(seconds / 60 % 60), static_cast<int>(seconds % 60));
+    return text;
+}
+
+bool storedTimeRange(const std::optional<std::string>& startDate, const std::optional<std::string>& endDate,
+                     int64_t& first, int64_t& last) {
+    // Stored times in order: NO_TIMESTAMP, then every second of the years
+    // that parse. Formatting keeps that order, so the times passing each
+    // bound are a prefix or suffix, found by binary search.
+    const int64_t lowest = daysFromCivil(MIN_YEAR, 1, 1) * 86400;
+    const int64_t highest = daysFromCivil(MAX_YEAR + 1, 1, 1) * 86400 - 1;
+    const int64_t count = highest - lowest + 2;
+    auto timeAt = [&](int64_t index) { return index == 0 ? NO_TIMESTAMP : lowest + index - 1; };
+
+    // First index at or after the start
+    int64_t low = 0, high = count;
+    while (low < high) {
+        int64_t middle = low + (high - low) / 2;
+        if (!startDate || formatStoredTime(timeAt(middle)) >= *startDate) {
+            high = middle;
+        }
+        else {
+            low = middle + 1;
+        }
+    }
+    int64_t firstIndex = low;
+
+    // First index after the end
+    low = 0;
+    high = count;
+    while (low < high) {
+        int64_t middle = low + (high - low) / 2;
+        if (endDate && formatStoredTime(timeAt(middle)) > *endDate) {
+            high = middle;
+        }
+        else {
+            low = middle + 1;
+        }
+    }
+    int64_t endIndex = low;
+
+    if (firstIndex >= endIndex) {
+        return false;
+    }
+    first = timeAt(firstIndex);
+    last = endIndex == count ? INT64_MAX : timeAt(endIndex - 1);
+    return true;
+}
+
+bool datasetPath(const std::string& storeDir, const std::string& name, std::string& path) {
+    // Plain names only: no separators, and nothing hidden (staging directories start with '.')
+    if (name.empty() || name.size() > 128 || name[0] == '.' ||
+        !std::all_of(name.begin(), name.end(), [](unsigned char c) {
+            return std::isalnum(c) || c == '_' || c == '-' || c == '.';
+        })) {
+        return false;
+    }
+    path = (fs::path(storeDir) / name).string();
+    return true;
+}
+
+std::vector<std::string> listSegments(const std::string& datasetDir) {
+    std::vector<std::string> segments;
+    std::error_code error;
+    for (const auto& entry : fs::directory_iterator(datasetDir, error)) {
+        if (entry.path().extension() == SEGMENT_EXTENSION) {
+            segments.push_back(entry.path().string());
+        }
+    }
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+uint32_t ColumnDictionary::code(std::string_view value) {
+    auto found = codes.find(std::string(value));
+    if (found != codes.end()) {
+        return found->second;
+    }
+    uint32_t next = static_cast<uint32_t>(values.size());
+    values.emplace_back(value);
+    codes.emplace(values.back(), next);
+    return next;
+}
+
+SegmentWriter::SegmentWriter(const std::string& storeDir, const std::string& name)
+    : name_(name), ok_(false), committed_(false), segmentCount_(0), rows_(0), storedBytes_(0) {
+    if (!datasetPath(storeDir, name, finalDir_)) {
+        return;
+    }
+    static std::atomic<uint64_t> stagingCounter(0);
+    auto tick = std::chrono::steady_clock::now().time_since_epoch().count();
+    stagingDir_ = (fs::path(storeDir) / ("." + name + ".staging-" + std::to_string(tick) + "-" +
+                                         std::to_string(stagingCounter++))).string();
+    std::error_code error;
+    fs::create_directories(stagingDir_, error);
+    if (error) {
+        std::cerr << "Error creating dataset directory " << stagingDir_ << ": " << error.message() << std::endl;
+        return;
+    }
+    ok_ = true;
+}
+
+SegmentWriter::~SegmentWriter() {
+    if (!committed_ && !stagingDir_.empty()) {
+        std::error_code error;
+        fs::remove_all(stagingDir_, error);
+    }
+}
+
+bool SegmentWriter::ok() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ok_;
+}
+
+void SegmentWriter::add(const std::pmr::vector<LogEntry>& entries) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!ok_) {
+        return;
+    }
+    for (const auto& entry : entries) {
+        times_.push_back(parseStoredTime(entry.timestamp));
+        users_.push_back(dictionaries_[0].code(entry.user));
+        ips_.push_back(dictionaries_[1].code(entry.ip));
+        levels_.push_back(dictionaries_[2].code(entry.level));
+        putVarint(messages_, entry.message.size());
+        messages_.append(entry.message);
+        rows_++;
+        if (times_.size() == SEGMENT_BLOCK_ROWS) {
+            ok_ = flushBlock() && (blocks_.size() < SEGMENT_BLOCKS || flushSegment());
+            if (!ok_) {
+                return;
+            }
+        }
+    }
+}
+
+SegmentWriter::ChunkRef SegmentWriter::appendChunk(const std::string& raw) {
+    ChunkRef chunk;
+    chunk.offset = data_.size();
+    chunk.rawSize = static_cast<uint32_t>(raw.size());
+    std::string compressed;
+    if (deflateBuffer(raw, compressed) && compressed.size() < raw.size()) {
+        chunk.codec = CODEC_ZLIB;
+        chunk.storedSize = static_cast<uint32_t>(compressed.size());
+        data_ += compressed;
+    }
+    else {
+        chunk.codec = CODEC_RAW;
+        chunk.storedSize = static_cast<uint32_t>(raw.size());
+        data_ += raw;
+    }
+    return chunk;
+}
+
+bool SegmentWriter::flushBlock() {
+    if (times_.empty()) {
+        return true;
+    }
+    BlockRef block;
+    block.rows = static_cast<uint32_t>(times_.size());
+    block.minTime = *std::min_element(times_.begin(), times_.end());
+    block.maxTime = *std::max_element(times_.begin(), times_.end());
+
+    // Timestamps as zigzag deltas from the previous row (wrapping arithmetic:
+    // NO_TIMESTAMP rows make for large but exact deltas)
+    std::string raw;
+    uint64_t previous = 0;
+    for (int64_t time : times_) {
+        putVarint(raw, zigzag(static_cast<uint64_t>(time) - previous));
+        previous = static_cast<uint64_t>(time);
+    }
+    block.columns[COLUMN_TIME] = appendChunk(raw);
+
+    const std::vector<uint32_t>* codes[3] = {&users_, &ips_, &levels_};
+    for (int column = 0; column < 3; ++column) {
+        raw.clear();
+        for (uint32_t code : *codes[column]) {
+            putVarint(raw, code);
+        }
+        block.columns[column + 1] = appendChunk(raw);
+    }
+    block.columns[COLUMN_MESSAGE] = appendChunk(messages_);
+
+    if (data_.size() > UINT32_MAX) {
+        std::cerr << "Segment too large for dataset " << name_ << std::endl;
+        return false;
+    }
+    blocks_.push_back(block);
+    times_.clear();
+    users_.clear();
+    ips_.clear();
+    levels_.clear();
+    messages_.clear();
+    return true;
+}
+
+bool SegmentWriter::flushSegment() {
+    if (!flushBlock()) {
+        return false;
+    }
+    if (blocks_.empty()) {
+        return true;
+    }
+
+    // Dictionaries go after the blocks: they are complete only now
+    ChunkRef dictionaries[3];
+    for (int column = 0; column < 3; ++column) {
+        std::string raw;
+        putVarint(raw, dictionaries_[column].values.size());
+        for (const auto& value : dictionaries_[column].values) {
+            putVarint(raw, value.size());
+            raw += value;
+        }
+        dictionaries[column] = appendChunk(raw);
+    }
+
+    uint64_t footerOffset = data_.size();
+    data_.append(SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+    putFixed(data_, SEGMENT_VERSION, 4);
+    putFixed(data_, blocks_.size(), 4);
+    for (const auto& chunk : dictionaries) {
+        putChunk(data_, chunk.offset, chunk.storedSize, chunk.rawSize, chunk.codec);
+    }
+    for (const auto& block : blocks_) {
+        putFixed(data_, block.rows, 4);
+        putFixed(data_, static_cast<uint64_t>(block.minTime), 8);
+        putFixed(data_, static_cast<uint64_t>(block.maxTime), 8);
+        for (const auto& chunk : block.columns) {
+            putChunk(data_, chunk.offset, chunk.storedSize, chunk.rawSize, chunk.codec);
+        }
+    }
+    putFixed(data_, footerOffset, 8);
+    data_.append(SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "segment-%06zu%s", segmentCount_, SEGMENT_EXTENSION);
+    std::string path = (fs::path(stagingDir_) / name).string();
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    bool written = file && std::fwrite(data_.data(), 1, data_.size(), file) == data_.size();
+    if (file && std::fclose(file) != 0) {
+        written = false;
+    }
+    if (!written) {
+        std::cerr << "Error writing segment: " << path << std::endl;
+        return false;
+    }
+
+    segmentCount_++;
+    storedBytes_ += data_.size();
+    std::string().swap(data_);
+    blocks_.clear();
+    for (auto& dictionary : dictionaries_) {
+        dictionary = ColumnDictionary();
+    }
+    return true;
+}
+
+bool SegmentWriter::finish() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ok_ = ok_ && flushSegment();
+    return ok_;
+}
+
+bool SegmentWriter::commit() {
+    if (!finish()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Move any previous dataset aside first, so that it is never half replaced
+    std::error_code error;
+    std::string previous;
+    if (fs::exists(finalDir_, error)) {
+        previous = stagingDir_ + ".old";
+        fs::rename(finalDir_, previous, error);
+        if (error) {
+            std::cerr << "Error replacing dataset " << name_ << ": " << error.message() << std::endl;
+            return false;
+        }
+    }
+    fs::rename(stagingDir_, finalDir_, error);
+    if (error) {
+        std::cerr << "Error storing dataset " << name_ << ": " << error.message() << std::endl;
+        return false;
+    }
+    committed_ = true;
+    if (!previous.empty()) {
+        fs::remove_all(previous, error);
+    }
+    return true;
+}
+
+uint64_t SegmentWriter::rows() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rows_;
+}
+
+uint64_t SegmentWriter::storedBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return storedBytes_;
+}
+
+// Bookkeeping per row (time, three codes, message offset) and per distinct
+// dictionary value, on top of the strings themselves
+constexpr uint64_t TABLE_ROW_BYTES = sizeof(int64_t) + 4 * sizeof(uint32_t);
+constexpr uint64_t TABLE_VALUE_BYTES = 96;
+
+void MemoryTable::add(const std::pmr::vector<LogEntry>& entries) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t added = 0;
+    for (const auto& entry : entries) {
+        if (blocks_.empty() || blocks_.back()->columns.rows == SEGMENT_BLOCK_ROWS) {
+            blocks_.push_back(std::make_unique<Block>());
+            blocks_.back()->columns.messageOffsets.push_back(0);
+        }
+        Block& block = *blocks_.back();
+        SegmentBlock& columns = block.columns;
+        int64_t time = parseStoredTime(entry.timestamp);
+        columns.times.push_back(time);
+        block.minTime = std::min(block.minTime, time);
+        block.maxTime = std::max(block.maxTime, time);
+
+        std::string_view values[3] = {entry.user, entry.ip, entry.level};
+        for (int column = 0; column < 3; ++column) {
+            size_t known = dictionaries_[column].values.size();
+            columns.codes[column].push_back(dictionaries_[column].code(values[column]));
+            if (dictionaries_[column].values.size() > known) {
+                added += TABLE_VALUE_BYTES + values[column].size();
+            }
+        }
+        columns.messageData.append(entry.message);
+        columns.messageOffsets.push_back(static_cast<uint32_t>(columns.messageData.size()));
+        columns.rows++;
+        added += TABLE_ROW_BYTES + entry.message.size();
+    }
+    rows_ += entries.size();
+    memoryBytes_ += added;
+}
+
+const std::vector<std::string>& MemoryTable::dictionary(EntryField field) const {
+    switch (field) {
+        case FIELD_IP: return dictionaries_[1].values;
+        case FIELD_LEVEL: return dictionaries_[2].values;
+        default: return dictionaries_[0].values;
+    }
+}
+
+uint64_t MemoryTable::rows() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rows_;
+}
+
+SegmentReader::~SegmentReader() {
+    if (file_) {
+        std::fclose(file_);
+    }
+}
+
+bool SegmentReader::open(const std::string& path, uint32_t columns) {
+    path_ = path;
+    file_ = std::fopen(path.c_str(), "rb");
+    if (!file_ || std::fseek(file_, 0, SEEK_END) != 0) {
+        return false;
+    }
+    long size = std::ftell(file_);
+    if (size < static_cast<long>(TRAILER_SIZE)) {
+        return false;
+    }
+
+    // Trailer, then the footer it points to
+    std::string trailer(TRAILER_SIZE, '\0');
+    std::fseek(file_, size - static_cast<long>(TRAILER_SIZE), SEEK_SET);
+    if (std::fread(&trailer[0], 1, TRAILER_SIZE, file_) != TRAILER_SIZE ||
+        trailer.compare(8, 4, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) != 0) {
+        return false;
+    }
+    size_t pos = 0;
+    uint64_t footerOffset = 0;
+    if (!getFixed(trailer, pos, footerOffset, 8)) {
+        return false;
+    }
+    uint64_t footerEnd = static_cast<uint64_t>(size) - TRAILER_SIZE;
+    if (footerOffset > footerEnd) {
+        return false;
+    }
+    std::string footer(static_cast<size_t>(footerEnd - footerOffset), '\0');
+    std::fseek(file_, static_cast<long>(footerOffset), SEEK_SET);
+    if (std::fread(&footer[0], 1, footer.size(), file_) != footer.size()) {
+        return false;
+    }
+
+    pos = sizeof(SEGMENT_MAGIC);
+    uint64_t version, blockCount;
+    if (footer.compare(0, 4, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) != 0 || !getFixed(footer, pos, version, 4) ||
+        version != SEGMENT_VERSION || !getFixed(footer, pos, blockCount, 4)) {
+        return false;
+    }
+    for (auto& chunk : dictionaryChunks_) {
+        StoredChunk stored;
+        if (!getChunk(footer, pos, stored)) {
+            return false;
+        }
+        chunk = {stored.offset, stored.storedSize, stored.rawSize, stored.codec};
+    }
+    blocks_.resize(static_cast<size_t>(blockCount));
+    for (auto& block : blocks_) {
+        uint64_t rows, minTime, maxTime;
+        if (!getFixed(footer, pos, rows, 4) || !getFixed(footer, pos, minTime, 8) || !getFixed(footer, pos, maxTime, 8)) {
+            return false;
+        }
+        block.info = {static_cast<uint32_t>(rows), static_cast<int64_t>(minTime), static_cast<int64_t>(maxTime)};
+        for (auto& chunk : block.columns) {
+            StoredChunk stored;
+            if (!getChunk(footer, pos, stored) || stored.offset + stored.storedSize > footerOffset) {
+                return false;
+            }
+            chunk = {stored.offset, stored.storedSize, stored.rawSize, stored.codec};
+        }
+    }
+
+    // Only the dictionaries of the columns the query reads
+    for (int column = 0; column < 3; ++column) {
+        if (!(columns & DICTIONARY_FIELDS[column])) {
+            continue;
+        }
+        std::string raw;
+        uint64_t count, length;
+        pos = 0;
+        if (!readChunk(dictionaryChunks_[column], raw) || !getVarint(raw, pos, count) || count > raw.size()) {
+            return false;
+        }
+        auto& values = dictionaries_[column];
+        values.reserve(static_cast<size_t>(count));
+        for (uint64_t i = 0; i < count; ++i) {
+            if (!getVarint(raw, pos, length) || length > raw.size() - pos) {
+                return false;
+            }
+            values.emplace_back(raw, pos, static_cast<size_t>(length));
+            pos += static_cast<size_t>(length);
+        }
+    }
+    return true;
+}
+
+const std::vector<std::string>& SegmentReader::dictionary(EntryField field) const {
+    switch (field) {
+        case FIELD_IP: return dictionaries_[1];
+        case FIELD_LEVEL: return dictionaries_[2];
+        default: return dictionaries_[0];
+    }
+}
+
+bool SegmentReader::readChunk(const ChunkRef& chunk, std::string& raw) {
+    if (std::fseek(file_, static_cast<long>(chunk.offset), SEEK_SET) != 0) {
+        return false;
+    }
+    bytesRead_ += chunk.storedSize;
+    if (chunk.codec == CODEC_RAW) {
+        raw.resize(chunk.storedSize);
+        return std::fread(&raw[0], 1, raw.size(), file_) == raw.size() && chunk.storedSize == chunk.rawSize;
+    }
+    chunk_.resize(chunk.storedSize);
+    return chunk.codec == CODEC_ZLIB && std::fread(&chunk_[0], 1, chunk_.size(), file_) == chunk_.size() &&
+           inflateBuffer(chunk_.data(), chunk_.size(), chunk.rawSize, raw);
+}
+
+bool SegmentReader::readBlock(size_t index, uint32_t columns, SegmentBlock& out) {
+    const Block& block = blocks_[index];
+    const size_t rows = block.info.rows;
+    out.rows = rows;
+    std::string raw;
+    uint64_t value;
+
+    if (columns & FIELD_TIMESTAMP) {
+        size_t pos = 0;
+        if (!readChunk(block.columns[COLUMN_TIME], raw)) {
+            return false;
+        }
+        out.times.resize(rows);
+        uint64_t previous = 0;
+        for (size_t row = 0; row < rows; ++row) {
+            if (!getVarint(raw, pos, value)) {
+                return false;
+            }
+            previous += unzigzag(value);
+            out.times[row] = static_cast<int64_t>(previous);
+        }
+    }
+
+    for (int column = 0; column < 3; ++column) {
+        if (!(columns & DICTIONARY_FIELDS[column])) {
+            continue;
+        }
+        size_t pos = 0;
+        if (!readChunk(block.columns[column + 1], raw)) {
+            return false;
+        }
+        auto& codes = out.codes[column];
+        codes.resize(rows);
+        const uint64_t dictionarySize = dictionaries_[column].size();
+        for (size_t row = 0; row < rows; ++row) {
+            if (!getVarint(raw, pos, value) || value >= dictionarySize) {
+                return false;
+            }
+            codes[row] = static_cast<uint32_t>(value);
+        }
+    }
+
+    if (columns & FIELD_MESSAGE) {
+        size_t pos = 0;
+        if (!readChunk(block.columns[COLUMN_MESSAGE], raw)) {
+            return false;
+        }
+        // Lengths dropped: messages end to end, with offsets
+        out.messageData.clear();
+        out.messageOffsets.resize(rows + 1);
+        out.messageOffsets[0] = 0;
+        for (size_t row = 0; row < rows; ++row) {
+            if (!getVarint(raw, pos, value) || value > raw.size() - pos) {
+                return false;
+            }
+            out.messageData.append(raw, pos, static_cast<size_t>(value));
+            pos += static_cast<size_t>(value);
+            out.messageOffsets[row + 1] = static_cast<uint32_t>(out.messageData.size());
+        }
+    }
+    return true;
+}
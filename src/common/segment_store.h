@@ -0,0 +1,254 @@
+#ifndef SEGMENT_STORE_H
+#define SEGMENT_STORE_H
+
+#include "common/protocol.h"
+#include <string>
+#include <string_view>
+#include <optional>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <unordered_map>
+#include <cstdint>
+#include <cstdio>
+
+// Columnar store for uploaded logs, so that a dataset parsed once can be
+// queried again by name (AnalysisRequest::storeAs / dataset).
+//
+// A dataset is a directory of segment files. A segment holds up to
+// SEGMENT_BLOCKS blocks of up to SEGMENT_BLOCK_ROWS records, stored column by
+// column: timestamps as epoch seconds (delta encoded), user, ip and level as
+// codes into per-segment dictionaries, messages as they are. Each column of a
+// block is compressed on its own (zlib when available), and the footer keeps
+// the smallest and largest timestamp of every block, so a query reads only
+// the columns it needs and skips the blocks outside its date range.
+//
+// File layout: column chunks, then the footer, then the footer's offset
+// (8 bytes, little-endian) and "LSEG".
+constexpr size_t SEGMENT_BLOCK_ROWS = 16384;
+constexpr size_t SEGMENT_BLOCKS = 16;
+
+// Stored time of a timestamp that is not "YYYY-MM-DD[ T]HH:MM:SS" or
+// "YYYY-MM-DD"; it reads back as an empty timestamp
+constexpr int64_t NO_TIMESTAMP = INT64_MIN;
+
+// Epoch seconds (UTC) of a timestamp, NO_TIMESTAMP if it does not parse.
+// Anything after the seconds (fractions, zone) is ignored.
+int64_t parseStoredTime(std::string_view timestamp);
+
+// "YYYY-MM-DD HH:MM:SS", empty for NO_TIMESTAMP
+std::string formatStoredTime(int64_t time);
+
+// The stored times whose formatted timestamp passes isDateInRange form one
+// interval (NO_TIMESTAMP sorts first, as its empty timestamp does): set
+// [first, last] to it, or return false if no stored time is in range
+bool storedTimeRange(const std::optional<std::string>& startDate, const std::optional<std::string>& endDate,
+                     int64_t& first, int64_t& last);
+
+// Directory of a named dataset; false if the name is not a plain name of
+// letters, digits, '_', '-' and '.'
+bool datasetPath(const std::string& storeDir, const std::string& name, std::string& path);
+
+// Segment files of a dataset, in name order (empty if there is none)
+std::vector<std::string> listSegments(const std::string& datasetDir);
+
+// Values of a dictionary-encoded column, by code
+struct ColumnDictionary {
+    std::unordered_map<std::string, uint32_t> codes;
+    std::vector<std::string> values;
+
+    // Code of a value, added if new
+    uint32_t code(std::string_view value);
+};
+
+// Builds a dataset from batches of parsed entries. add may be called from
+// several threads. Segments are written to a staging directory next to the
+// dataset; commit puts them in place of any previous dataset of that name,
+// and a writer destroyed before commit leaves nothing behind.
+class SegmentWriter {
+public:
+    SegmentWriter(const std::string& storeDir, const std::string& name);
+    ~SegmentWriter();
+
+    SegmentWriter(const SegmentWriter&) = delete;
+    SegmentWriter& operator=(const SegmentWriter&) = delete;
+
+    // Staging directory could be created
+    bool ok() const;
+
+    void add(const std::pmr::vector<LogEntry>& entries);
+
+    // Write out the entries not yet in a segment (e.g. on a worker thread)
+    bool finish();
+
+    // finish, then replace the dataset with what was written
+    bool commit();
+
+    uint64_t rows() const;
+    uint64_t storedBytes() const;
+
+private:
+    struct ChunkRef {
+        uint64_t offset = 0;
+        uint32_t storedSize = 0;
+        uint32_t rawSize = 0;
+        uint8_t codec = 0;
+    };
+
+    struct BlockRef {
+        uint32_t rows = 0;
+        int64_t minTime = 0;
+        int64_t maxTime = 0;
+        ChunkRef columns[5];
+    };
+
+    // Encode the buffered rows as a block of the current segment (mutex_ held)
+    bool flushBlock();
+
+    // Write the dictionaries and footer and close the segment (mutex_ held)
+    bool flushSegment();
+
+    // Append a column chunk to the segment data (mutex_ held)
+    ChunkRef appendChunk(const std::string& raw);
+
+    std::string name_;
+    std::string finalDir_;
+    std::string stagingDir_;
+    bool ok_;
+    bool committed_;
+
+    mutable std::mutex mutex_;
+    // Rows of the block being filled
+    std::vector<int64_t> times_;
+    std::vector<uint32_t> users_;
+    std::vector<uint32_t> ips_;
+    std::vector<uint32_t> levels_;
+    std::string messages_;  // Varint length + bytes per row
+    // Segment being built
+    ColumnDictionary dictionaries_[3];  // user, ip, level
+    std::vector<BlockRef> blocks_;
+    std::string data_;
+    size_t segmentCount_;
+    uint64_t rows_;
+    uint64_t storedBytes_;
+};
+
+// Columns of one block, as read by SegmentReader::readBlock
+struct SegmentBlock {
+    size_t rows = 0;
+    std::vector<int64_t> times;
+    std::vector<uint32_t> codes[3];         // user, ip, level dictionary codes
+    std::string messageData;
+    std::vector<uint32_t> messageOffsets;  // rows + 1 offsets into messageData
+
+    std::string_view message(size_t row) const {
+        return std::string_view(messageData).substr(messageOffsets[row], messageOffsets[row + 1] - messageOffsets[row]);
+    }
+};
+
+// Entries held in memory column by column (e.g. for the queries of a
+// session, see AnalysisRequest::session): blocks as SegmentReader::readBlock
+// returns them with every column, and dictionaries shared by all blocks.
+// add may be called from several threads; the table is read once they are done.
+class MemoryTable {
+public:
+    struct Block {
+        SegmentBlock columns;
+        int64_t minTime = INT64_MAX;
+        int64_t maxTime = INT64_MIN;
+    };
+
+    MemoryTable() = default;
+
+    MemoryTable(const MemoryTable&) = delete;
+    MemoryTable& operator=(const MemoryTable&) = delete;
+
+    void add(const std::pmr::vector<LogEntry>& entries);
+
+    size_t blockCount() const {
+        return blocks_.size();
+    }
+    const Block& block(size_t index) const {
+        return *blocks_[index];
+    }
+
+    // Values of FIELD_USER, FIELD_IP or FIELD_LEVEL by code
+    const std::vector<std::string>& dictionary(EntryField field) const;
+
+    uint64_t rows() const;
+
+    // Approximate memory held, updated as entries are added
+    uint64_t memoryBytes() const {
+        return memoryBytes_;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Block>> blocks_;  // The last one is filled up to SEGMENT_BLOCK_ROWS
+    ColumnDictionary dictionaries_[3];            // user, ip, level
+    uint64_t rows_ = 0;
+    std::atomic<uint64_t> memoryBytes_{0};
+};
+
+// Reads one segment file. Columns are named by EntryField bits.
+class SegmentReader {
+public:
+    struct BlockInfo {
+        uint32_t rows;
+        int64_t minTime;
+        int64_t maxTime;
+    };
+
+    SegmentReader() = default;
+    ~SegmentReader();
+
+    SegmentReader(const SegmentReader&) = delete;
+    SegmentReader& operator=(const SegmentReader&) = delete;
+
+    // Reads the footer and the dictionaries of the given columns
+    bool open(const std::string& path, uint32_t columns);
+
+    size_t blockCount() const {
+        return blocks_.size();
+    }
+    const BlockInfo& blockInfo(size_t block) const {
+        return blocks_[block].info;
+    }
+
+    // Dictionary of FIELD_USER, FIELD_IP or FIELD_LEVEL (loaded by open)
+    const std::vector<std::string>& dictionary(EntryField field) const;
+
+    // Decode the given columns of a block into out; false on a corrupt block
+    bool readBlock(size_t block, uint32_t columns, SegmentBlock& out);
+
+    // Bytes of column data read from the file so far
+    uint64_t bytesRead() const {
+        return bytesRead_;
+    }
+
+private:
+    struct ChunkRef {
+        uint64_t offset;
+        uint32_t storedSize;
+        uint32_t rawSize;
+        uint8_t codec;
+    };
+    struct Block {
+        BlockInfo info;
+        ChunkRef columns[5];
+    };
+
+    // Read and decompress a chunk
+    bool readChunk(const ChunkRef& chunk, std::string& raw);
+
+    std::string path_;
+    std::FILE* file_ = nullptr;
+    std::vector<Block> blocks_;
+    ChunkRef dictionaryChunks_[3];
+    std::vector<std::string> dictionaries_[3];
+    std::string chunk_;  // Reused read buffer
+    uint64_t bytesRead_ = 0;
+};
+
+#endif // SEGMENT_STORE_H
@@ -0,0 +1,173 @@
+#include "thread_pool.h"
+#include "metrics.h"
+#include "cpu_topology.h"
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+
+// NUMA node of the calling pool worker
+static thread_local size_t workerNode = 0;
+
+ThreadPool::ThreadPool(unsigned int numThreads, bool pinWorkers)
+    : nodeCount_(1), pendingTasks_(0), busyThreads_(0), virtualClock_(0), stop_(false) {
+    if (numThreads == 0) {
+        numThreads = std::thread::hardware_concurrency();
+        if (numThreads == 0) numThreads = 4; // Default to 4 if can't detect
+    }
+
+    CpuTopology topology;
+    if (pinWorkers) {
+        topology = CpuTopology::detect();
+        if (topology.nodes.empty()) {
+            std::cerr << "Worker pinning is not supported on this platform" << std::endl;
+        }
+        else {
+            nodeCount_ = std::min<size_t>(topology.nodes.size(), numThreads);
+        }
+    }
+
+    // Workers go round-robin over the nodes, and over each node's CPUs
+    for (unsigned int i = 0; i < numThreads; ++i) {
+        size_t node = 0;
+        int cpu = -1;
+        if (!topology.nodes.empty()) {
+            node = i % nodeCount_;
+            const std::vector<int>& cpus = topology.nodes[node];
+            cpu = cpus[(i / nodeCount_) % cpus.size()];
+        }
+        threads_.emplace_back(&ThreadPool::workerThread, this, node, cpu);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::unique_lock<std::mutex> lock(queueMutex_);
+        stop_ = true;
+    }
+    condition_.notify_all();
+
+    // Workers drain the queue before exiting
+    for (auto& thread : threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+void ThreadPool::addTask(std::function<void()> task) {
+    addTask(0, std::move(task));
+}
+
+void ThreadPool::addTask(QueueId queue, std::function<void()> task) {
+    {
+        std::unique_lock<std::mutex> lock(queueMutex_);
+        Queue& q = queues_[queue];
+        if (q.tasks.empty() && q.running == 0) {
+            // A queue that was idle starts level with the others instead of
+            // cashing in the time it did not use
+            q.virtualTime = std::max(q.virtualTime, virtualClock_);
+        }
+        q.tasks.push_back(std::move(task));
+        pendingTasks_++;
+    }
+    condition_.notify_one();
+}
+
+void ThreadPool::setQueueWeight(QueueId queue, double weight) {
+    std::unique_lock<std::mutex> lock(queueMutex_);
+    if (weight > 0) {
+        weights_[queue] = weight;
+    }
+}
+
+size_t ThreadPool::size() const {
+    return threads_.size();
+}
+
+ThreadPool::Load ThreadPool::load() {
+    std::unique_lock<std::mutex> lock(queueMutex_);
+    return {pendingTasks_, busyThreads_};
+}
+
+size_t ThreadPool::nodeCount() const {
+    return nodeCount_;
+}
+
+size_t ThreadPool::currentNode() {
+    return workerNode;
+}
+
+double ThreadPool::weightOf(QueueId queue) const {
+    auto it = weights_.find(queue);
+    return it == weights_.end() ? 1.0 : it->second;
+}
+
+void ThreadPool::workerThread(size_t node, int cpu) {
+    // Pinned before running anything, so the worker's memory is first
+    // touched on its node
+    workerNode = node;
+    if (cpu >= 0 && !pinCurrentThread(cpu)) {
+        std::cerr << "Error pinning worker thread to CPU " << cpu << std::endl;
+    }
+
+    while (true) {
+        QueueId queue = 0;
+        std::function<void()> task = getTask(queue);
+        if (!task) {
+            break; // Exit if no more tasks or stop is requested
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        task(); // Execute the task
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        Metrics::add(MetricCounter::WORKER_BUSY_US,
+                     std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+        taskDone(queue, std::chrono::duration<double>(elapsed).count());
+    }
+}
+
+std::function<void()> ThreadPool::getTask(QueueId& queue) {
+    std::unique_lock<std::mutex> lock(queueMutex_);
+
+    condition_.wait(lock, [this]() {
+        return stop_ || pendingTasks_ > 0;
+    });
+
+    if (stop_ && pendingTasks_ == 0) {
+        return nullptr;
+    }
+
+    // Serve the queue furthest behind its fair share
+    Queue* next = nullptr;
+    for (auto& pair : queues_) {
+        Queue& q = pair.second;
+        if (!q.tasks.empty() && (!next || q.virtualTime < next->virtualTime)) {
+            next = &q;
+            queue = pair.first;
+        }
+    }
+
+    virtualClock_ = next->virtualTime;
+    auto task = std::move(next->tasks.front());
+    next->tasks.pop_front();
+    next->running++;
+    pendingTasks_--;
+    busyThreads_++;
+    return task;
+}
+
+void ThreadPool::taskDone(QueueId queue, double seconds) {
+    std::unique_lock<std::mutex> lock(queueMutex_);
+    busyThreads_--;
+    auto it = queues_.find(queue);
+    if (it == queues_.end()) {
+        return;
+    }
+
+    Queue& q = it->second;
+    q.virtualTime += seconds / weightOf(queue);
+    q.running--;
+    if (q.tasks.empty() && q.running == 0) {
+        queues_.erase(it);
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
+
+// Fixed-size pool of worker threads. The server shares one pool between all
+// requests; standalone analyzers (e.g. client edge mode) own a private one.
+//
+// Tasks are grouped into queues (the server uses one per client). An idle
+// worker serves the non-empty queue that has received the least worker time
+// relative to its weight, so a client with a large backlog cannot starve
+// the others; within a queue tasks run in FIFO order.
+//
+// With pinWorkers, worker i is bound to one CPU of NUMA node i % nodes (see
+// CpuTopology), so memory a worker allocates and touches first (its arena,
+// its node's share of a request's counts) stays on its own node.
+class ThreadPool {
+public:
+    // numThreads == 0 selects the hardware concurrency
+    explicit ThreadPool(unsigned int numThreads = 0, bool pinWorkers = false);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    using QueueId = uint64_t;
+
+    // Queue a task for execution on a worker thread (default queue 0)
+    void addTask(std::function<void()> task);
+    void addTask(QueueId queue, std::function<void()> task);
+
+    // Share of worker time given to a queue relative to others (default 1)
+    void setQueueWeight(QueueId queue, double weight);
+
+    // Number of worker threads
+    size_t size() const;
+
+    // Tasks waiting for a worker, and workers running one
+    struct Load {
+        size_t pendingTasks;
+        size_t busyThreads;
+    };
+    Load load();
+
+    // NUMA nodes the workers are spread over: 1 unless pinned
+    size_t nodeCount() const;
+
+    // Node of the pool worker calling this (0 on any other thread)
+    static size_t currentNode();
+
+private:
+    // Worker thread function; cpu < 0 leaves the thread unpinned
+    void workerThread(size_t node, int cpu);
+
+    struct Queue {
+        std::deque<std::function<void()>> tasks;
+        double virtualTime = 0;  // Worker seconds received, divided by weight
+        size_t running = 0;
+    };
+
+    // Next task and the queue it came from; task is empty once the pool is
+    // stopping and drained
+    std::function<void()> getTask(QueueId& queue);
+
+    // Charge a finished task's run time to its queue
+    void taskDone(QueueId queue, double seconds);
+
+    double weightOf(QueueId queue) const;
+
+    std::vector<std::thread> threads_;
+    size_t nodeCount_;
+    std::mutex queueMutex_;
+    std::condition_variable condition_;
+    std::unordered_map<QueueId, Queue> queues_;
+    std::unordered_map<QueueId, double> weights_;
+    size_t pendingTasks_;
+    size_t busyThreads_;
+    double virtualClock_;  // Virtual time of the most recently served queue
+    bool stop_;
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,188 @@
+#include "common/trace.h"
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+struct TraceEvent {
+    uint64_t traceId = 0;
+    const char* name = nullptr;
+    std::string detail;
+    RequestTrace::Clock::time_point start;
+    RequestTrace::Clock::time_point end;
+};
+
+// Written by its thread, read by exports: the lock is only ever contended
+// while a trace is being exported
+struct TraceRing {
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+    size_t next = 0;
+    uint32_t threadId = 0;
+};
+
+class RingRegistry {
+public:
+    TraceRing* acquire() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_.empty()) {
+            TraceRing* ring = free_.back();
+            free_.pop_back();
+            return ring;
+        }
+        rings_.emplace_back(new TraceRing());
+        rings_.back()->threadId = static_cast<uint32_t>(rings_.size());
+        return rings_.back().get();
+    }
+
+    // The ring keeps its spans for traces still to be exported; its next
+    // thread shows up with the same thread id
+    void release(TraceRing* ring) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(ring);
+    }
+
+    template <typename Function>
+    void forEach(Function function) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& ring : rings_) {
+            function(*ring);
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<TraceRing>> rings_;
+    std::vector<TraceRing*> free_;
+};
+
+// Never destroyed: threads may still record during static destruction
+RingRegistry& registry() {
+    static RingRegistry* instance = new RingRegistry();
+    return *instance;
+}
+
+struct RingHandle {
+    TraceRing* ring = nullptr;
+    ~RingHandle() {
+        if (ring) {
+            registry().release(ring);
+        }
+    }
+};
+
+// Created the first time the thread records a span
+TraceRing& localRing() {
+    thread_local RingHandle handle;
+    if (!handle.ring) {
+        handle.ring = registry().acquire();
+    }
+    return *handle.ring;
+}
+
+std::atomic<uint64_t> nextTraceId{1};
+
+std::string jsonEscape(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            std::ostringstream code;
+            code << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c);
+            out += code.str();
+        }
+        else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+RequestTrace::RequestTrace(std::string label)
+    : id_(nextTraceId++), label_(std::move(label)), origin_(Clock::now()) {}
+
+void RequestTrace::record(const char* name, Clock::time_point start, Clock::time_point end,
+                          const std::string& detail) const {
+    TraceRing& ring = localRing();
+    std::lock_guard<std::mutex> lock(ring.mutex);
+    if (ring.events.size() < TRACE_RING_CAPACITY) {
+        ring.events.emplace_back();
+    }
+    TraceEvent& event = ring.events[ring.next];
+    ring.next = (ring.next + 1) % TRACE_RING_CAPACITY;
+    event.traceId = id_;
+    event.name = name;
+    event.detail = detail;
+    event.start = start;
+    event.end = end;
+}
+
+std::string RequestTrace::exportJson() const {
+    struct Span {
+        uint32_t threadId;
+        TraceEvent event;
+    };
+    std::vector<Span> spans;
+    std::vector<uint32_t> threads;
+    registry().forEach([&](TraceRing& ring) {
+        std::lock_guard<std::mutex> lock(ring.mutex);
+        bool seen = false;
+        for (const auto& event : ring.events) {
+            if (event.traceId == id_) {
+                spans.push_back({ring.threadId, event});
+                seen = true;
+            }
+        }
+        if (seen) {
+            threads.push_back(ring.threadId);
+        }
+    });
+    std::sort(spans.begin(), spans.end(),
+              [](const Span& a, const Span& b) { return a.event.start < b.event.start; });
+
+    auto micros = [this](Clock::time_point time) {
+        return std::chrono::duration<double, std::micro>(time - origin_).count();
+    };
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"request\":\"" << jsonEscape(label_) << "\"},\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"log server: "
+        << jsonEscape(label_) << "\"}}";
+    for (uint32_t thread : threads) {
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+            << ",\"args\":{\"name\":\"thread " << thread << "\"}}";
+    }
+    for (const auto& span : spans) {
+        out << ",\n{\"name\":\"" << span.event.name << "\",\"cat\":\"request\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+            << span.threadId << ",\"ts\":" << micros(span.event.start)
+            << ",\"dur\":" << micros(span.event.end) - micros(span.event.start);
+        if (!span.event.detail.empty()) {
+            out << ",\"args\":{\"file\":\"" << jsonEscape(span.event.detail) << "\"}";
+        }
+        out << "}";
+    }
+    out << "\n]}\n";
+    return out.str();
+}
+
+bool RequestTrace::writeJson(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error creating trace file: " << path << std::endl;
+        return false;
+    }
+    file << exportJson();
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,76 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <chrono>
+#include <cstdint>
+
+// Spans of one traced request (AnalysisRequest::trace), exported as
+// Chrome/Perfetto trace-event JSON once the request is over.
+//
+// Spans go to a ring buffer owned by the recording thread (the oldest are
+// overwritten once it holds TRACE_RING_CAPACITY), tagged with the trace id;
+// export collects this trace's spans from every ring. Untraced requests
+// carry no RequestTrace, so each instrumentation point costs one null check.
+class RequestTrace {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit RequestTrace(std::string label);
+
+    uint64_t id() const {
+        return id_;
+    }
+
+    // Record a finished span on the calling thread; detail (e.g. a file
+    // name) is shown as the span's "file" argument when not empty
+    void record(const char* name, Clock::time_point start, Clock::time_point end,
+                const std::string& detail = std::string()) const;
+
+    // Trace-event JSON of every span of this trace still held in the rings,
+    // with timestamps relative to the trace's creation
+    std::string exportJson() const;
+
+    // Write exportJson() to a file
+    bool writeJson(const std::string& path) const;
+
+private:
+    uint64_t id_;
+    std::string label_;
+    Clock::time_point origin_;
+};
+
+// Spans kept per thread before the oldest are overwritten
+constexpr size_t TRACE_RING_CAPACITY = 16384;
+
+// Records the time until it goes out of scope; does nothing without a trace
+class TraceSpan {
+public:
+    TraceSpan(const RequestTrace* trace, const char* name) : trace_(trace), name_(name) {
+        if (trace_) {
+            start_ = RequestTrace::Clock::now();
+        }
+    }
+    TraceSpan(const RequestTrace* trace, const char* name, const std::string& detail) : trace_(trace), name_(name) {
+        if (trace_) {
+            detail_ = detail;
+            start_ = RequestTrace::Clock::now();
+        }
+    }
+    ~TraceSpan() {
+        if (trace_) {
+            trace_->record(name_, start_, RequestTrace::Clock::now(), detail_);
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const RequestTrace* trace_;
+    const char* name_;
+    std::string detail_;
+    RequestTrace::Clock::time_point start_;
+};
+
+#endif // TRACE_H
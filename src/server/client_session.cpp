@@ -0,0 +1,1052 @@
+#include "server/client_session.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+
+namespace fs = std::filesystem;
+
+static MetricStage requestStage(AnalysisType type) {
+    switch (type) {
+        case AnalysisType::IP: return MetricStage::REQUEST_IP;
+        case AnalysisType::LOG_LEVEL: return MetricStage::REQUEST_LOG_LEVEL;
+        case AnalysisType::PATTERN: return MetricStage::REQUEST_PATTERN;
+        default: return MetricStage::REQUEST_USER;
+    }
+}
+
+std::vector<std::pair<std::string, uint64_t>> serverGauges(ServerContext& context) {
+    RequestScheduler::Usage usage = context.scheduler.usage();
+    ThreadPool::Load load = context.workers.load();
+    SessionManager::Usage sessions = context.sessions.usage();
+    return {{"active_requests", usage.activeRequests},
+            {"queued_requests", usage.queuedRequests},
+            {"buffered_bytes", usage.memoryUsed},
+            {"worker_threads", context.workers.size()},
+            {"busy_workers", load.busyThreads},
+            {"queued_tasks", load.pendingTasks},
+            {"resident_memory_bytes", residentMemoryBytes()},
+            {"piece_cache_pieces", context.pieces ? context.pieces->pieceCount() : 0},
+            {"piece_cache_bytes", context.pieces ? context.pieces->sizeBytes() : 0},
+            {"result_cache_entries", context.results ? context.results->entryCount() : 0},
+            {"result_cache_bytes", context.results ? context.results->sizeBytes() : 0},
+            {"session_memory_bytes", sessions.bytes},
+            {"idle_sessions", sessions.idleSessions}};
+}
+
+ClientSession::ClientSession(ServerContext& context, const std::string& clientKey, const std::string& tempDir,
+                             SendFunction send, PostFunction post)
+    : context_(context), clientKey_(clientKey), tempDir_(tempDir), send_(std::move(send)), post_(std::move(post)),
+      state_(State::AWAIT_REQUEST), aborted_(false), requestId_(0), waitingForMemory_(false),
+      cancelled_(false), finalResult_(false), dedupBytes_(0),
+      sessionReady_(false), tableReserved_(0), idleTimer_(0), sessionRequests_(0),
+      fileCount_(0), receivedBytes_(0), fileBytes_(0), compressed_(false), reservedBytes_(0),
+      progressPosted_(false) {
+}
+
+ClientSession::~ClientSession() {
+    // Release the analyzer (waits for jobs still running) before its spill files
+    context_.sessions.disarm(idleTimer_);
+    analyzer_.reset();
+    releaseRequest();
+    dropTable();
+    if (spillFile_.is_open()) {
+        spillFile_.close();
+    }
+
+    // Clean up temporary directory
+    try {
+        if (fs::exists(tempDir_)) {
+            fs::remove_all(tempDir_);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error cleaning up temp directory: " << e.what() << std::endl;
+    }
+}
+
+bool ClientSession::onMessage(char type, std::string& message) {
+    switch (state_) {
+        case State::AWAIT_REQUEST:
+            if (type == MSG_WINDOW) {
+                handleWindowQuery(message);
+                return true;
+            }
+            if (type == MSG_STATS) {
+                handleStats();
+                return true;
+            }
+            if (type != MSG_REQUEST) {
+                std::cerr << "Invalid initial message from client" << std::endl;
+                return false;
+            }
+            return handleRequest(message);
+
+        case State::AWAIT_FILE:
+            if (type == MSG_FILE_END) {
+                handleUploadEnd();
+                return true;
+            }
+            else if (type == MSG_PARTIAL_RESULT) {
+                if (table_) {
+                    fail("A session keeps uploaded files only, not partial results");
+                    return true;
+                }
+                // Edge client already parsed and aggregated its logs locally;
+                // the result arrives in frames and is acknowledged once complete
+                if (!partialDecoder_.addFrame(message)) {
+                    return true;
+                }
+                partials_.push_back(partialDecoder_.takeResult());
+                std::cout << "Received partial result: " << partials_.back().totalEntries
+                          << " entries, " << partials_.back().counts.size() << " keys" << std::endl;
+                send_(MSG_ACK, "Partial result received");
+                return true;
+            }
+            else if (type == MSG_FILE_START) {
+                return handleFileStart(message);
+            }
+            else if (type == MSG_MANIFEST && !request_.follow && missingPieces_.empty()) {
+                handleManifest(message);
+                return true;
+            }
+            else if (type == MSG_CANCEL) {
+                handleCancel();
+                return true;
+            }
+            else if (request_.follow && type == MSG_QUERY) {
+                handleQuery();
+                return true;
+            }
+            else if (request_.follow && type == MSG_FILE_RESET) {
+                handleFileReset(message);
+                return true;
+            }
+            std::cerr << "Unexpected message type: " << type << std::endl;
+            return false;
+
+        case State::RECEIVING_FILE:
+            if (type == MSG_FILE_CHUNK) {
+                return handleFileChunk(message);
+            }
+            else if (type == MSG_FILE_END) {
+                handleFileEnd();
+                return true;
+            }
+            else if (type == MSG_CANCEL) {
+                handleCancel();
+                return true;
+            }
+            std::cerr << "Unexpected message type during file transfer: " << type << std::endl;
+            return false;
+
+        case State::AWAIT_SESSION_REQUEST:
+            if (type != MSG_REQUEST) {
+                std::cerr << "Unexpected message type between session requests: " << type << std::endl;
+                return false;
+            }
+            handleSessionRequest(message);
+            return true;
+
+        case State::ANALYZING:
+            if (type == MSG_CANCEL) {
+                handleCancel();
+                return true;
+            }
+            std::cerr << "Unexpected message type during analysis: " << type << std::endl;
+            return false;
+
+        default:
+            std::cerr << "Unexpected message type after upload: " << type << std::endl;
+            return false;
+    }
+}
+
+bool ClientSession::handleRequest(const std::string& message) {
+    request_ = deserializeRequest(message);
+    std::cout << "Received analysis request: " << analysisTypeToString(request_.type) << std::endl;
+    if (!validateRequest()) {
+        return true;
+    }
+    if (context_.results) {
+        resultKey_ = ResultCache::requestKey(request_);
+    }
+    if (request_.session) {
+        if (request_.follow || !request_.storeAs.empty() || !request_.dataset.empty()) {
+            fail("Only a plain upload can be kept for a session");
+            return true;
+        }
+        table_ = std::make_shared<MemoryTable>();
+        std::cout << "Session: keeping the uploaded entries for further requests" << std::endl;
+    }
+    if (!request_.storeAs.empty() || !request_.dataset.empty()) {
+        const std::string& name = request_.storeAs.empty() ? request_.dataset : request_.storeAs;
+        std::string path;
+        if (context_.storeDir.empty()) {
+            fail("Datasets are not enabled on this server (--store-dir)");
+            return true;
+        }
+        if (!request_.storeAs.empty() && (!request_.dataset.empty() || request_.follow)) {
+            fail("Only a plain upload can be stored as a dataset");
+            return true;
+        }
+        if (!datasetPath(context_.storeDir, name, path)) {
+            fail("Invalid dataset name: " + name);
+            return true;
+        }
+        if (!request_.dataset.empty()) {
+            if (!fs::is_directory(path)) {
+                fail("Unknown dataset: " + name);
+                return true;
+            }
+            datasetSegments_ = listSegments(path);
+            std::shared_ptr<const AnalysisResult> cached;
+            if (context_.results) {
+                std::string key = ResultCache::datasetFingerprint(path) + "/" + resultKey_;
+                cached = context_.results->find(key);
+                if (!cached) {
+                    datasetResultKey_ = key;
+                }
+            }
+            if (cached) {
+                // Merged into the (otherwise empty) result once the upload ends
+                cachedResults_.push_back(cached);
+                datasetSegments_.clear();
+                std::cout << "Querying dataset " << name << " (result cached)" << std::endl;
+            }
+            else {
+                std::cout << "Querying dataset " << name << " (" << datasetSegments_.size() << " segment(s))"
+                          << std::endl;
+            }
+        }
+        else {
+            writer_ = std::make_unique<SegmentWriter>(context_.storeDir, name);
+            if (!writer_->ok()) {
+                writer_.reset();
+                fail("Cannot store dataset: " + name);
+                return true;
+            }
+            std::cout << "Storing upload as dataset " << name << std::endl;
+        }
+    }
+
+    createAnalyzer();
+    admitRequest();
+    return true;
+}
+
+bool ClientSession::validateRequest() {
+    if (!request_.filter.empty()) {
+        std::string error;
+        auto filter = FilterProgram::compile(request_.filter, error);
+        if (!filter) {
+            std::cerr << "Rejecting request with invalid filter: " << error << std::endl;
+            fail("Invalid filter: " + error);
+            return false;
+        }
+        std::cout << "Filter: " << filter->describe() << std::endl;
+    }
+    if (request_.type == AnalysisType::PATTERN) {
+        if (request_.patterns.empty() || request_.patterns.size() > MAX_PATTERNS) {
+            fail("A pattern request needs 1 to " + std::to_string(MAX_PATTERNS) + " patterns");
+            return false;
+        }
+        if (patternBytes(request_.patterns) > MAX_PATTERN_BYTES) {
+            fail("The patterns of a request may add up to " + std::to_string(MAX_PATTERN_BYTES) + " bytes at most");
+            return false;
+        }
+        std::cout << "Counting " << request_.patterns.size() << " pattern(s)" << std::endl;
+    }
+    return true;
+}
+
+void ClientSession::createAnalyzer() {
+    // Files are analyzed on the shared pool while the rest are still arriving,
+    // in this client's queue; parsed buffers are handed back to the budget
+    RequestScheduler& scheduler = context_.scheduler;
+    requestStart_ = std::chrono::steady_clock::now();
+    analyzer_ = std::make_unique<LogAnalyzer>(request_, context_.workers, scheduler.queueFor(clientKey_));
+    analyzer_->setReleaseCallback([&scheduler](size_t bytes) { scheduler.unreserve(bytes); });
+    // Only live (follow mode) uploads feed the sliding windows; archives
+    // uploaded for analysis would only be dropped there as too old
+    SlidingWindow* window = request_.follow ? &context_.window : nullptr;
+    SegmentWriter* writer = writer_.get();
+    // Session requests after the upload read the table and parse nothing
+    MemoryTable* table = sessionReady_ ? nullptr : table_.get();
+    if (window || writer || table) {
+        analyzer_->setEntrySink([window, writer, table](const std::pmr::vector<LogEntry>& entries) {
+            if (window) {
+                window->add(entries);
+            }
+            if (writer) {
+                writer->add(entries);
+            }
+            if (table) {
+                table->add(entries);
+            }
+        });
+    }
+    if (request_.trace) {
+        trace_ = std::make_shared<RequestTrace>(clientKey_ + " " + analysisTypeToString(request_.type));
+        analyzer_->setTrace(trace_);
+    }
+    if (request_.progressIntervalMs > 0) {
+        // Coalesced: at most one progress check is queued at a time
+        PostFunction post = post_;
+        analyzer_->setProgressCallback([this, post]() {
+            if (!progressPosted_.exchange(true)) {
+                post([this]() { onProgress(); });
+            }
+        });
+    }
+    // A stored or kept upload is parsed here, where its entries are written
+    if (context_.coordinator && !writer_ && !table_) {
+        ShardCoordinator* coordinator = context_.coordinator;
+        AnalysisRequest request = request_;
+        request.progressIntervalMs = 0;
+        request.expectedBytes = 0;
+        request.follow = false;
+        request.trace = false;
+        analyzer_->setDelegate([coordinator, request](const LogSource& shard, AnalysisResult& result) {
+            return coordinator->analyze(request, shard, result);
+        });
+    }
+}
+
+void ClientSession::admitRequest() {
+    RequestScheduler& scheduler = context_.scheduler;
+    requestId_ = scheduler.nextRequestId();
+    PostFunction post = post_;
+    switch (scheduler.admit(requestId_, [this, post]() { post([this]() { onAdmitted(); }); })) {
+        case RequestScheduler::Admission::ADMITTED:
+            if (sessionReady_) {
+                startSessionQuery();
+            }
+            else {
+                state_ = State::AWAIT_FILE;
+            }
+            break;
+        case RequestScheduler::Admission::QUEUED:
+            state_ = State::AWAIT_ADMISSION;
+            break;
+        case RequestScheduler::Admission::REJECTED:
+            std::cerr << "Admission queue full, rejecting request" << std::endl;
+            requestId_ = 0;
+            fail("Server busy, try again later");
+            break;
+    }
+}
+
+void ClientSession::handleSessionRequest(const std::string& message) {
+    context_.sessions.disarm(idleTimer_);
+    idleTimer_ = 0;
+    request_ = deserializeRequest(message);
+    sessionRequests_++;
+    std::cout << "Session request " << sessionRequests_ << ": " << analysisTypeToString(request_.type) << std::endl;
+    if (!validateRequest()) {
+        return;
+    }
+    if (request_.follow || !request_.storeAs.empty() || !request_.dataset.empty()) {
+        fail("A session request can only query the entries already uploaded");
+        return;
+    }
+
+    cancelled_ = false;
+    trace_.reset();
+    createAnalyzer();
+    admitRequest();
+}
+
+void ClientSession::startSessionQuery() {
+    requestStart_ = std::chrono::steady_clock::now();
+    uploadEnd_ = requestStart_;
+    analyzer_->submitTable(table_);
+    waitForAnalyzer();
+}
+
+void ClientSession::awaitSessionRequest() {
+    state_ = State::AWAIT_SESSION_REQUEST;
+    idleSince_ = std::chrono::steady_clock::now();
+    PostFunction post = post_;
+    idleTimer_ = context_.sessions.arm([this, post]() { post([this]() { onIdleTimeout(); }); });
+}
+
+void ClientSession::onIdleTimeout() {
+    // A request may have arrived after the timer fired
+    if (state_ != State::AWAIT_SESSION_REQUEST ||
+        std::chrono::steady_clock::now() - idleSince_ < context_.sessions.idleTimeout()) {
+        return;
+    }
+    idleTimer_ = 0;
+    std::cout << "Session idle for " << context_.sessions.idleTimeout().count() << "s after "
+              << sessionRequests_ << " further request(s), closing" << std::endl;
+    send_(MSG_ERROR, "Session closed after " + std::to_string(context_.sessions.idleTimeout().count()) +
+                         "s without a request");
+    dropTable();
+    state_ = State::FINISHED;
+}
+
+bool ClientSession::reserveTable() {
+    uint64_t bytes = table_->memoryBytes();
+    if (bytes > tableReserved_) {
+        if (!context_.sessions.reserve(bytes - tableReserved_)) {
+            std::cerr << "Session over the memory cap, not keeping it" << std::endl;
+            fail("The upload is too large to keep for a session (cap " +
+                 std::to_string(context_.sessions.memoryCap() / (1024 * 1024)) + " MB for all sessions)");
+            return false;
+        }
+        tableReserved_ = bytes;
+    }
+    return true;
+}
+
+void ClientSession::dropTable() {
+    context_.sessions.release(tableReserved_);
+    tableReserved_ = 0;
+    table_.reset();
+    sessionReady_ = false;
+}
+
+void ClientSession::handleWindowQuery(const std::string& message) {
+    // "TYPE|minutes": answered from the running sums, no analysis involved
+    AnalysisResult result;
+    size_t separator = message.find('|');
+    int minutes = 0;
+    try {
+        result.type = stringToAnalysisType(message.substr(0, separator));
+        minutes = separator == std::string::npos ? 0 : std::stoi(message.substr(separator + 1));
+    }
+    catch (const std::exception&) {
+        fail("Invalid window query");
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (!context_.window.query(result.type, minutes, result)) {
+        fail("Unsupported window: " + std::to_string(minutes) + " minutes");
+        return;
+    }
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    std::cout << "Window query: " << analysisTypeToString(result.type) << " over the last " << minutes
+              << " minutes up to " << context_.window.windowEnd() << " (" << result.counts.size()
+              << " keys, " << micros.count() << " us)" << std::endl;
+
+    streamResult(std::move(result), true);
+}
+
+void ClientSession::handleStats() {
+    ServerStats stats = collectStats();
+    stats.gauges = serverGauges(context_);
+    send_(MSG_STATS, serializeStats(stats));
+    state_ = State::FINISHED;
+}
+
+void ClientSession::onAdmitted() {
+    if (state_ != State::AWAIT_ADMISSION) {
+        return;
+    }
+    double queuedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - requestStart_).count();
+    std::cout << "Request admitted after " << queuedSeconds << "s in the admission queue" << std::endl;
+
+    requestStart_ = std::chrono::steady_clock::now();
+    if (sessionReady_) {
+        startSessionQuery();
+    }
+    else {
+        state_ = State::AWAIT_FILE;
+    }
+}
+
+void ClientSession::onMemoryAvailable() {
+    waitingForMemory_ = false;
+}
+
+void ClientSession::handleManifest(const std::string& message) {
+    // "name\nhash size\n...": cached pieces are analyzed from the cache, and
+    // the client sends the others, in order, as files of their own. Pieces
+    // of a stored or kept upload are all sent, since the dataset or session
+    // table is written from what is parsed here.
+    std::istringstream lines(message);
+    std::string name;
+    std::getline(lines, name);
+    name = fs::path(name).filename().string();
+
+    std::string missing;
+    size_t index = 0;
+    size_t reused = 0;
+    std::string line;
+    while (std::getline(lines, line)) {
+        std::istringstream fields(line);
+        std::string hash;
+        uint64_t size = 0;
+        std::string key;
+        if (!(fields >> hash >> size) || !PieceCache::pieceKey(hash, name, key)) {
+            fail("Invalid manifest for " + name);
+            return;
+        }
+        // The piece's result for this request, or else its parsed entries
+        std::string resultKey = key + "/" + resultKey_;
+        std::shared_ptr<const AnalysisResult> cached;
+        if (context_.results && !writer_ && !table_) {
+            cached = context_.results->find(resultKey);
+        }
+        std::vector<std::string> segments;
+        if (cached) {
+            cachedResults_.push_back(cached);
+        }
+        else if (context_.pieces && !writer_ && !table_ && context_.pieces->acquire(key, segments)) {
+            pinnedPieces_.push_back(key);
+            ResultCache* results = context_.results;
+            if (results && segments.size() <= 1) {
+                // Keep the piece's own result for the next request over it
+                if (segments.empty()) {
+                    AnalysisResult empty;
+                    empty.type = request_.type;
+                    results->insert(resultKey, std::move(empty));
+                }
+                else {
+                    analyzer_->submitSegment(segments[0], [results, resultKey](const AnalysisResult& result) {
+                        results->insert(resultKey, result);
+                    });
+                }
+            }
+            else {
+                for (const auto& segment : segments) {
+                    analyzer_->submitSegment(segment);
+                }
+            }
+        }
+        else {
+            missing += (missing.empty() ? "" : ",") + std::to_string(index);
+            missingPieces_.push_back(key);
+            index++;
+            continue;
+        }
+        dedupBytes_ += size;
+        Metrics::add(MetricCounter::BYTES_DEDUPLICATED, size);
+        reused++;
+        index++;
+    }
+    std::cout << "Manifest of " << name << ": " << reused << " of " << index << " piece(s) already here" << std::endl;
+    send_(MSG_MANIFEST, missing);
+}
+
+bool ClientSession::handleFileStart(const std::string& message) {
+    // Start of a new file (strip any directory components sent by the client)
+    source_ = LogSource();
+    source_.name = fs::path(message).filename().string();
+    fileBytes_ = 0;
+    compressed_ = false;
+    fileStart_ = std::chrono::steady_clock::now();
+    if (!request_.follow) {
+        std::cout << "Receiving file: " << source_.name << std::endl;
+    }
+
+    // Follow mode: an append continues the record the previous one left incomplete
+    auto carried = carry_.find(source_.name);
+    if (carried != carry_.end()) {
+        source_.content = std::move(carried->second);
+        carry_.erase(carried);
+        reservedBytes_ += source_.content.size();
+        context_.scheduler.reserve(source_.content.size());
+    }
+
+    // A piece announced in a manifest: its entries are also written to the
+    // piece cache, and its content is checked against the hash as it arrives
+    pieceKey_.clear();
+    pieceWriter_.reset();
+    if (!missingPieces_.empty()) {
+        pieceKey_ = missingPieces_.front();
+        missingPieces_.pop_front();
+        pieceHash_ = ContentHasher();
+        if (context_.pieces && !writer_) {
+            pieceWriter_ = context_.pieces->writer(pieceKey_);
+            if (pieceWriter_->ok()) {
+                std::shared_ptr<SegmentWriter> writer = pieceWriter_;
+                source_.sink = [writer](const std::pmr::vector<LogEntry>& entries) { writer->add(entries); };
+            }
+            else {
+                pieceWriter_.reset();
+            }
+        }
+    }
+
+    // Used to cut large files at record boundaries
+    parser_ = LogParser::createParser(source_.name);
+    state_ = State::RECEIVING_FILE;
+    return true;
+}
+
+bool ClientSession::handleFileChunk(const std::string& message) {
+    receivedBytes_ += message.size();
+    if (fileBytes_ == 0) {
+        // Recognised by its magic bytes: record boundaries only exist after decompression
+        compressed_ = detectCompression(message) != Compression::NONE;
+    }
+    fileBytes_ += message.size();
+    Metrics::add(MetricCounter::BYTES_RECEIVED, message.size());
+    if (!pieceKey_.empty()) {
+        pieceHash_.update(message.data(), message.size());
+    }
+
+    // Data not parsed yet counts against the memory limit
+    size_t inMemory = analyzer_->pendingBytes() + source_.content.size() + message.size();
+    if (!spillFile_.is_open() && inMemory > context_.memoryLimit) {
+        if (!spillToDisk()) {
+            fail("Error creating file");
+            return false;
+        }
+    }
+
+    if (spillFile_.is_open()) {
+        StageTimer timer(MetricStage::SPILL);
+        spillFile_.write(message.data(), message.size());
+        Metrics::add(MetricCounter::BYTES_SPILLED, message.size());
+        return true;
+    }
+
+    source_.content += message;
+    reservedBytes_ += message.size();
+    bool withinBudget = context_.scheduler.reserve(message.size());
+
+    // Hand complete records of large files to the pool without waiting for the end
+    if (!compressed_ && source_.content.size() >= PIPELINE_CHUNK_SIZE) {
+        size_t boundary = parser_->lastRecordBoundary(source_.content);
+        if (boundary > 0) {
+            LogSource piece;
+            piece.name = source_.name;
+            piece.content = source_.content.substr(0, boundary);
+            piece.sink = source_.sink;
+            source_.content.erase(0, boundary);
+            reservedBytes_ -= boundary;
+            analyzer_->submit(std::move(piece));
+        }
+    }
+
+    if (withinBudget) {
+        return true;
+    }
+
+    // Server-wide budget exhausted: stop reading while our own queued pieces
+    // will free memory; with nothing of ours in flight, move the file to disk
+    if (analyzer_->pendingBytes() > 0) {
+        PostFunction post = post_;
+        waitingForMemory_ = context_.scheduler.waitForMemory(requestId_, [this, post]() {
+            post([this]() { onMemoryAvailable(); });
+        });
+        return true;
+    }
+    if (!spillToDisk()) {
+        fail("Error creating file");
+        return false;
+    }
+    return true;
+}
+
+void ClientSession::handleFileEnd() {
+    // Entries parsed so far count against the session memory cap
+    if (table_ && !reserveTable()) {
+        return;
+    }
+    auto fileEnd = std::chrono::steady_clock::now();
+    Metrics::record(MetricStage::RECEIVE, fileEnd - fileStart_);
+    if (trace_) {
+        trace_->record("receive", fileStart_, fileEnd, source_.name);
+    }
+
+    // A piece that does not match its hash is analyzed, but not cached
+    if (pieceWriter_) {
+        if (pieceKey_.compare(0, 32, pieceHash_.hex()) == 0) {
+            pieceWriters_.emplace_back(pieceKey_, pieceWriter_);
+        }
+        else {
+            std::cerr << "Piece of " << source_.name << " does not match its hash, not caching it" << std::endl;
+        }
+        pieceWriter_.reset();
+    }
+
+    // End of this file: analyze it while the next one is received
+    if (spillFile_.is_open()) {
+        spillFile_.close();
+    }
+    else if (request_.follow && !compressed_) {
+        // The file may still be growing: keep its trailing partial record
+        // for the next append instead of parsing it now
+        size_t boundary = parser_->lastRecordBoundary(source_.content);
+        if (boundary < source_.content.size()) {
+            std::string rest = source_.content.substr(boundary);
+            source_.content.resize(boundary);
+            reservedBytes_ -= rest.size();
+            context_.scheduler.unreserve(rest.size());
+            carry_[source_.name] = std::move(rest);
+        }
+    }
+    reservedBytes_ -= source_.content.size();
+    if (!source_.content.empty() || !source_.spillPath.empty()) {
+        analyzer_->submit(std::move(source_));
+    }
+    source_ = LogSource();
+    fileCount_++;
+    state_ = State::AWAIT_FILE;
+    send_(MSG_ACK, "File received");
+}
+
+void ClientSession::handleUploadEnd() {
+    std::cout << "Received " << fileCount_ << " files (" << receivedBytes_ << " bytes) and "
+              << partials_.size() << " partial results" << std::endl;
+    if (dedupBytes_ > 0) {
+        std::cout << "Deduplicated " << dedupBytes_ << " bytes already in the piece cache" << std::endl;
+    }
+    std::cout << "Processing log files..." << std::endl;
+
+    // Follow mode: files may end without a record terminator
+    for (auto& pair : carry_) {
+        LogSource rest;
+        rest.name = pair.first;
+        rest.content = std::move(pair.second);
+        context_.scheduler.reserve(rest.content.size());
+        analyzer_->submit(std::move(rest));
+    }
+    carry_.clear();
+
+    // Stored dataset: a job per segment
+    for (const auto& segment : datasetSegments_) {
+        analyzer_->submitSegment(segment);
+    }
+
+    uploadEnd_ = std::chrono::steady_clock::now();
+    waitForAnalyzer();
+}
+
+void ClientSession::handleQuery() {
+    // Answered from the aggregates in memory; appends still being parsed
+    // show up in the next query
+    streamResult(analyzer_->current(), false);
+}
+
+void ClientSession::handleFileReset(const std::string& message) {
+    // Truncated, replaced or gone: its partial record will never be completed
+    std::string name = fs::path(message).filename().string();
+    carry_.erase(name);
+    std::cout << "File reset: " << name << std::endl;
+}
+
+void ClientSession::handleCancel() {
+    if (cancelled_) {
+        return;
+    }
+    cancelled_ = true;
+    std::cout << "Client cancelled the analysis, sending the result so far" << std::endl;
+
+    // Queued jobs are skipped; the result is what running ones have merged
+    analyzer_->cancel();
+    if (state_ == State::ANALYZING) {
+        return;
+    }
+
+    // Mid-upload: the file being received is dropped
+    if (spillFile_.is_open()) {
+        spillFile_.close();
+    }
+    source_ = LogSource();
+    uploadEnd_ = std::chrono::steady_clock::now();
+    waitForAnalyzer();
+}
+
+void ClientSession::onProgress() {
+    progressPosted_ = false;
+    if (aborted_ || !analyzer_ ||
+        (state_ != State::AWAIT_FILE && state_ != State::RECEIVING_FILE && state_ != State::ANALYZING)) {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    auto interval = std::chrono::milliseconds(std::max(request_.progressIntervalMs, MIN_PROGRESS_INTERVAL_MS));
+    if (now - lastProgress_ < interval) {
+        return;
+    }
+    lastProgress_ = now;
+
+    AnalysisProgress progress;
+    size_t distinctKeys = 0;
+    progress.top = analyzer_->snapshot(PROGRESS_TOP_K, distinctKeys);
+    progress.distinctKeys = distinctKeys;
+    progress.bytesAnalyzed = analyzer_->processedBytes();
+    progress.bytesReceived = receivedBytes_;
+    progress.bytesExpected = request_.expectedBytes;
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - requestStart_);
+    progress.elapsedMs = static_cast<uint64_t>(elapsed.count());
+
+    // Estimate from the rate so far; the total is known once the upload has
+    // ended, or if the client announced it
+    uint64_t total = receivedBytes_;
+    if (state_ != State::ANALYZING) {
+        total = std::max(total, request_.expectedBytes);
+    }
+    if (progress.bytesAnalyzed > 0 && total > progress.bytesAnalyzed) {
+        double rate = static_cast<double>(progress.bytesAnalyzed) / static_cast<double>(progress.elapsedMs + 1);
+        progress.remainingMs = static_cast<uint64_t>((total - progress.bytesAnalyzed) / rate);
+    }
+
+    send_(MSG_PROGRESS, encodeProgress(resultEncoder_, progress));
+}
+
+void ClientSession::waitForAnalyzer() {
+    state_ = State::ANALYZING;
+
+    // The callback runs on a worker thread; hop back to the session's thread
+    // (after writing out the last segment of a stored upload there)
+    analyzer_->finishAsync([this](const AnalysisResult& result) {
+        if (writer_) {
+            writer_->finish();
+        }
+        for (auto& piece : pieceWriters_) {
+            piece.second->finish();
+        }
+        post_([this, result]() { onAnalysisDone(result); });
+    });
+}
+
+bool ClientSession::spillToDisk() {
+    if (!fs::exists(tempDir_)) {
+        fs::create_directory(tempDir_);
+    }
+
+    // Numbered: a file name can come up again (e.g. appends in follow mode)
+    source_.spillPath = tempDir_ + "/" + std::to_string(fileCount_) + "_" + source_.name;
+    spillFile_.open(source_.spillPath, std::ios::binary);
+    if (!spillFile_) {
+        std::cerr << "Error creating file: " << source_.spillPath << std::endl;
+        return false;
+    }
+
+    std::cout << "Memory limit reached, spilling " << source_.name << " to disk" << std::endl;
+
+    // Move what was already buffered for this file to disk
+    StageTimer timer(MetricStage::SPILL);
+    spillFile_.write(source_.content.data(), source_.content.size());
+    Metrics::add(MetricCounter::BYTES_SPILLED, source_.content.size());
+    std::string().swap(source_.content);
+    context_.scheduler.unreserve(reservedBytes_);
+    reservedBytes_ = 0;
+    return true;
+}
+
+void ClientSession::onAnalysisDone(AnalysisResult result) {
+    state_ = State::FINISHED;
+    releaseRequest();
+    if (aborted_) {
+        return;
+    }
+
+    // A session request only scans the kept entries
+    if (sessionReady_) {
+        std::cout << std::fixed << std::setprecision(3) << "Session request " << sessionRequests_ << ": scanned "
+                  << analyzer_->blocksScanned() << " block(s), skipped " << analyzer_->blocksSkipped()
+                  << " outside the date range, in " << analyzer_->busySeconds() << "s" << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+        if (cancelled_) {
+            std::cout << "Analysis cancelled: sending " << result.totalEntries << " entries analyzed so far" << std::endl;
+        }
+        streamResult(std::move(result), true);
+        return;
+    }
+
+    // Report how much of the analysis was hidden behind the upload
+    auto resultReady = std::chrono::steady_clock::now();
+    double uploadSeconds = std::chrono::duration<double>(uploadEnd_ - requestStart_).count();
+    double tailSeconds = std::chrono::duration<double>(resultReady - uploadEnd_).count();
+    double busySeconds = analyzer_->busySeconds();
+    double overlappedSeconds = analyzer_->busySecondsBefore(uploadEnd_);
+    std::cout << std::fixed << std::setprecision(3)
+              << "Pipeline: upload " << uploadSeconds << "s, analysis " << busySeconds
+              << "s (" << overlappedSeconds << "s overlapped with upload, "
+              << (busySeconds > 0 ? 100.0 * overlappedSeconds / busySeconds : 100.0)
+              << "%), result ready " << tailSeconds << "s after last byte" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+
+    if (!datasetSegments_.empty()) {
+        std::cout << "Dataset " << request_.dataset << ": scanned " << analyzer_->blocksScanned()
+                  << " block(s), skipped " << analyzer_->blocksSkipped() << " outside the date range" << std::endl;
+    }
+    // A dataset's result is cached when nothing else went into it
+    if (!datasetResultKey_.empty() && !cancelled_ && fileCount_ == 0 && partials_.empty() && dedupBytes_ == 0) {
+        context_.results->insert(datasetResultKey_, result);
+    }
+    if (writer_) {
+        // Only a complete upload replaces the dataset
+        if (cancelled_) {
+            std::cout << "Dataset " << request_.storeAs << " not stored: the analysis was cancelled" << std::endl;
+        }
+        else if (writer_->commit()) {
+            std::cout << "Stored dataset " << request_.storeAs << ": " << writer_->rows() << " entries in "
+                      << writer_->storedBytes() << " bytes" << std::endl;
+        }
+        writer_.reset();
+    }
+
+    // Received pieces, complete unless the analysis was cancelled
+    if (!cancelled_) {
+        for (auto& piece : pieceWriters_) {
+            context_.pieces->commit(piece.first, *piece.second);
+        }
+    }
+    pieceWriters_.clear();
+
+    // Session mode: the entries are kept once the whole upload is analyzed
+    if (table_) {
+        if (cancelled_) {
+            std::cout << "Session not kept: the analysis was cancelled" << std::endl;
+            dropTable();
+        }
+        else {
+            if (!reserveTable()) {
+                return;
+            }
+            sessionReady_ = true;
+            std::cout << "Session: kept " << table_->rows() << " entries in " << table_->blockCount()
+                      << " block(s), " << tableReserved_ << " bytes" << std::endl;
+        }
+    }
+
+    if (cancelled_) {
+        std::cout << "Analysis cancelled: sending " << result.totalEntries << " entries analyzed so far" << std::endl;
+    }
+
+    streamResult(std::move(result), true);
+}
+
+void ClientSession::streamResult(AnalysisResult result, bool final) {
+    // Merge partial results computed on edge clients
+    for (const auto& partial : partials_) {
+        if (partial.type != request_.type) {
+            std::cerr << "Ignoring partial result of type " << analysisTypeToString(partial.type) << std::endl;
+            continue;
+        }
+        mergeResult(result, partial);
+    }
+    // Results found in the result cache
+    for (const auto& cached : cachedResults_) {
+        mergeResult(result, *cached);
+    }
+
+    // Stream the result back to the client; the driver pulls further frames
+    result_ = std::move(result);
+    resultEncoder_.begin(result_);
+    finalResult_ = final;
+    state_ = State::STREAMING_RESULT;
+    produceOutput();
+}
+
+bool ClientSession::hasPendingOutput() const {
+    return state_ == State::STREAMING_RESULT;
+}
+
+void ClientSession::produceOutput() {
+    if (state_ != State::STREAMING_RESULT) {
+        return;
+    }
+    {
+        TraceSpan span(trace_.get(), "send_result");
+        std::string frame;
+        {
+            StageTimer timer(MetricStage::SERIALIZE);
+            frame = resultEncoder_.nextFrame();
+        }
+        send_(MSG_RESULT, frame);
+    }
+    if (resultEncoder_.done()) {
+        result_ = AnalysisResult();
+        if (!finalResult_) {
+            state_ = State::AWAIT_FILE;
+            return;
+        }
+        state_ = State::FINISHED;
+        if (analyzer_) {
+            Metrics::record(requestStage(request_.type), std::chrono::steady_clock::now() - requestStart_);
+            Metrics::add(MetricCounter::REQUESTS_COMPLETED, 1);
+        }
+        if (trace_) {
+            writeTrace();
+        }
+        std::cout << "Analysis completed and sent to client" << std::endl;
+        if (sessionReady_) {
+            awaitSessionRequest();
+        }
+    }
+}
+
+void ClientSession::writeTrace() {
+    trace_->record("request", requestStart_, std::chrono::steady_clock::now());
+    std::error_code error;
+    fs::create_directories(context_.traceDir, error);
+    std::string path = (fs::path(context_.traceDir) / ("trace_" + std::to_string(trace_->id()) + ".json")).string();
+    if (trace_->writeJson(path)) {
+        std::cout << "Trace written to " << path << std::endl;
+    }
+    trace_.reset();
+}
+
+void ClientSession::abort() {
+    if (aborted_) {
+        return;
+    }
+    aborted_ = true;
+    context_.sessions.disarm(idleTimer_);
+    idleTimer_ = 0;
+    source_ = LogSource();
+    if (analyzer_) {
+        // Drop queued work; jobs already running finish in the background
+        analyzer_->cancel();
+    }
+
+    if (analyzer_ && (state_ == State::AWAIT_FILE || state_ == State::RECEIVING_FILE)) {
+        waitForAnalyzer();
+    }
+    else if (state_ != State::ANALYZING) {
+        releaseRequest();
+        state_ = State::FINISHED;
+    }
+}
+
+void ClientSession::releaseRequest() {
+    if (reservedBytes_ > 0) {
+        context_.scheduler.unreserve(reservedBytes_);
+        reservedBytes_ = 0;
+    }
+    if (requestId_ != 0) {
+        context_.scheduler.release(requestId_);
+        requestId_ = 0;
+    }
+    waitingForMemory_ = false;
+    for (const auto& key : pinnedPieces_) {
+        context_.pieces->release(key);
+    }
+    pinnedPieces_.clear();
+}
+
+bool ClientSession::isAnalyzing() const {
+    return state_ == State::ANALYZING;
+}
+
+bool ClientSession::wantsInput() const {
+    if (waitingForMemory_) {
+        return false;
+    }
+    return state_ == State::AWAIT_REQUEST || state_ == State::AWAIT_FILE || state_ == State::RECEIVING_FILE ||
+           state_ == State::ANALYZING || state_ == State::AWAIT_SESSION_REQUEST;
+}
+
+bool ClientSession::isIdle() const {
+    return state_ == State::AWAIT_SESSION_REQUEST;
+}
+
+bool ClientSession::isFinished() const {
+    return state_ == State::FINISHED;
+}
+
+void ClientSession::fail(const std::string& error) {
+    send_(MSG_ERROR, error);
+    abort();
+}
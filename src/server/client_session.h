@@ -0,0 +1,255 @@
+#ifndef CLIENT_SESSION_H
+#define CLIENT_SESSION_H
+
+#include "common/protocol.h"
+#include "common/analyzer.h"
+#include "common/result_codec.h"
+#include "common/log_parser.h"
+#include "common/metrics.h"
+#include "common/thread_pool.h"
+#include "common/segment_store.h"
+#include "common/content_hash.h"
+#include "server/scheduler.h"
+#include "server/coordinator.h"
+#include "server/sliding_window.h"
+#include "server/piece_cache.h"
+#include "server/result_cache.h"
+#include "server/session_manager.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <fstream>
+#include <functional>
+#include <chrono>
+#include <atomic>
+#include <deque>
+
+// Large files are handed to the analysis pool in pieces of about this size.
+// A piece is also the scheduling quantum: a small request waits at most for
+// the pieces already running before its own jobs get a worker.
+constexpr size_t PIPELINE_CHUNK_SIZE = 1024 * 1024;
+
+// Progress messages carry this many of the largest counts so far, and are
+// not sent more often than every MIN_PROGRESS_INTERVAL_MS
+constexpr size_t PROGRESS_TOP_K = 10;
+constexpr uint32_t MIN_PROGRESS_INTERVAL_MS = 100;
+
+// Server-wide state shared by all client sessions
+struct ServerContext {
+    ThreadPool& workers;
+    RequestScheduler& scheduler;
+    size_t memoryLimit;
+    ShardCoordinator* coordinator;  // Set in coordinator mode: shards go to worker nodes
+    SlidingWindow& window;          // Recent counts over live (follow mode) uploads
+    std::string traceDir;           // Where traced requests write their trace JSON
+    std::string storeDir;           // Where datasets are stored, empty if the store is off
+    PieceCache* pieces;             // Parsed upload pieces, null if the store is off
+    ResultCache* results;           // Results over pieces and datasets, null if off
+    SessionManager& sessions;       // Limits of multi-query sessions
+};
+
+// Current load, as reported by MSG_STATS and the metrics endpoint
+std::vector<std::pair<std::string, uint64_t>> serverGauges(ServerContext& context);
+
+// Protocol state machine for one client connection. It is fed complete
+// messages by an I/O driver (blocking thread or event loop), queues replies
+// through send, and never blocks on analysis: parsing runs on the shared
+// worker pool and completion is delivered back through post, which must run
+// the closure on the thread that owns this session.
+class ClientSession {
+public:
+    using SendFunction = std::function<void(char type, const std::string& message)>;
+    using PostFunction = std::function<void(std::function<void()>)>;
+
+    // clientKey identifies the client for fair sharing (e.g. its IP address)
+    ClientSession(ServerContext& context, const std::string& clientKey, const std::string& tempDir,
+                  SendFunction send, PostFunction post);
+    ~ClientSession();
+
+    ClientSession(const ClientSession&) = delete;
+    ClientSession& operator=(const ClientSession&) = delete;
+
+    // Handle one message from the client; returns false if the connection
+    // should be closed because of a protocol error
+    bool onMessage(char type, std::string& message);
+
+    // The client went away: skip analysis work that has not started yet
+    void abort();
+
+    // Waiting for the worker pool; the session must stay alive until this clears
+    bool isAnalyzing() const;
+
+    // Ready for more client data. False while waiting for admission or
+    // memory, or while sending the result: the driver then stops reading the
+    // socket, which pushes back on the client through TCP flow control.
+    // True while analyzing, when the client may still cancel.
+    bool wantsInput() const;
+
+    // The result is being streamed: the driver calls produceOutput whenever
+    // its send queue runs low, so only a few frames are buffered at a time
+    bool hasPendingOutput() const;
+
+    // Queue the next result frame through send
+    void produceOutput();
+
+    // Result (or error) has been queued; close once it is flushed
+    bool isFinished() const;
+
+    // Session mode, between requests: the idle timeout is delivered through
+    // post, so the driver must keep running posts while waiting for input
+    bool isIdle() const;
+
+private:
+    enum class State {
+        AWAIT_REQUEST,   // Expecting MSG_REQUEST (or MSG_WINDOW)
+        AWAIT_ADMISSION, // Request queued by the scheduler
+        AWAIT_FILE,      // Between files: MSG_FILE_START, MSG_MANIFEST, MSG_PARTIAL_RESULT or final MSG_FILE_END
+                         // (and in follow mode MSG_QUERY or MSG_FILE_RESET)
+        RECEIVING_FILE,  // Inside a file: MSG_FILE_CHUNK or MSG_FILE_END
+        ANALYZING,       // Upload complete, waiting for the worker pool (or MSG_CANCEL)
+        STREAMING_RESULT, // Sending result frames as the connection drains
+        AWAIT_SESSION_REQUEST, // Session mode: entries kept, expecting the next MSG_REQUEST
+        FINISHED
+    };
+
+    bool handleRequest(const std::string& message);
+    // Session mode: a further request, over the kept entries
+    void handleSessionRequest(const std::string& message);
+    void handleWindowQuery(const std::string& message);
+    void handleStats();
+    void handleManifest(const std::string& message);
+    bool handleFileStart(const std::string& message);
+    bool handleFileChunk(const std::string& message);
+    void handleFileEnd();
+    void handleUploadEnd();
+    void handleCancel();
+    void handleQuery();
+    void handleFileReset(const std::string& message);
+
+    // Check a request's filter and patterns; false once it has been rejected
+    bool validateRequest();
+
+    // Analyzer for request_, reporting progress and tracing as it asks
+    void createAnalyzer();
+
+    // Ask the scheduler to admit request_ (a new request id each time)
+    void admitRequest();
+
+    // Session mode: analyze the kept entries for request_
+    void startSessionQuery();
+
+    // Session mode: wait for the next request, with the idle timeout armed
+    void awaitSessionRequest();
+    void onIdleTimeout();
+
+    // Account for the growth of table_ with the session manager; false
+    // (after failing the request) if it is over the memory cap
+    bool reserveTable();
+
+    // Give up the kept entries
+    void dropTable();
+
+    // Scheduler callbacks, posted to the session's thread
+    void onAdmitted();
+    void onMemoryAvailable();
+
+    // Posted by the analyzer's progress callback; sends MSG_PROGRESS when due
+    void onProgress();
+
+    // Free the request's scheduler slot and buffered memory
+    void releaseRequest();
+
+    // Enter ANALYZING until every submitted job has completed
+    void waitForAnalyzer();
+
+    // Move the current file to disk once the request is over its memory limit
+    bool spillToDisk();
+
+    // Runs on the session's thread once the analyzer has merged every job
+    void onAnalysisDone(AnalysisResult result);
+
+    // Merge edge partial results and start streaming; after a query result
+    // (not final) the session goes back to waiting for data
+    void streamResult(AnalysisResult result, bool final);
+
+    void fail(const std::string& error);
+
+    // Export a traced request's spans to context_.traceDir
+    void writeTrace();
+
+    ServerContext& context_;
+    std::string clientKey_;
+    std::string tempDir_;
+    SendFunction send_;
+    PostFunction post_;
+    State state_;
+    bool aborted_;
+
+    // Current request
+    AnalysisRequest request_;
+    uint64_t requestId_;          // Scheduler id, 0 when no request is registered
+    bool waitingForMemory_;
+    bool cancelled_;              // Client asked for the result so far
+    std::unique_ptr<LogAnalyzer> analyzer_;
+    std::vector<AnalysisResult> partials_;
+    ResultDecoder partialDecoder_;
+    AnalysisResult result_;       // Kept while it is being streamed
+    ResultEncoder resultEncoder_;
+    bool finalResult_;            // The result being streamed ends the session
+    std::shared_ptr<RequestTrace> trace_;  // Set when the client asked for a trace
+    std::unique_ptr<SegmentWriter> writer_;  // Set when the upload is stored as a dataset
+    std::vector<std::string> datasetSegments_;  // Segments of the dataset queried
+    // Result cache: the request's key (ResultCache::requestKey), results of
+    // pieces or the dataset found there, and the key to store the dataset's
+    // result under once computed (empty if it was found or is not cached)
+    std::string resultKey_;
+    std::vector<std::shared_ptr<const AnalysisResult>> cachedResults_;
+    std::string datasetResultKey_;
+
+    // Deduplicated upload: pieces still to be received, in the order the
+    // client sends them, and the cached pieces this request reads
+    std::deque<std::string> missingPieces_;
+    std::vector<std::string> pinnedPieces_;
+    uint64_t dedupBytes_;         // Announced in manifests but already on the server
+    // Piece being received: its key, hash so far and cache writer
+    std::string pieceKey_;
+    ContentHasher pieceHash_;
+    std::shared_ptr<SegmentWriter> pieceWriter_;
+    // Received pieces whose hash checked out, committed once analyzed
+    std::vector<std::pair<std::string, std::shared_ptr<SegmentWriter>>> pieceWriters_;
+
+    // Session mode: the uploaded entries, kept for further requests once
+    // the upload has been analyzed (sessionReady_), the bytes of them
+    // reserved with the session manager, and the idle timer (0 if none)
+    std::shared_ptr<MemoryTable> table_;
+    bool sessionReady_;
+    uint64_t tableReserved_;
+    uint64_t idleTimer_;
+    std::chrono::steady_clock::time_point idleSince_;
+    int sessionRequests_;
+
+    // Follow mode: incomplete last record of each file, prepended to its next append
+    std::unordered_map<std::string, std::string> carry_;
+    int fileCount_;
+    size_t receivedBytes_;
+
+    // File being received
+    LogSource source_;
+    size_t fileBytes_;            // Received for this file so far
+    bool compressed_;             // Compressed files are analyzed whole, not cut into pieces
+    size_t reservedBytes_;        // Buffered in source_ and reserved with the scheduler
+    std::unique_ptr<LogParser> parser_;
+    std::ofstream spillFile_;
+
+    // Pipeline timing
+    std::chrono::steady_clock::time_point requestStart_;
+    std::chrono::steady_clock::time_point uploadEnd_;
+    std::chrono::steady_clock::time_point fileStart_;
+
+    // Progress reporting
+    std::atomic<bool> progressPosted_;
+    std::chrono::steady_clock::time_point lastProgress_;
+};
+
+#endif // CLIENT_SESSION_H
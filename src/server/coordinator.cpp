@@ -0,0 +1,221 @@
+#include "server/coordinator.h"
+#include "common/result_codec.h"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <netdb.h>
+#endif
+
+// Shard data is streamed to worker nodes in messages of this size
+constexpr size_t SHARD_CHUNK_SIZE = 64 * 1024;
+
+// A node that failed is not tried again for this long
+constexpr std::chrono::seconds NODE_RETRY_DELAY(5);
+
+// Worker nodes that stop responding are given up on after this long
+constexpr int NODE_TIMEOUT_SECONDS = 300;
+
+std::vector<WorkerNode> parseWorkerNodes(const std::string& list) {
+    std::vector<WorkerNode> nodes;
+    size_t pos = 0;
+    while (pos <= list.size()) {
+        size_t comma = list.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = list.size();
+        }
+        std::string item = list.substr(pos, comma - pos);
+        pos = comma + 1;
+        if (item.empty()) {
+            continue;
+        }
+
+        size_t colon = item.rfind(':');
+        if (colon == std::string::npos || colon == 0) {
+            throw std::runtime_error("expected host:port, got " + item);
+        }
+        WorkerNode node;
+        node.host = item.substr(0, colon);
+        node.port = std::stoi(item.substr(colon + 1));
+        if (node.port <= 0 || node.port > 65535) {
+            throw std::runtime_error("invalid port in " + item);
+        }
+        nodes.push_back(node);
+    }
+    if (nodes.empty()) {
+        throw std::runtime_error("no worker nodes given");
+    }
+    return nodes;
+}
+
+// Connect to a worker node; INVALID_SOCKET_VALUE on failure
+static socket_t connectToNode(const WorkerNode& node) {
+    struct addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo* addresses = nullptr;
+    int error = getaddrinfo(node.host.c_str(), std::to_string(node.port).c_str(), &hints, &addresses);
+    if (error != 0) {
+        std::cerr << "Error resolving worker node " << node.host << ": " << gai_strerror(error) << std::endl;
+        return INVALID_SOCKET_VALUE;
+    }
+
+    socket_t sock = INVALID_SOCKET_VALUE;
+    for (struct addrinfo* addr = addresses; addr; addr = addr->ai_next) {
+        sock = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+        if (sock == INVALID_SOCKET_VALUE) {
+            continue;
+        }
+        if (connect(sock, addr->ai_addr, static_cast<int>(addr->ai_addrlen)) == 0) {
+            break;
+        }
+        close_socket(sock);
+        sock = INVALID_SOCKET_VALUE;
+    }
+    freeaddrinfo(addresses);
+
+    if (sock == INVALID_SOCKET_VALUE) {
+        return sock;
+    }
+
+    // A hung node must not hold a pool thread forever
+#ifdef _WIN32
+    DWORD timeout = NODE_TIMEOUT_SECONDS * 1000;
+#else
+    struct timeval timeout;
+    timeout.tv_sec = NODE_TIMEOUT_SECONDS;
+    timeout.tv_usec = 0;
+#endif
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+    return sock;
+}
+
+// Receive a reply, treating anything but the expected type as a failure
+static bool expectMessage(socket_t sock, char expected, std::string& message) {
+    char type;
+    if (!receiveMessage(sock, type, message)) {
+        return false;
+    }
+    if (type == MSG_ERROR) {
+        std::cerr << "Worker node error: " << message << std::endl;
+        return false;
+    }
+    return type == expected;
+}
+
+ShardCoordinator::ShardCoordinator(const std::vector<WorkerNode>& nodes) : next_(0) {
+    for (const auto& node : nodes) {
+        NodeState state;
+        state.node = node;
+        nodes_.push_back(state);
+    }
+}
+
+ShardCoordinator::~ShardCoordinator() {
+    for (const auto& state : nodes_) {
+        std::cout << "Worker node " << state.node.host << ":" << state.node.port << ": "
+                  << state.shards << " shards, " << state.failures << " failures" << std::endl;
+    }
+}
+
+size_t ShardCoordinator::nodeCount() const {
+    return nodes_.size();
+}
+
+bool ShardCoordinator::analyze(const AnalysisRequest& request, const LogSource& shard, AnalysisResult& result) {
+    size_t start;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        start = next_++;
+    }
+
+    // Try every node once, starting with this shard's turn in the rotation
+    for (size_t attempt = 0; attempt < nodes_.size(); ++attempt) {
+        size_t index = (start + attempt) % nodes_.size();
+        WorkerNode node;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (Clock::now() < nodes_[index].retryAfter) {
+                continue;
+            }
+            node = nodes_[index].node;
+        }
+
+        bool ok = runShard(node, request, shard, result);
+        reportShard(index, ok);
+        if (ok) {
+            return true;
+        }
+        std::cerr << "Worker node " << node.host << ":" << node.port << " failed on shard of "
+                  << shard.name << ", re-dispatching" << std::endl;
+    }
+
+    std::cerr << "No worker node available for shard of " << shard.name << ", analyzing it locally" << std::endl;
+    return false;
+}
+
+bool ShardCoordinator::runShard(const WorkerNode& node, const AnalysisRequest& request,
+                                const LogSource& shard, AnalysisResult& result) {
+    socket_t sock = connectToNode(node);
+    if (sock == INVALID_SOCKET_VALUE) {
+        return false;
+    }
+
+    bool ok = sendMessage(sock, MSG_REQUEST, serializeRequest(request)) &&
+              sendMessage(sock, MSG_FILE_START, shard.name);
+
+    // Stream the shard from memory, or from the coordinator's spill file
+    if (ok && shard.spillPath.empty()) {
+        for (size_t offset = 0; ok && offset < shard.content.size(); offset += SHARD_CHUNK_SIZE) {
+            ok = sendMessage(sock, MSG_FILE_CHUNK, shard.content.substr(offset, SHARD_CHUNK_SIZE));
+        }
+    }
+    else if (ok) {
+        std::ifstream file(shard.spillPath, std::ios::binary);
+        std::string chunk(SHARD_CHUNK_SIZE, '\0');
+        ok = static_cast<bool>(file);
+        while (ok && file) {
+            file.read(&chunk[0], chunk.size());
+            std::streamsize bytesRead = file.gcount();
+            if (bytesRead > 0) {
+                ok = sendMessage(sock, MSG_FILE_CHUNK, chunk.substr(0, static_cast<size_t>(bytesRead)));
+            }
+        }
+    }
+
+    // End of the file, then end of the upload
+    std::string message;
+    ok = ok && sendMessage(sock, MSG_FILE_END, "") && expectMessage(sock, MSG_ACK, message) &&
+         sendMessage(sock, MSG_FILE_END, "");
+    if (ok) {
+        std::string error;
+        try {
+            ok = receiveResult(sock, MSG_RESULT, result, error);
+            if (!ok) {
+                std::cerr << "Worker node error: " << error << std::endl;
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Invalid result from worker node: " << e.what() << std::endl;
+            ok = false;
+        }
+    }
+    close_socket(sock);
+    return ok && result.type == request.type;
+}
+
+void ShardCoordinator::reportShard(size_t index, bool ok) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    NodeState& state = nodes_[index];
+    if (ok) {
+        state.shards++;
+        return;
+    }
+    state.failures++;
+    state.retryAfter = Clock::now() + NODE_RETRY_DELAY;
+}
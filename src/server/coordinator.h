@@ -0,0 +1,61 @@
+#ifndef COORDINATOR_H
+#define COORDINATOR_H
+
+#include "common/protocol.h"
+#include "common/analyzer.h"
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+
+// A worker node: another server process that analyzes shards
+struct WorkerNode {
+    std::string host;
+    int port;
+};
+
+// Parse "host:port,host:port,..."; throws std::runtime_error on bad input
+std::vector<WorkerNode> parseWorkerNodes(const std::string& list);
+
+// Coordinator side of distributed mode. Each shard (a received file, or a
+// piece of one cut at a record boundary) is streamed to a worker node over
+// the ordinary client protocol, as a one-file request, and the node's
+// AnalysisResult is returned for merging. Nodes are used round-robin; a
+// node that fails is skipped for a while and the shard is re-dispatched to
+// the next one. Called concurrently from the worker pool, one shard per call.
+class ShardCoordinator {
+public:
+    explicit ShardCoordinator(const std::vector<WorkerNode>& nodes);
+
+    // Prints how many shards each node took
+    ~ShardCoordinator();
+
+    // Analyze one shard remotely; false if every node failed (the caller
+    // then analyzes it locally)
+    bool analyze(const AnalysisRequest& request, const LogSource& shard, AnalysisResult& result);
+
+    size_t nodeCount() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct NodeState {
+        WorkerNode node;
+        Clock::time_point retryAfter;  // Skipped until then after a failure
+        size_t shards = 0;
+        size_t failures = 0;
+    };
+
+    // Run the whole request/upload/result exchange with one node
+    bool runShard(const WorkerNode& node, const AnalysisRequest& request,
+                  const LogSource& shard, AnalysisResult& result);
+
+    // Record the outcome; a failed node is skipped for a while
+    void reportShard(size_t index, bool ok);
+
+    std::mutex mutex_;
+    std::vector<NodeState> nodes_;
+    size_t next_;
+};
+
+#endif // COORDINATOR_H
@@ -4,31 +4,143 @@
 #include <thread>
 #include <chrono>
 #include <csignal>
+#include <vector>
+#include <stdexcept>
 
-// Global server instance for signal handler
-LogServer* gServer = nullptr;
+// Set by the signal handler; the main loop performs the actual shutdown
+volatile std::sig_atomic_t gStopSignal = 0;
 
 // Signal handler
 void signalHandler(int signal) {
-    std::cout << "Received signal " << signal << std::endl;
-    if (gServer) {
-        gServer->stop();
-    }
+    gStopSignal = signal;
 }
 
 void printUsage(const char* programName) {
-    std::cout << "Usage: " << programName << " [port]" << std::endl;
+    std::cout << "Usage: " << programName << " [options] [port]" << std::endl;
     std::cout << "  port - Optional server port (default: " << DEFAULT_PORT << ")" << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --memory-limit <MB> - Received data kept in memory per request before spilling to disk (default: "
+              << DEFAULT_INGEST_MEMORY_LIMIT / (1024 * 1024) << ")" << std::endl;
+    std::cout << "  --io <mode>         - Connection handling: epoll (default on Linux), uring (falls back to epoll) or threads" << std::endl;
+    std::cout << "  --io-threads <n>    - I/O threads for the event loop (default: 1)" << std::endl;
+    std::cout << "  --workers <n>       - Analysis worker threads (default: hardware concurrency)" << std::endl;
+    std::cout << "  --pin-workers       - Bind each worker thread to a CPU, spread over the NUMA nodes, and merge counts per node" << std::endl;
+    std::cout << "  --max-active <n>    - Requests admitted at once; later ones wait in the admission queue (default: "
+              << SchedulerOptions().maxActiveRequests << ")" << std::endl;
+    std::cout << "  --admission-queue <n> - Requests waiting for admission before new ones are rejected (default: "
+              << SchedulerOptions().maxQueuedRequests << ")" << std::endl;
+    std::cout << "  --memory-budget <MB> - Received data buffered across all requests before reading pauses (default: "
+              << SchedulerOptions().memoryBudget / (1024 * 1024) << ")" << std::endl;
+    std::cout << "  --client-weight <ip>=<w> - Share of worker time for a client relative to others (default: 1)" << std::endl;
+    std::cout << "  --worker-nodes <host:port,...> - Coordinator mode: shard analysis across these worker servers" << std::endl;
+    std::cout << "  --metrics-port <port> - Serve Prometheus metrics over HTTP at /metrics on this port (default: off)" << std::endl;
+    std::cout << "  --trace-dir <dir>   - Where requests sent with --trace write their Chrome trace JSON (default: traces)" << std::endl;
+    std::cout << "  --store-dir <dir>   - Keep uploads sent with --store-as here as columnar datasets, for --dataset queries (default: off)" << std::endl;
+    std::cout << "  --piece-cache <MB>  - Disk space in the store for pieces of --dedup uploads (default: 1024)" << std::endl;
+    std::cout << "  --result-cache <MB> - Memory for results of repeated --dedup and --dataset queries (default: 256, 0 = off)" << std::endl;
+    std::cout << "  --session-memory <MB> - Entries kept by all --session clients together (default: 2048)" << std::endl;
+    std::cout << "  --session-idle <s>  - End a session after this long without a request (default: 300)" << std::endl;
+}
+
+IoMode parseIoMode(const std::string& mode) {
+    if (mode == "threads") return IoMode::THREADS;
+#ifdef __linux__
+    if (mode == "epoll") return IoMode::EPOLL;
+    if (mode == "uring") return IoMode::IO_URING;
+#endif
+    throw std::runtime_error("unsupported I/O mode: " + mode);
 }
 
 int main(int argc, char* argv[]) {
     // Parse command line arguments
-    int port = DEFAULT_PORT;
+    ServerOptions options;
+    std::vector<std::string> args;
     
-    if (argc > 1) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
         try {
-            port = std::stoi(argv[1]);
-            if (port <= 0 || port > 65535) {
+            if (arg == "--memory-limit" && i + 1 < argc) {
+                options.memoryLimit = std::stoull(argv[++i]) * 1024 * 1024;
+            }
+            else if (arg == "--io" && i + 1 < argc) {
+                options.ioMode = parseIoMode(argv[++i]);
+            }
+            else if (arg == "--io-threads" && i + 1 < argc) {
+                options.ioThreads = static_cast<unsigned int>(std::stoul(argv[++i]));
+            }
+            else if (arg == "--workers" && i + 1 < argc) {
+                options.workerThreads = static_cast<unsigned int>(std::stoul(argv[++i]));
+            }
+            else if (arg == "--pin-workers") {
+                options.pinWorkers = true;
+            }
+            else if (arg == "--max-active" && i + 1 < argc) {
+                options.scheduler.maxActiveRequests = std::stoul(argv[++i]);
+            }
+            else if (arg == "--admission-queue" && i + 1 < argc) {
+                options.scheduler.maxQueuedRequests = std::stoul(argv[++i]);
+            }
+            else if (arg == "--memory-budget" && i + 1 < argc) {
+                options.scheduler.memoryBudget = std::stoull(argv[++i]) * 1024 * 1024;
+            }
+            else if (arg == "--client-weight" && i + 1 < argc) {
+                std::string weight = argv[++i];
+                size_t eq = weight.find('=');
+                if (eq == std::string::npos) {
+                    throw std::runtime_error("expected <ip>=<weight>");
+                }
+                options.scheduler.clientWeights[weight.substr(0, eq)] = std::stod(weight.substr(eq + 1));
+            }
+            else if (arg == "--worker-nodes" && i + 1 < argc) {
+                options.workerNodes = parseWorkerNodes(argv[++i]);
+            }
+            else if (arg == "--trace-dir" && i + 1 < argc) {
+                options.traceDir = argv[++i];
+            }
+            else if (arg == "--store-dir" && i + 1 < argc) {
+                options.storeDir = argv[++i];
+            }
+            else if (arg == "--piece-cache" && i + 1 < argc) {
+                options.pieceCacheBytes = std::stoull(argv[++i]) * 1024 * 1024;
+            }
+            else if (arg == "--result-cache" && i + 1 < argc) {
+                options.resultCacheBytes = std::stoull(argv[++i]) * 1024 * 1024;
+            }
+            else if (arg == "--session-memory" && i + 1 < argc) {
+                options.sessionMemoryBytes = std::stoull(argv[++i]) * 1024 * 1024;
+            }
+            else if (arg == "--session-idle" && i + 1 < argc) {
+                options.sessionIdleSeconds = std::stoi(argv[++i]);
+                if (options.sessionIdleSeconds <= 0) {
+                    throw std::runtime_error("timeout must be at least 1 second");
+                }
+            }
+            else if (arg == "--metrics-port" && i + 1 < argc) {
+                options.metricsPort = std::stoi(argv[++i]);
+                if (options.metricsPort <= 0 || options.metricsPort > 65535) {
+                    throw std::runtime_error("port must be between 1 and 65535");
+                }
+            }
+            else if (arg.rfind("--", 0) == 0) {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+            else {
+                args.push_back(arg);
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error parsing " << arg << ": " << e.what() << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    
+    if (!args.empty()) {
+        try {
+            options.port = std::stoi(args[0]);
+            if (options.port <= 0 || options.port > 65535) {
                 std::cerr << "Error: Port must be between 1 and 65535" << std::endl;
                 printUsage(argv[0]);
                 return 1;
@@ -44,24 +156,30 @@ int main(int argc, char* argv[]) {
     // Set up signal handlers
     std::signal(SIGINT, signalHandler);
     std::signal(SIGTERM, signalHandler);
+#ifndef _WIN32
+    // A client vanishing mid-send must not kill the server
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
     
     // Create and start server
-    LogServer server(port);
-    gServer = &server;
+    LogServer server(options);
     
     if (!server.start()) {
         std::cerr << "Failed to start server" << std::endl;
         return 1;
     }
     
-    std::cout << "Server started on port " << port << std::endl;
     std::cout << "Press Ctrl+C to stop the server" << std::endl;
     
     // Wait for server to stop
     while (server.isRunning()) {
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        if (gStopSignal != 0) {
+            std::cout << "Received signal " << gStopSignal << std::endl;
+            server.stop();
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
     }
     
-    gServer = nullptr;
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "server/metrics_endpoint.h"
+#include <iostream>
+#include <cstring>
+
+// A scrape request is a few hundred bytes; anything larger is not one
+constexpr size_t MAX_REQUEST_SIZE = 8192;
+constexpr int REQUEST_TIMEOUT_MS = 5000;
+
+// How often the serving thread checks for stop()
+constexpr int ACCEPT_POLL_MS = 200;
+
+MetricsEndpoint::MetricsEndpoint(int port, RenderFunction render)
+    : port_(port), render_(std::move(render)), listener_(INVALID_SOCKET_VALUE), running_(false) {}
+
+MetricsEndpoint::~MetricsEndpoint() {
+    stop();
+}
+
+bool MetricsEndpoint::start() {
+    listener_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener_ == INVALID_SOCKET_VALUE) {
+        std::cerr << "Error creating metrics socket" << std::endl;
+        return false;
+    }
+
+    int opt = 1;
+    setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt));
+
+    struct sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port_);
+    if (bind(listener_, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(listener_, SOMAXCONN) < 0) {
+        std::cerr << "Error listening for metrics on port " << port_ << std::endl;
+        close_socket(listener_);
+        listener_ = INVALID_SOCKET_VALUE;
+        return false;
+    }
+
+    running_ = true;
+    thread_ = std::thread(&MetricsEndpoint::serveThread, this);
+    std::cout << "Serving metrics on http://0.0.0.0:" << port_ << "/metrics" << std::endl;
+    return true;
+}
+
+void MetricsEndpoint::stop() {
+    running_ = false;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    if (listener_ != INVALID_SOCKET_VALUE) {
+        close_socket(listener_);
+        listener_ = INVALID_SOCKET_VALUE;
+    }
+}
+
+void MetricsEndpoint::serveThread() {
+    while (running_) {
+        if (!socketReadable(listener_, ACCEPT_POLL_MS)) {
+            continue;
+        }
+        socket_t connection = accept(listener_, nullptr, nullptr);
+        if (connection == INVALID_SOCKET_VALUE) {
+            continue;
+        }
+        handleConnection(connection);
+        close_socket(connection);
+    }
+}
+
+static void sendAll(socket_t connection, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        int result = send(connection, data.data() + sent, static_cast<int>(data.size() - sent), 0);
+        if (result <= 0) {
+            return;
+        }
+        sent += static_cast<size_t>(result);
+    }
+}
+
+static std::string httpResponse(const std::string& status, const std::string& contentType,
+                                const std::string& body) {
+    return "HTTP/1.1 " + status + "\r\nContent-Type: " + contentType +
+           "\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+}
+
+void MetricsEndpoint::handleConnection(socket_t connection) {
+    // Only the request line matters: read up to the end of the headers
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST_SIZE) {
+        if (!socketReadable(connection, REQUEST_TIMEOUT_MS)) {
+            return;
+        }
+        int received = recv(connection, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            break;
+        }
+        request.append(buffer, static_cast<size_t>(received));
+    }
+
+    std::string line = request.substr(0, request.find("\r\n"));
+    size_t methodEnd = line.find(' ');
+    size_t pathEnd = line.find(' ', methodEnd == std::string::npos ? 0 : methodEnd + 1);
+    std::string method = line.substr(0, methodEnd);
+    std::string path = methodEnd == std::string::npos ? "" : line.substr(methodEnd + 1, pathEnd - methodEnd - 1);
+    path = path.substr(0, path.find('?'));
+
+    if (method != "GET" || path != "/metrics") {
+        sendAll(connection, httpResponse("404 Not Found", "text/plain", "Not found\n"));
+        return;
+    }
+    sendAll(connection, httpResponse("200 OK", "text/plain; version=0.0.4; charset=utf-8", render_()));
+}
@@ -0,0 +1,39 @@
+#ifndef METRICS_ENDPOINT_H
+#define METRICS_ENDPOINT_H
+
+#include "common/protocol.h"
+#include <string>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+// Minimal HTTP listener for monitoring scrapes: GET /metrics returns the
+// text render produces (Prometheus exposition format), anything else 404.
+// One thread serves one connection at a time and closes it after the reply,
+// which is all a scraper needs; metrics are only gathered when requested.
+class MetricsEndpoint {
+public:
+    using RenderFunction = std::function<std::string()>;
+
+    MetricsEndpoint(int port, RenderFunction render);
+    ~MetricsEndpoint();
+
+    MetricsEndpoint(const MetricsEndpoint&) = delete;
+    MetricsEndpoint& operator=(const MetricsEndpoint&) = delete;
+
+    // Bind the port and start serving
+    bool start();
+    void stop();
+
+private:
+    void serveThread();
+    void handleConnection(socket_t connection);
+
+    int port_;
+    RenderFunction render_;
+    socket_t listener_;
+    std::atomic<bool> running_;
+    std::thread thread_;
+};
+
+#endif // METRICS_ENDPOINT_H
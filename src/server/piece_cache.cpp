@@ -0,0 +1,139 @@
+#include "server/piece_cache.h"
+#include "common/log_parser.h"
+#include "common/metrics.h"
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+
+namespace fs = std::filesystem;
+
+static uint64_t directorySize(const fs::path& path) {
+    uint64_t bytes = 0;
+    std::error_code error;
+    for (const auto& entry : fs::directory_iterator(path, error)) {
+        std::error_code sizeError;
+        uint64_t size = entry.file_size(sizeError);
+        if (!sizeError) {
+            bytes += size;
+        }
+    }
+    return bytes;
+}
+
+PieceCache::PieceCache(const std::string& storeDir, uint64_t capacityBytes)
+    : directory_((fs::path(storeDir) / ".pieces").string()), capacity_(capacityBytes), bytes_(0) {
+    std::error_code error;
+    fs::create_directories(directory_, error);
+    if (error) {
+        std::cerr << "Error creating piece cache " << directory_ << ": " << error.message() << std::endl;
+        return;
+    }
+
+    // Pieces left by a previous run, oldest first; staging directories of
+    // pieces that were never committed are removed
+    std::vector<std::pair<fs::file_time_type, fs::path>> found;
+    for (const auto& entry : fs::directory_iterator(directory_, error)) {
+        std::string name = entry.path().filename().string();
+        if (name.empty() || name[0] == '.') {
+            std::error_code removeError;
+            fs::remove_all(entry.path(), removeError);
+            continue;
+        }
+        std::error_code timeError;
+        found.emplace_back(fs::last_write_time(entry.path(), timeError), entry.path());
+    }
+    std::sort(found.begin(), found.end());
+    for (const auto& piece : found) {
+        std::string key = piece.second.filename().string();
+        lru_.push_front(key);
+        Entry& entry = entries_[key];
+        entry.bytes = directorySize(piece.second);
+        entry.position = lru_.begin();
+        bytes_ += entry.bytes;
+    }
+    evict();
+}
+
+bool PieceCache::pieceKey(const std::string& hash, const std::string& filename, std::string& key) {
+    if (hash.size() != 32 || hash.find_first_not_of("0123456789abcdef") != std::string::npos) {
+        return false;
+    }
+    switch (LogParser::detectFormat(filename)) {
+        case LogFormat::JSON: key = hash + "-json"; break;
+        case LogFormat::XML: key = hash + "-xml"; break;
+        default: key = hash + "-txt"; break;
+    }
+    return true;
+}
+
+bool PieceCache::acquire(const std::string& key, std::vector<std::string>& segments) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = entries_.find(key);
+    if (found == entries_.end()) {
+        Metrics::add(MetricCounter::PIECE_CACHE_MISSES, 1);
+        return false;
+    }
+    Metrics::add(MetricCounter::PIECE_CACHE_HITS, 1);
+    lru_.splice(lru_.begin(), lru_, found->second.position);
+    found->second.pins++;
+    segments = listSegments((fs::path(directory_) / key).string());
+    return true;
+}
+
+void PieceCache::release(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = entries_.find(key);
+    if (found != entries_.end() && found->second.pins > 0) {
+        found->second.pins--;
+    }
+    evict();
+}
+
+std::shared_ptr<SegmentWriter> PieceCache::writer(const std::string& key) {
+    return std::make_shared<SegmentWriter>(directory_, key);
+}
+
+bool PieceCache::commit(const std::string& key, SegmentWriter& writer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Another request may have stored the same piece meanwhile; keep that
+    // copy, which may be pinned
+    if (entries_.count(key)) {
+        return true;
+    }
+    if (!writer.commit()) {
+        return false;
+    }
+    lru_.push_front(key);
+    Entry& entry = entries_[key];
+    entry.bytes = writer.storedBytes();
+    entry.position = lru_.begin();
+    bytes_ += entry.bytes;
+    evict();
+    return true;
+}
+
+void PieceCache::evict() {
+    auto position = lru_.end();
+    while (bytes_ > capacity_ && position != lru_.begin()) {
+        --position;
+        auto found = entries_.find(*position);
+        if (found->second.pins > 0) {
+            continue;
+        }
+        std::error_code error;
+        fs::remove_all(fs::path(directory_) / *position, error);
+        bytes_ -= found->second.bytes;
+        entries_.erase(found);
+        position = lru_.erase(position);
+    }
+}
+
+size_t PieceCache::pieceCount() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+uint64_t PieceCache::sizeBytes() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+}
@@ -0,0 +1,66 @@
+#ifndef PIECE_CACHE_H
+#define PIECE_CACHE_H
+
+#include "common/segment_store.h"
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+// Parsed upload pieces by content, so that data the server has already seen
+// is neither uploaded nor parsed again (see MSG_MANIFEST).
+//
+// A piece is a record-aligned part of a file, named by its content hash and
+// input format ("<hash>-txt"). Its entries are kept as a small columnar
+// dataset (segment_store.h) under <storeDir>/.pieces, which is analyzed like
+// a stored dataset instead of the piece's text. Pieces are evicted least
+// recently used first once the cache is over its capacity; a piece read by
+// a running request is pinned and never evicted under it.
+class PieceCache {
+public:
+    PieceCache(const std::string& storeDir, uint64_t capacityBytes);
+
+    // Look a piece up. If it is cached, pin it, set segments to its segment
+    // files (none if it had no entries) and return true.
+    bool acquire(const std::string& key, std::vector<std::string>& segments);
+
+    // Unpin a piece returned by acquire
+    void release(const std::string& key);
+
+    // Writer for a piece's entries, to be passed to commit once it is complete
+    std::shared_ptr<SegmentWriter> writer(const std::string& key);
+
+    // Add a written piece, then evict down to the capacity
+    bool commit(const std::string& key, SegmentWriter& writer);
+
+    // Cached pieces and their size on disk
+    size_t pieceCount();
+    uint64_t sizeBytes();
+
+    // Key of a piece: its content hash and the format it is parsed as;
+    // false if hash is not a content hash
+    static bool pieceKey(const std::string& hash, const std::string& filename, std::string& key);
+
+private:
+    struct Entry {
+        uint64_t bytes = 0;
+        int pins = 0;
+        std::list<std::string>::iterator position;  // In lru_
+    };
+
+    // Drop unpinned pieces, oldest first, until under capacity (mutex_ held)
+    void evict();
+
+    std::string directory_;
+    uint64_t capacity_;
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<std::string> lru_;  // Most recently used first
+    uint64_t bytes_;
+};
+
+#endif // PIECE_CACHE_H
@@ -0,0 +1,409 @@
+#include "server/reactor.h"
+
+#ifdef __linux__
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <ctime>
+
+// epoll user data for the two non-connection descriptors of every I/O thread
+constexpr uint64_t LISTENER_ID = 0;
+constexpr uint64_t WAKE_ID = 1;
+
+constexpr int MAX_EVENTS = 256;
+constexpr size_t RECV_BUFFER_SIZE = 64 * 1024;
+
+bool IoBackend::deliver(MessageDecoder& decoder, ClientSession& session, std::string& outbox,
+                        const char* data, size_t size) {
+    decoder.feed(data, size);
+
+    char type;
+    std::string message;
+    try {
+        while (session.wantsInput() && decoder.next(type, message)) {
+            if (!session.onMessage(type, message)) {
+                return false;
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error handling client: " << e.what() << std::endl;
+        outbox += encodeMessage(MSG_ERROR, "Server error: " + std::string(e.what()));
+        return false;
+    }
+    return true;
+}
+
+void IoBackend::fillOutbox(ClientSession& session, std::string& outbox) {
+    // Bounded so a huge result is encoded only as fast as the client reads it
+    while (session.hasPendingOutput() && outbox.size() < 4 * RESULT_FRAME_SIZE) {
+        session.produceOutput();
+    }
+}
+
+void IoBackend::addThreadStats(const ThreadStats& stats) {
+    timespec cpu{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    totals_.syscalls += stats.syscalls;
+    totals_.bytesReceived += stats.bytesReceived;
+    totals_.bytesSent += stats.bytesSent;
+    cpuSeconds_ += cpu.tv_sec + cpu.tv_nsec / 1e9;
+}
+
+void IoBackend::reportStats() const {
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    double receivedMB = totals_.bytesReceived / (1024.0 * 1024.0);
+    double receivedGB = receivedMB / 1024.0;
+
+    std::cout << "I/O backend " << name() << ": " << totals_.syscalls << " syscalls, "
+              << static_cast<uint64_t>(receivedMB) << " MB received, "
+              << totals_.bytesSent << " bytes sent";
+    if (totals_.bytesReceived > 0) {
+        std::cout << ", " << totals_.syscalls / receivedMB << " syscalls/MB, "
+                  << cpuSeconds_ / receivedGB << " s CPU/GB";
+    }
+    std::cout << " (" << cpuSeconds_ << " s I/O thread CPU)" << std::endl;
+}
+
+EpollReactor::EpollReactor(ServerContext& context, unsigned int numThreads)
+    : IoBackend(context), numThreads_(numThreads == 0 ? 1 : numThreads),
+      listenSocket_(INVALID_SOCKET_VALUE), running_(false), nextId_(WAKE_ID + 1) {
+}
+
+EpollReactor::~EpollReactor() {
+    stop();
+}
+
+bool EpollReactor::start(socket_t listenSocket) {
+    listenSocket_ = listenSocket;
+
+    // accept() must not block once the listener is shared by several epoll sets
+    int flags = fcntl(listenSocket_, F_GETFL, 0);
+    if (flags < 0 || fcntl(listenSocket_, F_SETFL, flags | O_NONBLOCK) < 0) {
+        std::cerr << "Error making listen socket non-blocking: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    for (unsigned int i = 0; i < numThreads_; ++i) {
+        auto io = std::make_unique<IoThread>();
+        io->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        io->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (io->epollFd < 0 || io->wakeFd < 0) {
+            std::cerr << "Error creating epoll instance: " << strerror(errno) << std::endl;
+            return false;
+        }
+
+        // EPOLLEXCLUSIVE wakes only one I/O thread per incoming connection
+        epoll_event listenEvent{};
+        listenEvent.events = EPOLLIN | EPOLLEXCLUSIVE;
+        listenEvent.data.u64 = LISTENER_ID;
+        epoll_event wakeEvent{};
+        wakeEvent.events = EPOLLIN;
+        wakeEvent.data.u64 = WAKE_ID;
+        if (epoll_ctl(io->epollFd, EPOLL_CTL_ADD, listenSocket_, &listenEvent) < 0 ||
+            epoll_ctl(io->epollFd, EPOLL_CTL_ADD, io->wakeFd, &wakeEvent) < 0) {
+            std::cerr << "Error registering with epoll: " << strerror(errno) << std::endl;
+            return false;
+        }
+        threads_.push_back(std::move(io));
+    }
+
+    running_ = true;
+    for (auto& io : threads_) {
+        IoThread* ioPtr = io.get();
+        io->thread = std::thread([this, ioPtr]() { run(*ioPtr); });
+    }
+
+    std::cout << "Event loop started with " << numThreads_ << " I/O thread(s)" << std::endl;
+    return true;
+}
+
+void EpollReactor::stop() {
+    if (threads_.empty()) {
+        return;
+    }
+    running_ = false;
+
+    for (auto& io : threads_) {
+        uint64_t one = 1;
+        if (write(io->wakeFd, &one, sizeof(one)) < 0) {
+            // Counter overflow only; the thread is awake either way
+        }
+    }
+
+    for (auto& io : threads_) {
+        if (io->thread.joinable()) {
+            io->thread.join();
+        }
+        close(io->epollFd);
+        close(io->wakeFd);
+    }
+    threads_.clear();
+    reportStats();
+}
+
+void EpollReactor::run(IoThread& io) {
+    epoll_event events[MAX_EVENTS];
+    bool listening = true;
+
+    while (true) {
+        int n = epoll_wait(io.epollFd, events, MAX_EVENTS, -1);
+        io.stats.syscalls++;
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Error waiting for events: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            uint64_t id = events[i].data.u64;
+            if (id == LISTENER_ID) {
+                if (running_) {
+                    acceptConnections(io);
+                }
+                continue;
+            }
+            if (id == WAKE_ID) {
+                uint64_t value;
+                while (read(io.wakeFd, &value, sizeof(value)) > 0) {
+                    io.stats.syscalls++;
+                }
+                io.stats.syscalls++;
+                runPosted(io);
+                continue;
+            }
+
+            auto it = io.connections.find(id);
+            if (it == io.connections.end()) {
+                continue;
+            }
+            Connection& conn = *it->second;
+            if (!conn.closed && (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+                handleReadable(io, conn);
+            }
+            if (!conn.closed && conn.readPaused && (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+                // Not reading, so this is the only sign that the client went away
+                closeSocket(io, conn);
+            }
+            updateConnection(io, conn);
+        }
+
+        if (!running_) {
+            // Shutting down: stop accepting and abort every session, but keep
+            // running until analysis still in flight has drained
+            if (listening) {
+                epoll_ctl(io.epollFd, EPOLL_CTL_DEL, listenSocket_, nullptr);
+                listening = false;
+            }
+
+            std::vector<Connection*> open;
+            for (auto& pair : io.connections) {
+                open.push_back(pair.second.get());
+            }
+            for (Connection* conn : open) {
+                closeSocket(io, *conn);
+                updateConnection(io, *conn);
+            }
+            if (io.connections.empty()) {
+                break;
+            }
+        }
+    }
+
+    addThreadStats(io.stats);
+}
+
+void EpollReactor::acceptConnections(IoThread& io) {
+    while (true) {
+        struct sockaddr_in clientAddr;
+        socklen_t clientAddrLen = sizeof(clientAddr);
+
+        int fd = accept4(listenSocket_, (struct sockaddr *)&clientAddr, &clientAddrLen,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        io.stats.syscalls++;
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                std::cerr << "Error accepting connection: " << strerror(errno) << std::endl;
+            }
+            return;
+        }
+
+        // Get client information
+        char clientIP[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &clientAddr.sin_addr, clientIP, INET_ADDRSTRLEN);
+        std::cout << "New connection from " << clientIP << ":" << ntohs(clientAddr.sin_port) << std::endl;
+
+        auto conn = std::make_unique<Connection>();
+        conn->id = nextId_++;
+        conn->fd = fd;
+        Connection* connPtr = conn.get();
+        uint64_t id = conn->id;
+
+        conn->session = std::make_unique<ClientSession>(
+            context_, clientIP, "temp_" + std::to_string(id),
+            [connPtr](char type, const std::string& message) {
+                connPtr->outbox += encodeMessage(type, message);
+            },
+            [this, &io, id](std::function<void()> fn) {
+                post(io, [this, &io, id, fn]() {
+                    auto it = io.connections.find(id);
+                    if (it == io.connections.end()) {
+                        return;
+                    }
+                    fn();
+                    updateConnection(io, *it->second);
+                });
+            });
+
+        // Edge-triggered: every readiness change is reported once, so reads
+        // and writes always run until EAGAIN
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.u64 = id;
+        io.stats.syscalls++;
+        if (epoll_ctl(io.epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            std::cerr << "Error registering connection: " << strerror(errno) << std::endl;
+            close(fd);
+            continue;
+        }
+        io.connections.emplace(id, std::move(conn));
+    }
+}
+
+void EpollReactor::handleReadable(IoThread& io, Connection& conn) {
+    char buffer[RECV_BUFFER_SIZE];
+
+    // Messages left in the decoder when the session last paused
+    if (conn.decoder.bufferedBytes() > 0 && !deliver(conn.decoder, *conn.session, conn.outbox, "", 0)) {
+        flush(io, conn);
+        closeSocket(io, conn);
+        return;
+    }
+
+    while (!conn.closed) {
+        // Leave data in the socket buffer so TCP flow control pushes back on
+        // the client; updateConnection resumes once the session is ready
+        if (!conn.session->wantsInput()) {
+            conn.readPaused = true;
+            return;
+        }
+
+        ssize_t received = recv(conn.fd, buffer, sizeof(buffer), 0);
+        io.stats.syscalls++;
+        if (received > 0) {
+            io.stats.bytesReceived += static_cast<uint64_t>(received);
+            if (!deliver(conn.decoder, *conn.session, conn.outbox, buffer, static_cast<size_t>(received))) {
+                flush(io, conn);
+                closeSocket(io, conn);
+                return;
+            }
+            continue;
+        }
+
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+
+        // Orderly shutdown or connection error
+        closeSocket(io, conn);
+        return;
+    }
+}
+
+void EpollReactor::flush(IoThread& io, Connection& conn) {
+    while (!conn.closed && conn.outboxOffset < conn.outbox.size()) {
+        ssize_t sent = send(conn.fd, conn.outbox.data() + conn.outboxOffset,
+                            conn.outbox.size() - conn.outboxOffset, MSG_NOSIGNAL);
+        io.stats.syscalls++;
+        if (sent > 0) {
+            conn.outboxOffset += static_cast<size_t>(sent);
+            io.stats.bytesSent += static_cast<uint64_t>(sent);
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        // EAGAIN: EPOLLOUT fires when there is room again; errors surface on the next read
+        return;
+    }
+
+    if (conn.outboxOffset == conn.outbox.size()) {
+        conn.outbox.clear();
+        conn.outboxOffset = 0;
+    }
+}
+
+void EpollReactor::updateConnection(IoThread& io, Connection& conn) {
+    // Edge-triggered: data that arrived while paused is not reported again
+    if (!conn.closed && conn.readPaused && conn.session->wantsInput()) {
+        conn.readPaused = false;
+        handleReadable(io, conn);
+    }
+
+    if (!conn.closed) {
+        flush(io, conn);
+        // More result frames once the socket has taken the previous ones
+        while (!conn.closed && conn.outbox.empty() && conn.session->hasPendingOutput()) {
+            fillOutbox(*conn.session, conn.outbox);
+            flush(io, conn);
+        }
+        if (conn.session->isFinished() && conn.outbox.empty()) {
+            closeSocket(io, conn);
+        }
+    }
+
+    // Analysis jobs reference the session, so it lives until they drain
+    if (conn.closed && !conn.session->isAnalyzing()) {
+        io.connections.erase(conn.id);
+    }
+}
+
+void EpollReactor::closeSocket(IoThread& io, Connection& conn) {
+    if (conn.closed) {
+        return;
+    }
+    epoll_ctl(io.epollFd, EPOLL_CTL_DEL, conn.fd, nullptr);
+    close(conn.fd);
+    io.stats.syscalls += 2;
+    conn.closed = true;
+    conn.session->abort();
+    std::cout << "Client disconnected" << std::endl;
+}
+
+void EpollReactor::post(IoThread& io, std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lock(io.postedMutex);
+        io.posted.push_back(std::move(fn));
+    }
+    uint64_t one = 1;
+    if (write(io.wakeFd, &one, sizeof(one)) < 0) {
+        // Counter overflow only; a wakeup is already pending
+    }
+}
+
+void EpollReactor::runPosted(IoThread& io) {
+    std::vector<std::function<void()>> posted;
+    {
+        std::lock_guard<std::mutex> lock(io.postedMutex);
+        posted.swap(io.posted);
+    }
+    for (auto& fn : posted) {
+        fn();
+    }
+}
+
+#endif // __linux__
@@ -0,0 +1,125 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#ifdef __linux__
+
+#include "common/protocol.h"
+#include "server/client_session.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
+
+// Common interface of the event-driven I/O backends. A fixed number of I/O
+// threads drive non-blocking sockets through per-connection ClientSession
+// state machines; CPU-heavy parsing runs on the shared worker pool, so the
+// thread count does not grow with connections.
+class IoBackend {
+public:
+    explicit IoBackend(ServerContext& context) : context_(context) {}
+    virtual ~IoBackend() = default;
+
+    // Start the I/O threads on an already listening socket
+    virtual bool start(socket_t listenSocket) = 0;
+
+    // Stop accepting, abort open sessions and join the I/O threads
+    virtual void stop() = 0;
+
+    virtual const char* name() const = 0;
+
+protected:
+    // Counters kept by each I/O thread and folded in when it exits
+    struct ThreadStats {
+        uint64_t syscalls = 0;
+        uint64_t bytesReceived = 0;
+        uint64_t bytesSent = 0;
+    };
+
+    // Decode received bytes and hand complete messages to the session while it
+    // wants input (the rest stay buffered in the decoder); false if the
+    // connection should be closed (protocol or framing error)
+    static bool deliver(MessageDecoder& decoder, ClientSession& session, std::string& outbox,
+                        const char* data, size_t size);
+
+    // Top up an outbox with streamed result frames, a few at a time
+    static void fillOutbox(ClientSession& session, std::string& outbox);
+
+    // Called at the end of each I/O thread
+    void addThreadStats(const ThreadStats& stats);
+
+    // Print syscall and CPU cost of the I/O threads, normalized per byte received
+    void reportStats() const;
+
+    ServerContext& context_;
+
+private:
+    mutable std::mutex statsMutex_;
+    ThreadStats totals_;
+    double cpuSeconds_ = 0;
+};
+
+// Edge-triggered epoll backend: each I/O thread has its own epoll set and
+// the listener is shared between them with EPOLLEXCLUSIVE
+class EpollReactor : public IoBackend {
+public:
+    EpollReactor(ServerContext& context, unsigned int numThreads);
+    ~EpollReactor() override;
+
+    bool start(socket_t listenSocket) override;
+    void stop() override;
+    const char* name() const override { return "epoll"; }
+
+private:
+    struct Connection {
+        uint64_t id;
+        socket_t fd;
+        MessageDecoder decoder;
+        std::unique_ptr<ClientSession> session;
+        std::string outbox;       // Encoded messages not yet written
+        size_t outboxOffset = 0;
+        bool closed = false;      // Socket closed; kept until analysis drains
+        bool readPaused = false;  // Stopped reading for backpressure; data may be waiting
+    };
+
+    struct IoThread {
+        int epollFd = -1;
+        int wakeFd = -1;          // eventfd signalled when closures are posted
+        std::thread thread;
+        std::mutex postedMutex;
+        std::vector<std::function<void()>> posted;
+        std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections;
+        ThreadStats stats;
+    };
+
+    // Event loop of one I/O thread
+    void run(IoThread& io);
+
+    void acceptConnections(IoThread& io);
+    void handleReadable(IoThread& io, Connection& conn);
+    void flush(IoThread& io, Connection& conn);
+
+    // Close the socket if the session is done or broken, and drop the
+    // connection once no analysis is outstanding for it
+    void updateConnection(IoThread& io, Connection& conn);
+    void closeSocket(IoThread& io, Connection& conn);
+
+    // Queue a closure for an I/O thread (callable from any thread)
+    void post(IoThread& io, std::function<void()> fn);
+    void runPosted(IoThread& io);
+
+    unsigned int numThreads_;
+    socket_t listenSocket_;
+    std::vector<std::unique_ptr<IoThread>> threads_;
+    std::atomic<bool> running_;
+    std::atomic<uint64_t> nextId_;
+};
+
+#endif // __linux__
+
+#endif // REACTOR_H
@@ -0,0 +1,125 @@
+#include "server/result_cache.h"
+#include "common/content_hash.h"
+#include "common/filter.h"
+#include "common/metrics.h"
+#include "common/segment_store.h"
+#include <filesystem>
+#include <algorithm>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Bookkeeping per cached entry and per counted key, on top of the strings
+constexpr uint64_t ENTRY_OVERHEAD = 128;
+constexpr uint64_t COUNT_OVERHEAD = 64;
+
+ResultCache::ResultCache(uint64_t capacityBytes) : capacity_(capacityBytes), bytes_(0) {
+}
+
+std::shared_ptr<const AnalysisResult> ResultCache::find(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = entries_.find(key);
+    if (found == entries_.end()) {
+        Metrics::add(MetricCounter::RESULT_CACHE_MISSES, 1);
+        return nullptr;
+    }
+    Metrics::add(MetricCounter::RESULT_CACHE_HITS, 1);
+    lru_.splice(lru_.begin(), lru_, found->second.position);
+    return found->second.result;
+}
+
+void ResultCache::insert(const std::string& key, AnalysisResult result) {
+    uint64_t bytes = ENTRY_OVERHEAD + 2 * key.size();
+    for (const auto& pair : result.counts) {
+        bytes += COUNT_OVERHEAD + pair.first.size();
+    }
+    if (bytes > capacity_) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = entries_.find(key);
+    if (found != entries_.end()) {
+        bytes_ -= found->second.bytes;
+        lru_.erase(found->second.position);
+        entries_.erase(found);
+    }
+    lru_.push_front(key);
+    Entry& entry = entries_[key];
+    entry.result = std::make_shared<const AnalysisResult>(std::move(result));
+    entry.bytes = bytes;
+    entry.position = lru_.begin();
+    bytes_ += bytes;
+    evict();
+}
+
+void ResultCache::evict() {
+    while (bytes_ > capacity_ && !lru_.empty()) {
+        auto found = entries_.find(lru_.back());
+        bytes_ -= found->second.bytes;
+        entries_.erase(found);
+        lru_.pop_back();
+    }
+}
+
+size_t ResultCache::entryCount() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+uint64_t ResultCache::sizeBytes() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+}
+
+// Length-prefixed, so that no field value can run into the next
+static void appendField(std::string& key, const std::string& value) {
+    key += std::to_string(value.size());
+    key += ':';
+    key += value;
+}
+
+std::string ResultCache::requestKey(const AnalysisRequest& request) {
+    std::string key;
+    appendField(key, analysisTypeToString(request.type));
+    appendField(key, request.startDate ? "+" + *request.startDate : "-");
+    appendField(key, request.endDate ? "+" + *request.endDate : "-");
+
+    std::string filter = request.filter;
+    if (!filter.empty()) {
+        std::string error;
+        auto program = FilterProgram::compile(request.filter, error);
+        if (program) {
+            filter = program->describe();
+        }
+    }
+    appendField(key, filter);
+
+    if (request.type == AnalysisType::PATTERN) {
+        std::vector<std::string> patterns;
+        for (const auto& pattern : request.patterns) {
+            if (!pattern.empty()) {
+                patterns.push_back(pattern);
+            }
+        }
+        std::sort(patterns.begin(), patterns.end());
+        patterns.erase(std::unique(patterns.begin(), patterns.end()), patterns.end());
+        appendField(key, std::to_string(static_cast<int>(request.patternGroup)));
+        for (const auto& pattern : patterns) {
+            appendField(key, pattern);
+        }
+    }
+    return ContentHasher::hash(key);
+}
+
+std::string ResultCache::datasetFingerprint(const std::string& datasetDir) {
+    std::string identity = fs::absolute(datasetDir).lexically_normal().string();
+    for (const auto& segment : listSegments(datasetDir)) {
+        std::error_code error;
+        uint64_t size = fs::file_size(segment, error);
+        auto modified = fs::last_write_time(segment, error).time_since_epoch().count();
+        identity += "\n" + fs::path(segment).filename().string() + " " + std::to_string(size) + " " +
+                    std::to_string(modified);
+    }
+    return ContentHasher::hash(identity);
+}
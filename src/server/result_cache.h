@@ -0,0 +1,63 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include "common/protocol.h"
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+// Results of earlier requests, by the content they were computed over and
+// the request (normalized), so that a dashboard repeating a query gets its
+// answer without the data being read again.
+//
+// Keys are "<fingerprint>/<request key>". The fingerprint names data whose
+// content cannot change under it: a --dedup piece (its content hash), or a
+// stored dataset's segment files. Pieces are cached one by one, so a request
+// over more files than an earlier one still reuses the pieces they share.
+// Entries are evicted least recently used first once their estimated size
+// is over the capacity.
+class ResultCache {
+public:
+    explicit ResultCache(uint64_t capacityBytes);
+
+    // Cached result, null on a miss (counted in the metrics either way)
+    std::shared_ptr<const AnalysisResult> find(const std::string& key);
+
+    // Add or replace a result, then evict down to the capacity
+    void insert(const std::string& key, AnalysisResult result);
+
+    size_t entryCount();
+    uint64_t sizeBytes();
+
+    // Hash of what decides a request's result: analysis type, date range,
+    // filter (compiled, so spelling does not matter) and, for PATTERN, the
+    // distinct patterns and grouping. Progress, tracing and where the data
+    // comes from are left out.
+    static std::string requestKey(const AnalysisRequest& request);
+
+    // Fingerprint of a stored dataset: its segment files' names, sizes and
+    // modification times, which change whenever it is stored again
+    static std::string datasetFingerprint(const std::string& datasetDir);
+
+private:
+    struct Entry {
+        std::shared_ptr<const AnalysisResult> result;
+        uint64_t bytes = 0;
+        std::list<std::string>::iterator position;  // In lru_
+    };
+
+    // Drop the least recently used entries until under capacity (mutex_ held)
+    void evict();
+
+    uint64_t capacity_;
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<std::string> lru_;  // Most recently used first
+    uint64_t bytes_;
+};
+
+#endif // RESULT_CACHE_H
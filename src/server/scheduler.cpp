@@ -0,0 +1,99 @@
+#include "server/scheduler.h"
+#include <iostream>
+#include <algorithm>
+
+RequestScheduler::RequestScheduler(ThreadPool& workers, const SchedulerOptions& options)
+    : options_(options), nextId_(1), memoryUsed_(0) {
+    if (options_.maxActiveRequests == 0) {
+        options_.maxActiveRequests = 1;
+    }
+    for (const auto& pair : options_.clientWeights) {
+        workers.setQueueWeight(queueFor(pair.first), pair.second);
+    }
+}
+
+uint64_t RequestScheduler::nextRequestId() {
+    return nextId_++;
+}
+
+ThreadPool::QueueId RequestScheduler::queueFor(const std::string& client) const {
+    // Queue 0 is the pool's default; keep clients out of it
+    ThreadPool::QueueId queue = std::hash<std::string>()(client);
+    return queue == 0 ? 1 : queue;
+}
+
+RequestScheduler::Admission RequestScheduler::admit(uint64_t requestId, std::function<void()> admitted) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (waiting_.empty() && active_.size() < options_.maxActiveRequests &&
+        memoryUsed_ < options_.memoryBudget) {
+        active_.insert(requestId);
+        return Admission::ADMITTED;
+    }
+    if (waiting_.size() >= options_.maxQueuedRequests) {
+        return Admission::REJECTED;
+    }
+
+    waiting_.emplace_back(requestId, std::move(admitted));
+    std::cout << "Request queued for admission (" << waiting_.size() << " waiting, "
+              << active_.size() << " active)" << std::endl;
+    return Admission::QUEUED;
+}
+
+void RequestScheduler::release(uint64_t requestId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    memoryWaiters_.erase(requestId);
+    if (active_.erase(requestId) == 0) {
+        for (auto it = waiting_.begin(); it != waiting_.end(); ++it) {
+            if (it->first == requestId) {
+                waiting_.erase(it);
+                break;
+            }
+        }
+    }
+    schedule();
+}
+
+RequestScheduler::Usage RequestScheduler::usage() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return Usage{active_.size(), waiting_.size(), memoryUsed_};
+}
+
+bool RequestScheduler::reserve(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    memoryUsed_ += bytes;
+    return memoryUsed_ <= options_.memoryBudget;
+}
+
+void RequestScheduler::unreserve(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    memoryUsed_ -= std::min(bytes, memoryUsed_);
+    schedule();
+}
+
+bool RequestScheduler::waitForMemory(uint64_t requestId, std::function<void()> resume) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (memoryUsed_ < options_.memoryBudget) {
+        return false;
+    }
+    memoryWaiters_[requestId] = std::move(resume);
+    return true;
+}
+
+void RequestScheduler::schedule() {
+    if (memoryUsed_ >= options_.memoryBudget) {
+        return;
+    }
+
+    // Requests already receiving go first: they hold memory that they free by finishing
+    for (auto& pair : memoryWaiters_) {
+        pair.second();
+    }
+    memoryWaiters_.clear();
+
+    while (!waiting_.empty() && active_.size() < options_.maxActiveRequests) {
+        auto next = std::move(waiting_.front());
+        waiting_.pop_front();
+        active_.insert(next.first);
+        next.second();
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "common/thread_pool.h"
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+struct SchedulerOptions {
+    size_t maxActiveRequests = 64;     // Requests receiving or analyzing at once
+    size_t maxQueuedRequests = 256;    // Requests waiting for admission; more are rejected
+    size_t memoryBudget = 2048ull * 1024 * 1024;  // Received data buffered across all requests
+    std::unordered_map<std::string, double> clientWeights;  // Share of worker time (default 1)
+};
+
+// Sits between the client sessions and the worker pool. Requests are
+// admitted while there is a free slot and memory headroom, otherwise they
+// wait in a bounded FIFO (their sockets are not read meanwhile). Every
+// buffered byte is reserved against a server-wide budget; a session that
+// cannot reserve stops reading until memory is released. Analysis jobs go
+// to one pool queue per client, so worker time is shared fairly by weight.
+//
+// Callbacks passed in are invoked under the scheduler's lock, so they must
+// only post work elsewhere; once release() returns none will run again.
+class RequestScheduler {
+public:
+    enum class Admission {
+        ADMITTED,
+        QUEUED,    // admitted is called once a slot frees up
+        REJECTED   // Admission queue is full
+    };
+
+    RequestScheduler(ThreadPool& workers, const SchedulerOptions& options);
+
+    uint64_t nextRequestId();
+
+    // Worker pool queue for a client's analysis jobs
+    ThreadPool::QueueId queueFor(const std::string& client) const;
+
+    Admission admit(uint64_t requestId, std::function<void()> admitted);
+
+    // The request finished or was abandoned: frees its slot or queue entry,
+    // drops any memory wait and admits the next request
+    void release(uint64_t requestId);
+
+    // Account bytes against the budget; false once it is exceeded
+    bool reserve(size_t bytes);
+    void unreserve(size_t bytes);
+
+    // Call resume once usage drops below the budget. Returns false (and never
+    // calls resume) if there is already room.
+    bool waitForMemory(uint64_t requestId, std::function<void()> resume);
+
+    // Current load, for stats
+    struct Usage {
+        size_t activeRequests;
+        size_t queuedRequests;
+        size_t memoryUsed;
+    };
+    Usage usage();
+
+private:
+    // Wake memory waiters and admit queued requests while there is room
+    void schedule();
+
+    SchedulerOptions options_;
+    std::atomic<uint64_t> nextId_;
+
+    std::mutex mutex_;
+    std::unordered_set<uint64_t> active_;
+    std::deque<std::pair<uint64_t, std::function<void()>>> waiting_;
+    std::unordered_map<uint64_t, std::function<void()>> memoryWaiters_;
+    size_t memoryUsed_;
+};
+
+#endif // SCHEDULER_H
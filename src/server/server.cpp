@@ -1,9 +1,10 @@
 #include "server/server.h"
-#include "server/analyzer.h"
+#include "server/uring_reactor.h"
 #include <iostream>
 #include <fstream>
 #include <cstring>
 #include <filesystem>
+#include <algorithm>
 
 #ifdef _WIN32
 #include <direct.h>
@@ -12,8 +13,42 @@
 
 namespace fs = std::filesystem;
 
-LogServer::LogServer(int port)
-    : port_(port), serverSocket_(INVALID_SOCKET_VALUE), running_(false) {
+// In coordinator mode pool threads mostly wait on worker nodes, so keep
+// enough of them to have every node busy with more than one shard
+static unsigned int poolSize(const ServerOptions& options) {
+    if (options.workerThreads != 0 || options.workerNodes.empty()) {
+        return options.workerThreads;
+    }
+    unsigned int hardware = std::thread::hardware_concurrency();
+    return std::max(hardware, static_cast<unsigned int>(2 * options.workerNodes.size()));
+}
+
+LogServer::LogServer(const ServerOptions& options)
+    : options_(options), port_(options.port), serverSocket_(INVALID_SOCKET_VALUE), running_(false),
+      workers_(poolSize(options), options.pinWorkers), scheduler_(workers_, options.scheduler),
+      coordinator_(options.workerNodes.empty() ? nullptr : std::make_unique<ShardCoordinator>(options.workerNodes)),
+      pieces_(options.storeDir.empty() ? nullptr
+                                       : std::make_unique<PieceCache>(options.storeDir, options.pieceCacheBytes)),
+      // Only data with a fingerprint (pieces, datasets) is cached, so only with the store
+      results_(pieces_ && options.resultCacheBytes > 0 ? std::make_unique<ResultCache>(options.resultCacheBytes)
+                                                       : nullptr),
+      sessions_(options.sessionMemoryBytes, std::chrono::seconds(options.sessionIdleSeconds)),
+      context_{workers_, scheduler_, options.memoryLimit, coordinator_.get(), window_, options.traceDir,
+               options.storeDir, pieces_.get(), results_.get(), sessions_} {
+    if (coordinator_) {
+        std::cout << "Coordinator mode: sharding analysis across " << coordinator_->nodeCount()
+                  << " worker node(s)" << std::endl;
+    }
+    if (!options.storeDir.empty()) {
+        std::cout << "Dataset store: " << options.storeDir << " (piece cache: " << pieces_->pieceCount()
+                  << " pieces, " << pieces_->sizeBytes() / (1024 * 1024) << " of "
+                  << options.pieceCacheBytes / (1024 * 1024) << " MB, result cache: "
+                  << options.resultCacheBytes / (1024 * 1024) << " MB)" << std::endl;
+    }
+    if (options.pinWorkers) {
+        std::cout << "Pinned " << workers_.size() << " worker thread(s) across " << workers_.nodeCount()
+                  << " NUMA node(s)" << std::endl;
+    }
 }
 
 LogServer::~LogServer() {
@@ -79,7 +114,7 @@ bool LogServer::start() {
     }
     
     // Listen for connections
-    if (listen(serverSocket_, 5) < 0) {
+    if (listen(serverSocket_, SOMAXCONN) < 0) {
 #ifdef _WIN32
         std::cerr << "Error listening on socket: " << WSAGetLastError() << std::endl;
         closesocket(serverSocket_);
@@ -91,7 +126,51 @@ bool LogServer::start() {
         return false;
     }
     
-    // Start server thread
+    // Metrics are gathered from the per-thread counters on each scrape
+    if (options_.metricsPort != 0) {
+        metrics_ = std::make_unique<MetricsEndpoint>(
+            options_.metricsPort, [this]() { return formatPrometheus(serverGauges(context_)); });
+        if (!metrics_->start()) {
+            metrics_.reset();
+            close_socket(serverSocket_);
+            serverSocket_ = INVALID_SOCKET_VALUE;
+#ifdef _WIN32
+            cleanupWinsock();
+#endif
+            return false;
+        }
+    }
+    
+#ifdef __linux__
+    // Event-driven connection handling
+    if (options_.ioMode == IoMode::IO_URING) {
+#ifdef LOG_ANALYZER_HAVE_IO_URING
+        reactor_ = std::make_unique<UringReactor>(context_, options_.ioThreads);
+        if (!reactor_->start(serverSocket_)) {
+            reactor_.reset();
+        }
+#endif
+        if (!reactor_) {
+            std::cout << "io_uring is not available, falling back to epoll" << std::endl;
+        }
+    }
+    if (options_.ioMode != IoMode::THREADS) {
+        if (!reactor_) {
+            reactor_ = std::make_unique<EpollReactor>(context_, options_.ioThreads);
+            if (!reactor_->start(serverSocket_)) {
+                reactor_.reset();
+                close(serverSocket_);
+                serverSocket_ = INVALID_SOCKET_VALUE;
+                return false;
+            }
+        }
+        running_ = true;
+        std::cout << "Server started on port " << port_ << std::endl;
+        return true;
+    }
+#endif
+    
+    // Start server thread (one thread per client connection)
     running_ = true;
     serverThreadHandle_ = std::thread(&LogServer::serverThread, this);
     
@@ -107,11 +186,21 @@ void LogServer::stop() {
     // Set running flag to false
     running_ = false;
     
+#ifdef __linux__
+    // Abort open sessions and join the I/O threads
+    if (reactor_) {
+        reactor_->stop();
+        reactor_.reset();
+    }
+#endif
+    
     // Close server socket to interrupt accept()
     if (serverSocket_ != INVALID_SOCKET_VALUE) {
 #ifdef _WIN32
         closesocket(serverSocket_);
 #else
+        // close() alone does not wake a thread blocked in accept() on Linux
+        shutdown(serverSocket_, SHUT_RDWR);
         close(serverSocket_);
 #endif
         serverSocket_ = INVALID_SOCKET_VALUE;
@@ -122,6 +211,11 @@ void LogServer::stop() {
         serverThreadHandle_.join();
     }
     
+    if (metrics_) {
+        metrics_->stop();
+        metrics_.reset();
+    }
+    
     // Wait for client threads to finish
     {
         std::lock_guard<std::mutex> lock(clientThreadsMutex_);
@@ -172,31 +266,89 @@ void LogServer::serverThread() {
         // Create a new thread to handle client
         {
             std::lock_guard<std::mutex> lock(clientThreadsMutex_);
-            clientThreads_.emplace_back(&LogServer::clientHandler, this, clientSocket);
+            clientThreads_.emplace_back(&LogServer::clientHandler, this, clientSocket, std::string(clientIP));
         }
     }
     
     std::cout << "Server thread finished" << std::endl;
 }
 
-void LogServer::clientHandler(socket_t clientSocket) {
-    // Create a temporary directory for this client
+void LogServer::clientHandler(socket_t clientSocket, std::string clientIP) {
+    // Completions posted by the worker pool, run on this thread
+    std::mutex postedMutex;
+    std::condition_variable postedCondition;
+    std::vector<std::function<void()>> posted;
+    
+    // Temporary directory for this client (only created if data spills to disk)
     std::string tempDir = std::string("temp_") + std::to_string(clientSocket);
-    fs::create_directory(tempDir);
+    
+    ClientSession session(
+        context_, clientIP, tempDir,
+        [clientSocket](char type, const std::string& message) {
+            sendMessage(clientSocket, type, message);
+        },
+        [&](std::function<void()> fn) {
+            std::lock_guard<std::mutex> lock(postedMutex);
+            posted.push_back(std::move(fn));
+            postedCondition.notify_one();
+        });
+    
+    // Run what the analyzer or the scheduler posted, optionally blocking
+    // until something arrives
+    auto runPosted = [&](bool wait) {
+        std::vector<std::function<void()>> ready;
+        {
+            std::unique_lock<std::mutex> lock(postedMutex);
+            if (wait) {
+                postedCondition.wait(lock, [&]() { return !posted.empty(); });
+            }
+            ready.swap(posted);
+        }
+        for (auto& fn : ready) {
+            fn();
+        }
+    };
     
     try {
         char type;
         std::string message;
         
-        // Receive request
-        if (receiveMessage(clientSocket, type, message) && type == MSG_REQUEST) {
-            AnalysisRequest request = deserializeRequest(message);
+        while (true) {
+            // Progress reports and completions posted meanwhile
+            runPosted(false);
+            if (session.isFinished()) {
+                break;
+            }
             
-            // Handle the request
-            handleRequest(clientSocket, request);
-        }
-        else {
-            std::cerr << "Invalid initial message from client" << std::endl;
+            // Result frames go out one blocking send at a time
+            if (session.hasPendingOutput()) {
+                session.produceOutput();
+                continue;
+            }
+            
+            // Not reading while the session waits applies TCP backpressure
+            if (!session.wantsInput()) {
+                runPosted(true);
+                continue;
+            }
+            
+            // While analyzing only a cancel can arrive, and an idle session
+            // times out through a post, so poll rather than block in recv
+            // and keep running what the pool and timers post
+            if ((session.isAnalyzing() || session.isIdle()) && !socketReadable(clientSocket, 50)) {
+                continue;
+            }
+            
+            if (!receiveMessage(clientSocket, type, message)) {
+                // A session ends with the client disconnecting between requests
+                if (!session.isIdle()) {
+                    std::cerr << "Error receiving message from client" << std::endl;
+                }
+                break;
+            }
+            if (!session.onMessage(type, message)) {
+                break;
+            }
         }
     }
     catch (const std::exception& e) {
@@ -204,12 +356,10 @@ void LogServer::clientHandler(socket_t clientSocket) {
         sendMessage(clientSocket, MSG_ERROR, "Server error: " + std::string(e.what()));
     }
     
-    // Clean up temporary directory
-    try {
-        fs::remove_all(tempDir);
-    }
-    catch (const std::exception& e) {
-        std::cerr << "Error cleaning up temp directory: " << e.what() << std::endl;
+    // Let analysis still in flight drain before the session goes away
+    session.abort();
+    while (session.isAnalyzing()) {
+        runPosted(true);
     }
     
     // Close client socket
@@ -220,109 +370,3 @@ void LogServer::clientHandler(socket_t clientSocket) {
 #endif
     std::cout << "Client disconnected" << std::endl;
 }
-
-bool LogServer::handleRequest(socket_t clientSocket, const AnalysisRequest& request) {
-    std::cout << "Received analysis request: " << analysisTypeToString(request.type) << std::endl;
-    
-    // Create temporary directory for this request
-    std::string tempDir = std::string("temp_") + std::to_string(clientSocket);
-    if (!fs::exists(tempDir)) {
-        fs::create_directory(tempDir);
-    }
-    
-    // Handle file transfer
-    if (!handleFileTransfer(clientSocket, tempDir)) {
-        return false;
-    }
-    
-    // Process log files
-    std::cout << "Processing log files..." << std::endl;
-    AnalysisResult result = processLogFiles(request, tempDir);
-    
-    // Send result back to client
-    std::string resultStr = serializeResult(result);
-    if (!sendMessage(clientSocket, MSG_RESULT, resultStr)) {
-        std::cerr << "Failed to send result to client" << std::endl;
-        return false;
-    }
-    
-    std::cout << "Analysis completed and sent to client" << std::endl;
-    return true;
-}
-
-bool LogServer::handleFileTransfer(socket_t clientSocket, const std::string& tempDir) {
-    char type;
-    std::string message;
-    int fileCount = 0;
-    
-    // Receive files until MSG_FILE_END
-    while (true) {
-        if (!receiveMessage(clientSocket, type, message)) {
-            std::cerr << "Error receiving message from client" << std::endl;
-            return false;
-        }
-        
-        if (type == MSG_FILE_END) {
-            break; // End of file transfer
-        }
-        else if (type == MSG_FILE_START) {
-            // Start of a new file
-            std::string fileName = message;
-            std::cout << "Receiving file: " << fileName << std::endl;
-            
-            // Create file path
-            std::string filePath = tempDir + "/" + fileName;
-            
-            // Open file for writing
-            std::ofstream file(filePath, std::ios::binary);
-            if (!file) {
-                std::cerr << "Error creating file: " << filePath << std::endl;
-                sendMessage(clientSocket, MSG_ERROR, "Error creating file");
-                return false;
-            }
-            
-            // Receive file chunks
-            while (true) {
-                if (!receiveMessage(clientSocket, type, message)) {
-                    std::cerr << "Error receiving file chunk" << std::endl;
-                    return false;
-                }
-                
-                if (type == MSG_FILE_CHUNK) {
-                    // Write chunk to file
-                    file.write(message.data(), message.size());
-                }
-                else if (type == MSG_FILE_END) {
-                    // End of this file
-                    file.close();
-                    fileCount++;
-                    sendMessage(clientSocket, MSG_ACK, "File received");
-                    break;
-                }
-                else {
-                    std::cerr << "Unexpected message type during file transfer: " << type << std::endl;
-                    return false;
-                }
-            }
-        }
-        else {
-            std::cerr << "Unexpected message type: " << type << std::endl;
-            return false;
-        }
-    }
-    
-    std::cout << "Received " << fileCount << " files" << std::endl;
-    return true;
-}
-
-AnalysisResult LogServer::processLogFiles(const AnalysisRequest& request, const std::string& tempDir) {
-    // Get list of all files in temporary directory
-    std::vector<std::string> logFiles;
-    for (const auto& entry : fs::directory_iterator(tempDir)) {
-        logFiles.push_back(entry.path().string());
-    }
-    
-    // Create analyzer and process files
-    LogAnalyzer analyzer(request);
-    return analyzer.analyze(logFiles);
-}
\ No newline at end of file
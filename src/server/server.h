@@ -2,6 +2,12 @@
 #define SERVER_H
 
 #include "common/protocol.h"
+#include "common/thread_pool.h"
+#include "server/client_session.h"
+#include "server/scheduler.h"
+#include "server/coordinator.h"
+#include "server/reactor.h"
+#include "server/metrics_endpoint.h"
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -9,10 +15,54 @@
 #include <mutex>
 #include <atomic>
 #include <condition_variable>
+#include <memory>
+
+// Received data kept in memory per request before files start spilling to disk
+constexpr size_t DEFAULT_INGEST_MEMORY_LIMIT = 512ull * 1024 * 1024;
+
+// Disk space for deduplicated upload pieces (see piece_cache.h)
+constexpr uint64_t DEFAULT_PIECE_CACHE_BYTES = 1024ull * 1024 * 1024;
+
+// Memory for cached results of piece and dataset queries (see result_cache.h)
+constexpr uint64_t DEFAULT_RESULT_CACHE_BYTES = 256ull * 1024 * 1024;
+
+// Entries kept by all multi-query sessions, and how long one may wait for
+// its next request (see session_manager.h)
+constexpr uint64_t DEFAULT_SESSION_MEMORY_BYTES = 2048ull * 1024 * 1024;
+constexpr int DEFAULT_SESSION_IDLE_SECONDS = 300;
+
+// How client connections are driven
+enum class IoMode {
+    THREADS,  // One blocking thread per connection (portable)
+    EPOLL,    // Event loop on a fixed number of I/O threads (Linux)
+    IO_URING  // Like EPOLL, but batched through io_uring; falls back to EPOLL
+};
+
+struct ServerOptions {
+    int port = DEFAULT_PORT;
+    size_t memoryLimit = DEFAULT_INGEST_MEMORY_LIMIT;
+#ifdef __linux__
+    IoMode ioMode = IoMode::EPOLL;
+#else
+    IoMode ioMode = IoMode::THREADS;
+#endif
+    unsigned int ioThreads = 1;
+    unsigned int workerThreads = 0;  // 0 = hardware concurrency (at least 2 per worker node)
+    bool pinWorkers = false;         // Bind workers to CPUs spread over the NUMA nodes
+    SchedulerOptions scheduler;
+    std::vector<WorkerNode> workerNodes;  // Non-empty: coordinator mode
+    int metricsPort = 0;                  // HTTP port for Prometheus scrapes, 0 = off
+    std::string traceDir = "traces";      // Trace JSON of requests that ask for tracing
+    std::string storeDir;                 // Stored datasets (see segment_store.h), empty = off
+    uint64_t pieceCacheBytes = DEFAULT_PIECE_CACHE_BYTES;  // Parsed upload pieces kept in the store
+    uint64_t resultCacheBytes = DEFAULT_RESULT_CACHE_BYTES;  // 0 = no result cache
+    uint64_t sessionMemoryBytes = DEFAULT_SESSION_MEMORY_BYTES;
+    int sessionIdleSeconds = DEFAULT_SESSION_IDLE_SECONDS;
+};
 
 class LogServer {
 public:
-    LogServer(int port = DEFAULT_PORT);
+    LogServer(const ServerOptions& options = ServerOptions());
     ~LogServer();
     
     // Start the server
@@ -25,28 +75,46 @@ public:
     bool isRunning() const;
     
 private:
-    // Main server thread function
+    // Main server thread function (thread-per-client mode)
     void serverThread();
     
-    // Client handler thread function
-    void clientHandler(socket_t clientSocket);
-    
-    // Handle client request
-    bool handleRequest(socket_t clientSocket, const AnalysisRequest& request);
-    
-    // Handle file transfer
-    bool handleFileTransfer(socket_t clientSocket, const std::string& tempDir);
-    
-    // Process received log files
-    AnalysisResult processLogFiles(const AnalysisRequest& request, const std::string& tempDir);
+    // Client handler thread function: drives a ClientSession with blocking I/O
+    void clientHandler(socket_t clientSocket, std::string clientIP);
     
     // Server state
+    ServerOptions options_;
     int port_;
     socket_t serverSocket_;
     std::atomic<bool> running_;
     std::thread serverThreadHandle_;
     
-    // Active client connections
+    // Worker pool shared by every request's analysis, and the scheduler
+    // that admits requests and shares the pool between clients
+    ThreadPool workers_;
+    RequestScheduler scheduler_;
+    
+    // Coordinator mode: shards are analyzed on worker nodes
+    std::unique_ptr<ShardCoordinator> coordinator_;
+    
+    // Last 5/15/60 minutes of everything parsed on this server
+    SlidingWindow window_;
+    // Parsed upload pieces, with the dataset store
+    std::unique_ptr<PieceCache> pieces_;
+    // Results over pieces and datasets
+    std::unique_ptr<ResultCache> results_;
+    // Memory cap and idle timeout of multi-query sessions
+    SessionManager sessions_;
+    ServerContext context_;
+    
+    // Prometheus scrape endpoint (ServerOptions::metricsPort)
+    std::unique_ptr<MetricsEndpoint> metrics_;
+    
+#ifdef __linux__
+    // Event loop (IoMode::EPOLL / IoMode::IO_URING)
+    std::unique_ptr<IoBackend> reactor_;
+#endif
+    
+    // Active client connections (IoMode::THREADS)
     std::vector<std::thread> clientThreads_;
     std::mutex clientThreadsMutex_;
 };
@@ -0,0 +1,71 @@
+#include "server/session_manager.h"
+#include <algorithm>
+
+SessionManager::SessionManager(uint64_t memoryCap, std::chrono::seconds idleTimeout)
+    : memoryCap_(memoryCap), idleTimeout_(idleTimeout), usedBytes_(0), nextId_(1), stopping_(false) {
+    thread_ = std::thread([this]() { timerThread(); });
+}
+
+SessionManager::~SessionManager() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+bool SessionManager::reserve(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (usedBytes_ + bytes > memoryCap_) {
+        return false;
+    }
+    usedBytes_ += bytes;
+    return true;
+}
+
+void SessionManager::release(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    usedBytes_ -= std::min(bytes, usedBytes_);
+}
+
+uint64_t SessionManager::arm(std::function<void()> expired) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t id = nextId_++;
+    timers_.emplace(id, Timer{Clock::now() + idleTimeout_, std::move(expired)});
+    wake_.notify_all();
+    return id;
+}
+
+void SessionManager::disarm(uint64_t id) {
+    // Callbacks run with mutex_ held, so none is running once it is taken
+    std::lock_guard<std::mutex> lock(mutex_);
+    timers_.erase(id);
+}
+
+SessionManager::Usage SessionManager::usage() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return {usedBytes_, timers_.size()};
+}
+
+void SessionManager::timerThread() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        if (timers_.empty()) {
+            wake_.wait(lock);
+            continue;
+        }
+        // Timers are armed in id order with the same timeout: the first one expires first
+        auto first = timers_.begin();
+        if (Clock::now() < first->second.deadline) {
+            wake_.wait_until(lock, first->second.deadline);
+            continue;
+        }
+        std::function<void()> expired = std::move(first->second.expired);
+        timers_.erase(first);
+        // Only posts to the session's thread, so holding the lock is cheap
+        expired();
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef SESSION_MANAGER_H
+#define SESSION_MANAGER_H
+
+#include <map>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+
+// Kept entries and idle connections of multi-query sessions (see
+// AnalysisRequest::session): the tables of all sessions share one memory
+// cap, and a session waiting for its next request is ended once it has been
+// idle for the timeout. Timeouts fire on a timer thread of their own.
+class SessionManager {
+public:
+    SessionManager(uint64_t memoryCap, std::chrono::seconds idleTimeout);
+    ~SessionManager();
+
+    SessionManager(const SessionManager&) = delete;
+    SessionManager& operator=(const SessionManager&) = delete;
+
+    // Account for bytes more of session tables; false (and nothing
+    // reserved) if that would go over the cap
+    bool reserve(uint64_t bytes);
+    void release(uint64_t bytes);
+
+    // Call expired on the timer thread once the idle timeout has passed,
+    // unless disarmed first; returns the timer's id (never 0)
+    uint64_t arm(std::function<void()> expired);
+
+    // Cancel a timer; once this returns its callback is not running and
+    // will not run
+    void disarm(uint64_t id);
+
+    uint64_t memoryCap() const {
+        return memoryCap_;
+    }
+    std::chrono::seconds idleTimeout() const {
+        return idleTimeout_;
+    }
+
+    struct Usage {
+        uint64_t bytes;       // Held by session tables
+        size_t idleSessions;  // Waiting for their next request
+    };
+    Usage usage();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Timer {
+        Clock::time_point deadline;
+        std::function<void()> expired;
+    };
+
+    void timerThread();
+
+    uint64_t memoryCap_;
+    std::chrono::seconds idleTimeout_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    uint64_t usedBytes_;
+    std::map<uint64_t, Timer> timers_;  // By id, so by deadline too: the timeout is the same for all
+    uint64_t nextId_;
+    bool stopping_;
+    std::thread thread_;
+};
+
+#endif // SESSION_MANAGER_H
@@ -0,0 +1,228 @@
+#include "server/sliding_window.h"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <map>
+#include <cstdio>
+#include <cctype>
+
+// Entries up to this many minutes ahead of the clock (skewed clocks) count
+// in the current minute; later ones are skipped
+constexpr int64_t MAX_FUTURE_MINUTES = 5;
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+static int64_t daysFromCivil(int64_t year, int64_t month, int64_t day) {
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yearOfEra = year - era * 400;
+    int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+static void civilFromDays(int64_t days, int& year, int& month, int& day) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t dayOfEra = days - era * 146097;
+    int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int64_t mp = (5 * dayOfYear + 2) / 153;
+    day = static_cast<int>(dayOfYear - (153 * mp + 2) / 5 + 1);
+    month = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+    year = static_cast<int>(yearOfEra + era * 400 + (month <= 2));
+}
+
+// Minutes since the epoch for "YYYY-MM-DD HH:MM[:SS...]" (any separators)
+static bool parseMinute(std::string_view timestamp, int64_t& minute) {
+    int64_t fields[5];
+    int count = 0;
+    size_t i = 0;
+    while (count < 5 && i < timestamp.size()) {
+        if (!std::isdigit(static_cast<unsigned char>(timestamp[i]))) {
+            ++i;
+            continue;
+        }
+        int64_t value = 0;
+        while (i < timestamp.size() && std::isdigit(static_cast<unsigned char>(timestamp[i]))) {
+            value = value * 10 + (timestamp[i] - '0');
+            ++i;
+        }
+        fields[count++] = value;
+    }
+    if (count < 5 || fields[1] < 1 || fields[1] > 12 || fields[2] < 1 || fields[2] > 31 ||
+        fields[3] > 23 || fields[4] > 59) {
+        return false;
+    }
+    minute = daysFromCivil(fields[0], fields[1], fields[2]) * 1440 + fields[3] * 60 + fields[4];
+    return true;
+}
+
+// The wall clock's current minute, on the same local-time scale as parseMinute
+static int64_t currentMinute() {
+    std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::tm local{};
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    return daysFromCivil(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday) * 1440 + local.tm_hour * 60 +
+           local.tm_min;
+}
+
+static size_t slotOf(int64_t minute) {
+    int64_t slot = minute % SlidingWindow::BUCKET_COUNT;
+    return static_cast<size_t>(slot < 0 ? slot + SlidingWindow::BUCKET_COUNT : slot);
+}
+
+SlidingWindow::SlidingWindow() : ring_(BUCKET_COUNT), head_(-1) {
+    for (int minutes : windowMinutes()) {
+        Window window;
+        window.minutes = minutes;
+        windows_.push_back(std::move(window));
+    }
+}
+
+const std::vector<int>& SlidingWindow::windowMinutes() {
+    static const std::vector<int> minutes = {5, 15, BUCKET_COUNT};
+    return minutes;
+}
+
+void SlidingWindow::add(const std::pmr::vector<LogEntry>& entries) {
+    // The batch is counted per minute and key without the lock, so the lock
+    // is held per distinct key rather than per entry
+    int64_t now = currentMinute();
+    std::map<int64_t, BatchBucket> batch;
+    std::string key;
+    for (const auto& entry : entries) {
+        int64_t minute;
+        if (!parseMinute(entry.timestamp, minute) || minute > now + MAX_FUTURE_MINUTES ||
+            minute <= now - BUCKET_COUNT) {
+            continue;
+        }
+        BatchBucket& counted = batch[std::min(minute, now)];
+        const std::pmr::string* fields[KEY_TYPES] = {&entry.user, &entry.ip, &entry.level};
+        for (int type = 0; type < KEY_TYPES; ++type) {
+            key.assign(*fields[type]);
+            counted.counts[type][key]++;
+        }
+        counted.entries++;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (now > head_) {
+        advanceTo(now);
+    }
+    for (const auto& pair : batch) {
+        // Another batch may have advanced the clock past some of these minutes
+        int64_t minute = pair.first;
+        if (minute <= head_ - BUCKET_COUNT) {
+            continue;
+        }
+
+        // Slots are reused lazily: a stale bucket has already left every window
+        Bucket& bucket = ring_[slotOf(minute)];
+        if (bucket.minute != minute) {
+            for (auto& counts : bucket.counts) {
+                counts.clear();
+            }
+            bucket.entries = 0;
+            bucket.minute = minute;
+        }
+        for (int type = 0; type < KEY_TYPES; ++type) {
+            for (const auto& count : pair.second.counts[type]) {
+                bucket.counts[type][count.first] += count.second;
+            }
+        }
+        bucket.entries += pair.second.entries;
+
+        for (auto& window : windows_) {
+            if (minute > head_ - window.minutes) {
+                for (int type = 0; type < KEY_TYPES; ++type) {
+                    for (const auto& count : pair.second.counts[type]) {
+                        window.counts[type][count.first] += count.second;
+                    }
+                }
+                window.entries += pair.second.entries;
+            }
+        }
+    }
+}
+
+void SlidingWindow::advanceTo(int64_t minute) {
+    if (head_ < 0 || minute - head_ >= BUCKET_COUNT) {
+        // Every bucket is out of every window
+        for (auto& window : windows_) {
+            for (auto& counts : window.counts) {
+                counts.clear();
+            }
+            window.entries = 0;
+        }
+        head_ = minute;
+        return;
+    }
+
+    // One minute at a time: the bucket (m - length) leaves each window
+    for (int64_t m = head_ + 1; m <= minute; ++m) {
+        for (auto& window : windows_) {
+            const Bucket& leaving = ring_[slotOf(m - window.minutes)];
+            if (leaving.minute == m - window.minutes) {
+                subtract(window, leaving);
+            }
+        }
+    }
+    head_ = minute;
+}
+
+void SlidingWindow::subtract(Window& window, const Bucket& bucket) {
+    for (int type = 0; type < KEY_TYPES; ++type) {
+        Counts& counts = window.counts[type];
+        for (const auto& pair : bucket.counts[type]) {
+            auto it = counts.find(pair.first);
+            if (it == counts.end()) {
+                continue;
+            }
+            if (it->second <= pair.second) {
+                counts.erase(it);
+            }
+            else {
+                it->second -= pair.second;
+            }
+        }
+    }
+    window.entries -= std::min(window.entries, bucket.entries);
+}
+
+bool SlidingWindow::query(AnalysisType type, int minutes, AnalysisResult& result) {
+    if (static_cast<int>(type) >= KEY_TYPES) {
+        return false;  // Only user, IP and level are kept
+    }
+    // The windows slide with the clock even when nothing is being added
+    int64_t now = currentMinute();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (now > head_) {
+        advanceTo(now);
+    }
+    for (const auto& window : windows_) {
+        if (window.minutes == minutes) {
+            result.type = type;
+            result.counts = window.counts[static_cast<int>(type)];
+            result.totalEntries = window.entries;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string SlidingWindow::windowEnd() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (head_ < 0) {
+        return "";
+    }
+    int year, month, day;
+    civilFromDays(head_ / 1440, year, month, day);
+    char text[32];
+    std::snprintf(text, sizeof(text), "%04d-%02d-%02d %02d:%02d", year, month, day,
+                  static_cast<int>((head_ % 1440) / 60), static_cast<int>(head_ % 60));
+    return text;
+}
@@ -0,0 +1,79 @@
+#ifndef SLIDING_WINDOW_H
+#define SLIDING_WINDOW_H
+
+#include "common/protocol.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+
+// Counts per user, IP and level over the last 5, 15 and 60 minutes, fed
+// with the entries of live (follow mode) uploads. Entries are placed by
+// their own timestamps, read as local time, but the windows end at the
+// current minute of the wall clock: old archives cannot rewind them, and
+// a timestamp in the future cannot push them ahead.
+//
+// Entries go into a ring of one-minute buckets. Each window also keeps a
+// running sum of the buckets it covers, so a query copies one table and
+// never scans buckets. When the current minute advances, the bucket that
+// leaves a window is subtracted from that window's sum, and the ring slot
+// is reused once the bucket has left the longest window.
+class SlidingWindow {
+public:
+    static constexpr int BUCKET_COUNT = 60;  // One-minute buckets: the longest window
+
+    SlidingWindow();
+
+    // Window lengths that can be queried, in minutes
+    static const std::vector<int>& windowMinutes();
+
+    // Count parsed entries (called from the worker pool). A batch is counted
+    // per minute and key first, and only the totals are merged under the
+    // lock. Entries older than the longest window, more than a few minutes
+    // ahead of the clock, or without a readable timestamp are skipped;
+    // entries slightly ahead count in the current minute.
+    void add(const std::pmr::vector<LogEntry>& entries);
+
+    // Counts over the last minutes (one of windowMinutes()); false if that
+    // window is not maintained. result.totalEntries is the window's entry count.
+    bool query(AnalysisType type, int minutes, AnalysisResult& result);
+
+    // End of the windows, the current minute as of the last add or query,
+    // as "YYYY-MM-DD HH:MM" (empty before either)
+    std::string windowEnd();
+
+private:
+    static constexpr int KEY_TYPES = 3;  // USER, IP, LOG_LEVEL
+    using Counts = std::unordered_map<std::string, uint64_t>;
+
+    struct Bucket {
+        int64_t minute = -1;         // Minutes since the epoch, -1 when unused
+        Counts counts[KEY_TYPES];
+        uint64_t entries = 0;
+    };
+
+    struct Window {
+        int minutes;
+        Counts counts[KEY_TYPES];    // Sum of the buckets in (head - minutes, head]
+        uint64_t entries = 0;
+    };
+
+    // Counts of one batch for one minute, before they are merged
+    struct BatchBucket {
+        Counts counts[KEY_TYPES];
+        uint64_t entries = 0;
+    };
+
+    // Move the current minute forward, expiring buckets that leave each window
+    void advanceTo(int64_t minute);
+
+    static void subtract(Window& window, const Bucket& bucket);
+
+    std::mutex mutex_;
+    std::vector<Bucket> ring_;
+    std::vector<Window> windows_;
+    int64_t head_;                   // Current minute, -1 before any add or query
+};
+
+#endif // SLIDING_WINDOW_H
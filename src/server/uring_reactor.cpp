@@ -0,0 +1,755 @@
+#include "server/uring_reactor.h"
+
+#if defined(__linux__) && defined(LOG_ANALYZER_HAVE_IO_URING)
+
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <cerrno>
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <poll.h>
+
+// Submission queue depth and the (larger) completion queue behind it
+constexpr unsigned int RING_ENTRIES = 1024;
+constexpr unsigned int CQ_ENTRIES = 8192;
+
+// Provided receive buffers shared by all connections of one ring
+constexpr unsigned int RECV_BUFFER_COUNT = 256;
+constexpr size_t RECV_BUFFER_SIZE = 64 * 1024;
+constexpr uint16_t RECV_BUFFER_GROUP = 0;
+
+// Slots in the registered file table (one per open connection)
+constexpr unsigned int FIXED_FILE_SLOTS = 16384;
+
+// user_data layout: connection id in the high bits, operation in the low byte
+enum UringOp : uint64_t {
+    OP_ACCEPT = 1,
+    OP_WAKE,
+    OP_RECV,
+    OP_SEND,
+    OP_POLL,
+    OP_SHUTDOWN,
+    OP_CLOSE,
+    OP_CANCEL
+};
+
+static uint64_t makeUserData(uint64_t id, UringOp op) {
+    return (id << 8) | op;
+}
+
+static int uringSetup(unsigned int entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int uringEnter(int fd, unsigned int toSubmit, unsigned int minComplete, unsigned int flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+static int uringRegister(int fd, unsigned int opcode, void* arg, unsigned int nrArgs) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs));
+}
+
+// One io_uring instance with its mapped queues and provided buffers
+struct UringReactor::Ring {
+    int fd = -1;
+    io_uring_params params{};
+
+    void* sqMap = MAP_FAILED;
+    size_t sqMapSize = 0;
+    void* cqMap = MAP_FAILED;
+    size_t cqMapSize = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesSize = 0;
+
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned sqMask = 0;
+    unsigned localTail = 0;       // SQEs prepared
+    unsigned submitted = 0;       // SQEs handed to the kernel
+
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    unsigned cqMask = 0;
+
+    // Provided buffer ring and the buffers it hands out
+    io_uring_buf* bufRing = static_cast<io_uring_buf*>(MAP_FAILED);
+    size_t bufRingSize = 0;
+    char* buffers = static_cast<char*>(MAP_FAILED);
+    uint16_t bufTail = 0;
+
+    ~Ring();
+
+    bool init();
+    bool registerBuffers();
+    bool registerFiles();
+
+    // Next free SQE, submitting what is queued if the ring is full
+    io_uring_sqe* getSqe(uint64_t& syscalls);
+
+    // Submit everything prepared and wait for at least one completion
+    int submitAndWait(uint64_t& syscalls);
+
+    // Give a receive buffer back to the kernel
+    void recycleBuffer(uint16_t bufferId);
+};
+
+UringReactor::Ring::~Ring() {
+    if (buffers != MAP_FAILED) {
+        munmap(buffers, RECV_BUFFER_COUNT * RECV_BUFFER_SIZE);
+    }
+    if (bufRing != MAP_FAILED) {
+        munmap(bufRing, bufRingSize);
+    }
+    if (sqes != MAP_FAILED) {
+        munmap(sqes, sqesSize);
+    }
+    if (cqMap != MAP_FAILED && cqMap != sqMap) {
+        munmap(cqMap, cqMapSize);
+    }
+    if (sqMap != MAP_FAILED) {
+        munmap(sqMap, sqMapSize);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool UringReactor::Ring::init() {
+    // Keep submitting past a failed SQE and skip the IPI on completions;
+    // older kernels reject these flags, so retry with the bare minimum
+    params = io_uring_params{};
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    params.cq_entries = CQ_ENTRIES;
+    fd = uringSetup(RING_ENTRIES, &params);
+    if (fd < 0 && errno == EINVAL) {
+        params = io_uring_params{};
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = CQ_ENTRIES;
+        fd = uringSetup(RING_ENTRIES, &params);
+    }
+    if (fd < 0) {
+        std::cerr << "Error creating io_uring: " << strerror(errno) << std::endl;
+        return false;
+    }
+    if (!(params.features & IORING_FEAT_NODROP)) {
+        std::cerr << "io_uring: kernel may drop completions" << std::endl;
+        return false;
+    }
+
+    sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        sqMapSize = cqMapSize = std::max(sqMapSize, cqMapSize);
+    }
+
+    sqMap = mmap(nullptr, sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sqMap == MAP_FAILED) {
+        std::cerr << "Error mapping io_uring: " << strerror(errno) << std::endl;
+        return false;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        cqMap = sqMap;
+    }
+    else {
+        cqMap = mmap(nullptr, cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cqMap == MAP_FAILED) {
+            std::cerr << "Error mapping io_uring: " << strerror(errno) << std::endl;
+            return false;
+        }
+    }
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqesMap = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqesMap == MAP_FAILED) {
+        std::cerr << "Error mapping io_uring: " << strerror(errno) << std::endl;
+        return false;
+    }
+    sqes = static_cast<io_uring_sqe*>(sqesMap);
+
+    char* sq = static_cast<char*>(sqMap);
+    sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    localTail = submitted = *sqTail;
+
+    char* cq = static_cast<char*>(cqMap);
+    cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+
+    return registerBuffers() && registerFiles();
+}
+
+bool UringReactor::Ring::registerBuffers() {
+    bufRingSize = RECV_BUFFER_COUNT * sizeof(io_uring_buf);
+    void* ringMem = mmap(nullptr, bufRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    void* bufferMem = mmap(nullptr, RECV_BUFFER_COUNT * RECV_BUFFER_SIZE, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ringMem == MAP_FAILED || bufferMem == MAP_FAILED) {
+        std::cerr << "Error allocating receive buffers: " << strerror(errno) << std::endl;
+        if (ringMem != MAP_FAILED) {
+            munmap(ringMem, bufRingSize);
+        }
+        if (bufferMem != MAP_FAILED) {
+            munmap(bufferMem, RECV_BUFFER_COUNT * RECV_BUFFER_SIZE);
+        }
+        return false;
+    }
+    bufRing = static_cast<io_uring_buf*>(ringMem);
+    buffers = static_cast<char*>(bufferMem);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(bufRing);
+    reg.ring_entries = RECV_BUFFER_COUNT;
+    reg.bgid = RECV_BUFFER_GROUP;
+    if (uringRegister(fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        std::cerr << "Error registering io_uring buffer ring: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    for (uint16_t i = 0; i < RECV_BUFFER_COUNT; ++i) {
+        recycleBuffer(i);
+    }
+    return true;
+}
+
+bool UringReactor::Ring::registerFiles() {
+    // Empty table; accepted sockets are installed directly into free slots
+    io_uring_rsrc_register reg{};
+    reg.nr = FIXED_FILE_SLOTS;
+    reg.flags = IORING_RSRC_REGISTER_SPARSE;
+    if (uringRegister(fd, IORING_REGISTER_FILES2, &reg, sizeof(reg)) < 0) {
+        std::cerr << "Error registering io_uring file table: " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+io_uring_sqe* UringReactor::Ring::getSqe(uint64_t& syscalls) {
+    while (localTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= params.sq_entries) {
+        // Full: push the batch to the kernel without waiting
+        __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+        int ret = uringEnter(fd, localTail - submitted, 0, 0);
+        syscalls++;
+        if (ret > 0) {
+            submitted += static_cast<unsigned>(ret);
+        }
+        else if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            std::cerr << "Error submitting to io_uring: " << strerror(errno) << std::endl;
+            return nullptr;
+        }
+    }
+
+    unsigned index = localTail & sqMask;
+    io_uring_sqe* sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqArray[index] = index;
+    localTail++;
+    return sqe;
+}
+
+int UringReactor::Ring::submitAndWait(uint64_t& syscalls) {
+    __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+    int ret = uringEnter(fd, localTail - submitted, 1, IORING_ENTER_GETEVENTS);
+    syscalls++;
+    if (ret > 0) {
+        submitted += static_cast<unsigned>(ret);
+    }
+    return ret;
+}
+
+void UringReactor::Ring::recycleBuffer(uint16_t bufferId) {
+    io_uring_buf& buf = bufRing[bufTail & (RECV_BUFFER_COUNT - 1)];
+    buf.addr = reinterpret_cast<uint64_t>(buffers + bufferId * RECV_BUFFER_SIZE);
+    buf.len = RECV_BUFFER_SIZE;
+    buf.bid = bufferId;
+    bufTail++;
+
+    // The ring tail overlays the reserved field of the first entry
+    __atomic_store_n(&bufRing[0].resv, bufTail, __ATOMIC_RELEASE);
+}
+
+struct UringReactor::Connection {
+    uint64_t id;
+    unsigned int slot;            // Index in the registered file table
+    MessageDecoder decoder;
+    std::unique_ptr<ClientSession> session;
+    std::string outbox;           // Encoded messages not yet submitted
+    std::string sending;          // Buffer of the send in flight
+    size_t sendingOffset = 0;
+    bool recvPending = false;
+    bool sendPending = false;
+    bool pollPending = false;     // Watching for hangup while not reading
+    bool closed = false;          // Shutdown/close submitted
+    bool closeDone = false;       // Slot released by the kernel
+};
+
+struct UringReactor::IoThread {
+    Ring ring;
+    int wakeFd = -1;              // eventfd signalled when closures are posted
+    uint64_t wakeValue = 0;
+    bool accepting = false;       // Multishot accept armed
+    bool cancelling = false;
+    std::thread thread;
+    std::mutex postedMutex;
+    std::vector<std::function<void()>> posted;
+    std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections;
+    ThreadStats stats;
+
+    ~IoThread() {
+        if (wakeFd >= 0) {
+            close(wakeFd);
+        }
+    }
+};
+
+UringReactor::UringReactor(ServerContext& context, unsigned int numThreads)
+    : IoBackend(context), numThreads_(numThreads == 0 ? 1 : numThreads),
+      listenSocket_(INVALID_SOCKET_VALUE), running_(false), nextId_(1) {
+}
+
+UringReactor::~UringReactor() {
+    stop();
+}
+
+bool UringReactor::start(socket_t listenSocket) {
+    listenSocket_ = listenSocket;
+
+    // Set up every ring before starting any thread, so a kernel without the
+    // needed features leaves nothing behind for the fallback
+    std::vector<std::unique_ptr<IoThread>> threads;
+    for (unsigned int i = 0; i < numThreads_; ++i) {
+        auto io = std::make_unique<IoThread>();
+        if (!io->ring.init()) {
+            return false;
+        }
+        io->wakeFd = eventfd(0, EFD_CLOEXEC);
+        if (io->wakeFd < 0) {
+            std::cerr << "Error creating eventfd: " << strerror(errno) << std::endl;
+            return false;
+        }
+        threads.push_back(std::move(io));
+    }
+    threads_ = std::move(threads);
+
+    running_ = true;
+    for (auto& io : threads_) {
+        IoThread* ioPtr = io.get();
+        io->thread = std::thread([this, ioPtr]() { run(*ioPtr); });
+    }
+
+    std::cout << "io_uring event loop started with " << numThreads_ << " I/O thread(s)" << std::endl;
+    return true;
+}
+
+void UringReactor::stop() {
+    if (threads_.empty()) {
+        return;
+    }
+    running_ = false;
+
+    for (auto& io : threads_) {
+        uint64_t one = 1;
+        if (write(io->wakeFd, &one, sizeof(one)) < 0) {
+            // Counter overflow only; the thread is awake either way
+        }
+    }
+
+    for (auto& io : threads_) {
+        if (io->thread.joinable()) {
+            io->thread.join();
+        }
+    }
+    threads_.clear();
+    reportStats();
+}
+
+void UringReactor::run(IoThread& io) {
+    armAccept(io);
+    armWake(io);
+
+    std::vector<io_uring_cqe> completions;
+    while (true) {
+        int ret = io.ring.submitAndWait(io.stats.syscalls);
+        if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            std::cerr << "Error waiting for io_uring completions: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        // Copy the completions out first: handlers queue new SQEs as they go
+        completions.clear();
+        unsigned head = *io.ring.cqHead;
+        unsigned tail = __atomic_load_n(io.ring.cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            completions.push_back(io.ring.cqes[head & io.ring.cqMask]);
+        }
+        __atomic_store_n(io.ring.cqHead, head, __ATOMIC_RELEASE);
+
+        for (const io_uring_cqe& cqe : completions) {
+            uint64_t id = cqe.user_data >> 8;
+            UringOp op = static_cast<UringOp>(cqe.user_data & 0xff);
+
+            if (op == OP_ACCEPT) {
+                onAccept(io, cqe.res, cqe.flags);
+                continue;
+            }
+            if (op == OP_WAKE) {
+                runPosted(io);
+                armWake(io);
+                continue;
+            }
+            if (op == OP_CANCEL) {
+                continue;
+            }
+
+            auto it = io.connections.find(id);
+            if (it == io.connections.end()) {
+                if (cqe.flags & IORING_CQE_F_BUFFER) {
+                    io.ring.recycleBuffer(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+                }
+                continue;
+            }
+            Connection& conn = *it->second;
+            if (op == OP_RECV) {
+                onRecv(io, conn, cqe.res, cqe.flags);
+            }
+            else if (op == OP_SEND) {
+                onSend(io, conn, cqe.res);
+            }
+            else if (op == OP_POLL) {
+                onPoll(io, conn, cqe.res);
+            }
+            else if (op == OP_CLOSE) {
+                conn.closeDone = true;
+            }
+            updateConnection(io, conn);
+        }
+
+        if (!running_) {
+            // Shutting down: stop accepting and abort every session, but keep
+            // running until analysis and I/O still in flight have drained
+            if (io.accepting && !io.cancelling) {
+                io_uring_sqe* sqe = io.ring.getSqe(io.stats.syscalls);
+                if (sqe) {
+                    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                    sqe->fd = -1;
+                    sqe->addr = makeUserData(0, OP_ACCEPT);
+                    sqe->user_data = makeUserData(0, OP_CANCEL);
+                    io.cancelling = true;
+                }
+            }
+
+            std::vector<Connection*> open;
+            for (auto& pair : io.connections) {
+                open.push_back(pair.second.get());
+            }
+            for (Connection* conn : open) {
+                closeSocket(io, *conn);
+                updateConnection(io, *conn);
+            }
+            if (io.connections.empty() && !io.accepting) {
+                break;
+            }
+        }
+    }
+
+    addThreadStats(io.stats);
+}
+
+void UringReactor::onAccept(IoThread& io, int result, uint32_t flags) {
+    if (!(flags & IORING_CQE_F_MORE)) {
+        io.accepting = false;
+        // EINVAL: the kernel cannot do multishot direct accept; retrying would spin
+        if (running_ && result != -EINVAL) {
+            armAccept(io);
+        }
+    }
+
+    if (result < 0) {
+        if (result != -ECANCELED) {
+            std::cerr << "Error accepting connection: " << strerror(-result) << std::endl;
+        }
+        return;
+    }
+
+    // Direct accept: the result is a slot in the registered file table
+    std::cout << "New connection (io_uring file slot " << result << ")" << std::endl;
+
+    auto conn = std::make_unique<Connection>();
+    conn->id = nextId_++;
+    conn->slot = static_cast<unsigned int>(result);
+    Connection* connPtr = conn.get();
+    uint64_t id = conn->id;
+
+    // The peer address is not available for direct descriptors, so each
+    // connection counts as its own client for fair sharing
+    conn->session = std::make_unique<ClientSession>(
+        context_, "connection " + std::to_string(id), "temp_" + std::to_string(id),
+        [connPtr](char type, const std::string& message) {
+            connPtr->outbox += encodeMessage(type, message);
+        },
+        [this, &io, id](std::function<void()> fn) {
+            post(io, [this, &io, id, fn]() {
+                auto it = io.connections.find(id);
+                if (it == io.connections.end()) {
+                    return;
+                }
+                fn();
+                updateConnection(io, *it->second);
+            });
+        });
+
+    io.connections.emplace(id, std::move(conn));
+    armRecv(io, *connPtr);
+}
+
+void UringReactor::onRecv(IoThread& io, Connection& conn, int result, uint32_t flags) {
+    conn.recvPending = false;
+
+    if (result > 0 && (flags & IORING_CQE_F_BUFFER)) {
+        uint16_t bufferId = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+        bool ok = true;
+        if (!conn.closed) {
+            io.stats.bytesReceived += static_cast<uint64_t>(result);
+            ok = deliver(conn.decoder, *conn.session, conn.outbox,
+                         io.ring.buffers + bufferId * RECV_BUFFER_SIZE, static_cast<size_t>(result));
+        }
+        io.ring.recycleBuffer(bufferId);
+
+        if (!ok) {
+            // Let the error reply go out ahead of the shutdown
+            flush(io, conn);
+            closeSocket(io, conn);
+        }
+        else {
+            armRecv(io, conn);
+        }
+        return;
+    }
+
+    if (result == -ENOBUFS || result == -EINTR || result == -EAGAIN) {
+        // Every provided buffer is in use until this batch is processed
+        armRecv(io, conn);
+        return;
+    }
+
+    // Orderly shutdown or connection error
+    closeSocket(io, conn);
+}
+
+void UringReactor::onSend(IoThread& io, Connection& conn, int result) {
+    conn.sendPending = false;
+    if (result < 0) {
+        if (result == -EINTR || result == -EAGAIN) {
+            flush(io, conn);
+            return;
+        }
+        closeSocket(io, conn);
+        return;
+    }
+
+    io.stats.bytesSent += static_cast<uint64_t>(result);
+    conn.sendingOffset += static_cast<size_t>(result);
+    if (conn.sendingOffset == conn.sending.size()) {
+        conn.sending.clear();
+        conn.sendingOffset = 0;
+    }
+    flush(io, conn);
+}
+
+void UringReactor::onPoll(IoThread& io, Connection& conn, int result) {
+    conn.pollPending = false;
+    if (result > 0 && (result & (POLLRDHUP | POLLHUP | POLLERR))) {
+        closeSocket(io, conn);
+    }
+}
+
+void UringReactor::armAccept(IoThread& io) {
+    io_uring_sqe* sqe = io.ring.getSqe(io.stats.syscalls);
+    if (!sqe) {
+        return;
+    }
+    // One SQE keeps accepting until cancelled, installing each socket
+    // straight into a free fixed-file slot
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenSocket_;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->file_index = IORING_FILE_INDEX_ALLOC;
+    sqe->user_data = makeUserData(0, OP_ACCEPT);
+    io.accepting = true;
+}
+
+void UringReactor::armWake(IoThread& io) {
+    io_uring_sqe* sqe = io.ring.getSqe(io.stats.syscalls);
+    if (!sqe) {
+        return;
+    }
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = io.wakeFd;
+    sqe->addr = reinterpret_cast<uint64_t>(&io.wakeValue);
+    sqe->len = sizeof(io.wakeValue);
+    sqe->user_data = makeUserData(0, OP_WAKE);
+}
+
+void UringReactor::armRecv(IoThread& io, Connection& conn) {
+    if (conn.closed || conn.recvPending) {
+        return;
+    }
+    if (!conn.session->wantsInput()) {
+        // Not receiving lets TCP flow control push back on the client;
+        // updateConnection re-arms once the session is ready
+        armHangupPoll(io, conn);
+        return;
+    }
+
+    io_uring_sqe* sqe = io.ring.getSqe(io.stats.syscalls);
+    if (!sqe) {
+        closeSocket(io, conn);
+        return;
+    }
+    // The kernel picks a buffer from the group once data has arrived
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = static_cast<int>(conn.slot);
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_BUFFER_GROUP;
+    sqe->user_data = makeUserData(conn.id, OP_RECV);
+    conn.recvPending = true;
+}
+
+void UringReactor::armHangupPoll(IoThread& io, Connection& conn) {
+    if (conn.closed || conn.pollPending) {
+        return;
+    }
+    // Without a receive in flight this is the only sign that the client went away
+    io_uring_sqe* sqe = io.ring.getSqe(io.stats.syscalls);
+    if (!sqe) {
+        return;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = static_cast<int>(conn.slot);
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->poll32_events = POLLRDHUP;
+    sqe->user_data = makeUserData(conn.id, OP_POLL);
+    conn.pollPending = true;
+}
+
+void UringReactor::flush(IoThread& io, Connection& conn) {
+    if (conn.closed || conn.sendPending) {
+        return;
+    }
+    if (conn.sending.empty()) {
+        if (conn.outbox.empty()) {
+            return;
+        }
+        // Replies queued while a send was in flight go out as one batch
+        conn.sending.swap(conn.outbox);
+        conn.sendingOffset = 0;
+    }
+
+    io_uring_sqe* sqe = io.ring.getSqe(io.stats.syscalls);
+    if (!sqe) {
+        closeSocket(io, conn);
+        return;
+    }
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = static_cast<int>(conn.slot);
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->addr = reinterpret_cast<uint64_t>(conn.sending.data() + conn.sendingOffset);
+    sqe->len = static_cast<uint32_t>(std::min<size_t>(conn.sending.size() - conn.sendingOffset, UINT32_MAX));
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = makeUserData(conn.id, OP_SEND);
+    conn.sendPending = true;
+}
+
+void UringReactor::updateConnection(IoThread& io, Connection& conn) {
+    if (!conn.closed && !conn.recvPending && conn.session->wantsInput()) {
+        // Resumed after backpressure: handle messages already buffered, then read again
+        if (deliver(conn.decoder, *conn.session, conn.outbox, "", 0)) {
+            armRecv(io, conn);
+        }
+        else {
+            flush(io, conn);
+            closeSocket(io, conn);
+        }
+    }
+
+    if (!conn.closed) {
+        // Encode the next result frames while the previous batch is in flight
+        if (conn.outbox.empty()) {
+            fillOutbox(*conn.session, conn.outbox);
+        }
+        flush(io, conn);
+        if (conn.session->isFinished() && conn.outbox.empty() && conn.sending.empty()) {
+            closeSocket(io, conn);
+        }
+    }
+
+    // Buffers of operations in flight and analysis jobs both reference the
+    // connection, so it lives until they have all completed
+    if (conn.closed && conn.closeDone && !conn.recvPending && !conn.sendPending && !conn.pollPending &&
+        !conn.session->isAnalyzing()) {
+        io.connections.erase(conn.id);
+    }
+}
+
+void UringReactor::closeSocket(IoThread& io, Connection& conn) {
+    if (conn.closed) {
+        return;
+    }
+    conn.closed = true;
+    conn.session->abort();
+    std::cout << "Client disconnected" << std::endl;
+
+    // Shutdown completes the pending receive; the hard link runs the close
+    // (which frees the fixed-file slot) even if the shutdown fails
+    io_uring_sqe* shutdownSqe = io.ring.getSqe(io.stats.syscalls);
+    if (!shutdownSqe) {
+        conn.closeDone = true;
+        return;
+    }
+    shutdownSqe->opcode = IORING_OP_SHUTDOWN;
+    shutdownSqe->fd = static_cast<int>(conn.slot);
+    shutdownSqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+    shutdownSqe->len = SHUT_RDWR;
+    shutdownSqe->user_data = makeUserData(conn.id, OP_SHUTDOWN);
+
+    io_uring_sqe* closeSqe = io.ring.getSqe(io.stats.syscalls);
+    if (!closeSqe) {
+        conn.closeDone = true;
+        return;
+    }
+    closeSqe->opcode = IORING_OP_CLOSE;
+    closeSqe->file_index = conn.slot + 1;
+    closeSqe->user_data = makeUserData(conn.id, OP_CLOSE);
+}
+
+void UringReactor::post(IoThread& io, std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lock(io.postedMutex);
+        io.posted.push_back(std::move(fn));
+    }
+    uint64_t one = 1;
+    if (write(io.wakeFd, &one, sizeof(one)) < 0) {
+        // Counter overflow only; a wakeup is already pending
+    }
+}
+
+void UringReactor::runPosted(IoThread& io) {
+    std::vector<std::function<void()>> posted;
+    {
+        std::lock_guard<std::mutex> lock(io.postedMutex);
+        posted.swap(io.posted);
+    }
+    for (auto& fn : posted) {
+        fn();
+    }
+}
+
+#endif // __linux__ && LOG_ANALYZER_HAVE_IO_URING
@@ -0,0 +1,68 @@
+#ifndef URING_REACTOR_H
+#define URING_REACTOR_H
+
+#if defined(__linux__) && defined(LOG_ANALYZER_HAVE_IO_URING)
+
+#include "server/reactor.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+// io_uring backend, talking to the kernel through the raw syscalls. Each I/O
+// thread owns one ring on which it keeps a multishot accept armed and batches
+// every receive, send and close it prepares into one io_uring_enter() per
+// loop iteration. Accepted sockets go straight into the ring's registered
+// (fixed) file table, receives draw from a registered provided-buffer ring,
+// and connections are torn down with a hard-linked shutdown -> close chain.
+// start() fails if the running kernel lacks any of this, so the server can
+// fall back to epoll.
+class UringReactor : public IoBackend {
+public:
+    UringReactor(ServerContext& context, unsigned int numThreads);
+    ~UringReactor() override;
+
+    bool start(socket_t listenSocket) override;
+    void stop() override;
+    const char* name() const override { return "io_uring"; }
+
+private:
+    struct Ring;
+    struct Connection;
+    struct IoThread;
+
+    // Event loop of one I/O thread
+    void run(IoThread& io);
+
+    // Completion handlers
+    void onAccept(IoThread& io, int result, uint32_t flags);
+    void onRecv(IoThread& io, Connection& conn, int result, uint32_t flags);
+    void onSend(IoThread& io, Connection& conn, int result);
+    void onPoll(IoThread& io, Connection& conn, int result);
+
+    // Submission helpers
+    void armAccept(IoThread& io);
+    void armWake(IoThread& io);
+    void armRecv(IoThread& io, Connection& conn);
+    void armHangupPoll(IoThread& io, Connection& conn);
+    void flush(IoThread& io, Connection& conn);
+    void closeSocket(IoThread& io, Connection& conn);
+
+    // Close once the session is done, drop once nothing references it
+    void updateConnection(IoThread& io, Connection& conn);
+
+    // Queue a closure for an I/O thread (callable from any thread)
+    void post(IoThread& io, std::function<void()> fn);
+    void runPosted(IoThread& io);
+
+    unsigned int numThreads_;
+    socket_t listenSocket_;
+    std::vector<std::unique_ptr<IoThread>> threads_;
+    std::atomic<bool> running_;
+    std::atomic<uint64_t> nextId_;
+};
+
+#endif // __linux__ && LOG_ANALYZER_HAVE_IO_URING
+
+#endif // URING_REACTOR_H
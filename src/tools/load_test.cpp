@@ -0,0 +1,214 @@
+#include "client/client.h"
+#include "bench/log_synth.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+// Runs many concurrent LogClient sessions against a server and reports
+// throughput and latency percentiles. Each session connects, uploads the
+// same directory and waits for its result, as the client tool does.
+void printUsage(const char* programName) {
+    std::cout << "Usage: " << programName << " [options] <server_ip>\n";
+    std::cout << "  --port <port>        - Server port (default " << DEFAULT_PORT << ")\n";
+    std::cout << "  --sessions <n>       - Sessions to run in total (default 200)\n";
+    std::cout << "  --concurrency <n>    - Sessions in flight at once (default 100)\n";
+    std::cout << "  --type <user|ip|log_level> - Analysis type (default user)\n";
+    std::cout << "  --dir <directory>    - Log directory every session uploads (default: generated)\n";
+    std::cout << "  --records <n>        - Generated records per file, one file per format (default 500)\n";
+    std::cout << "  --users <n>          - Generated distinct users (default 1000)\n";
+    std::cout << "  --skew <s>           - Zipf exponent of the generated keys (default 1)\n";
+}
+
+// Discards output; stateless, so sessions on many threads can share it
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override {
+        return c;
+    }
+};
+
+struct SessionOutcome {
+    bool ok = false;
+    double seconds = 0;
+    uint64_t entries = 0;
+};
+
+static SessionOutcome runSession(const std::string& serverIP, int port, const AnalysisRequest& request,
+                                 const std::string& directory) {
+    SessionOutcome outcome;
+    auto start = Clock::now();
+    LogClient client;
+    AnalysisResult result;
+    if (client.connect(serverIP, port) && client.sendRequest(request) && client.sendLogFiles(directory) &&
+        client.receiveResult(result)) {
+        outcome.ok = true;
+        outcome.entries = result.totalEntries;
+    }
+    client.disconnect();
+    outcome.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return outcome;
+}
+
+static double percentile(const std::vector<double>& sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+int main(int argc, char* argv[]) {
+    std::string serverIP;
+    int port = DEFAULT_PORT;
+    size_t sessions = 200;
+    size_t concurrency = 100;
+    AnalysisType type = AnalysisType::USER;
+    std::string directory;
+    SyntheticLogOptions options;
+    options.records = 500;
+    options.users = 1000;
+    options.skew = 1.0;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--port" && hasValue) {
+                port = std::stoi(argv[++i]);
+            }
+            else if (arg == "--sessions" && hasValue) {
+                sessions = std::stoull(argv[++i]);
+            }
+            else if (arg == "--concurrency" && hasValue) {
+                concurrency = std::max<size_t>(1, std::stoull(argv[++i]));
+            }
+            else if (arg == "--type" && hasValue) {
+                std::string name = argv[++i];
+                std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+                type = stringToAnalysisType(name);
+            }
+            else if (arg == "--dir" && hasValue) {
+                directory = argv[++i];
+            }
+            else if (arg == "--records" && hasValue) {
+                options.records = std::stoull(argv[++i]);
+            }
+            else if (arg == "--users" && hasValue) {
+                options.users = std::max<size_t>(1, std::stoull(argv[++i]));
+            }
+            else if (arg == "--skew" && hasValue) {
+                options.skew = std::stod(argv[++i]);
+            }
+            else if (arg.rfind("--", 0) != 0 && serverIP.empty()) {
+                serverIP = arg;
+            }
+            else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Invalid option value: " << e.what() << std::endl;
+        return 1;
+    }
+    if (serverIP.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // Generated dataset: one file per format, removed afterwards
+    std::string generatedDirectory;
+    if (directory.empty()) {
+        std::random_device random;
+        generatedDirectory = (fs::temp_directory_path() / ("load_test_" + std::to_string(random()))).string();
+        fs::create_directories(generatedDirectory);
+        const std::pair<LogFormat, const char*> formats[] = {
+            {LogFormat::JSON, "logs.json"}, {LogFormat::XML, "logs.xml"}, {LogFormat::TXT, "logs.txt"}};
+        for (const auto& format : formats) {
+            std::string content = generateLogs(format.first, options);
+            std::ofstream((fs::path(generatedDirectory) / format.second).string(), std::ios::binary)
+                .write(content.data(), content.size());
+        }
+        directory = generatedDirectory;
+    }
+
+    AnalysisRequest request;
+    request.type = type;
+    std::vector<std::string> files = listFilesInDirectory(directory);
+    uint64_t bytesPerSession = 0;
+    for (const auto& file : files) {
+        std::error_code error;
+        uintmax_t size = fs::file_size(file, error);
+        bytesPerSession += error ? 0 : size;
+    }
+    request.expectedBytes = bytesPerSession;
+    if (files.empty()) {
+        std::cerr << "No log files in " << directory << std::endl;
+        return 1;
+    }
+
+    std::cout << "Running " << sessions << " sessions, " << concurrency << " at a time, each uploading "
+              << files.size() << " files (" << bytesPerSession << " bytes) to " << serverIP << ":" << port
+              << std::endl;
+
+    // LogClient reports every step on stdout: silence it while sessions run
+    NullBuffer discard;
+    std::streambuf* console = std::cout.rdbuf(&discard);
+
+    std::vector<SessionOutcome> outcomes(sessions);
+    std::atomic<size_t> nextSession{0};
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < std::min(concurrency, sessions); ++t) {
+        threads.emplace_back([&]() {
+            for (size_t i = nextSession++; i < sessions; i = nextSession++) {
+                outcomes[i] = runSession(serverIP, port, request, directory);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::cout.rdbuf(console);
+    if (!generatedDirectory.empty()) {
+        std::error_code error;
+        fs::remove_all(generatedDirectory, error);
+    }
+
+    std::vector<double> latencies;
+    uint64_t entries = 0;
+    for (const auto& outcome : outcomes) {
+        if (outcome.ok) {
+            latencies.push_back(outcome.seconds * 1000);
+            entries += outcome.entries;
+        }
+    }
+    std::sort(latencies.begin(), latencies.end());
+    size_t succeeded = latencies.size();
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "\n===== Load Test Results =====\n";
+    std::cout << "Sessions: " << succeeded << " succeeded, " << (sessions - succeeded) << " failed in "
+              << wallSeconds << " s\n";
+    std::cout << "Throughput: " << succeeded / wallSeconds << " sessions/s, "
+              << (succeeded * bytesPerSession / 1048576.0) / wallSeconds << " MB/s uploaded, "
+              << entries / wallSeconds << " records/s analyzed\n";
+    std::cout << "Latency (ms): p50 " << percentile(latencies, 0.50) << ", p90 " << percentile(latencies, 0.90)
+              << ", p99 " << percentile(latencies, 0.99) << ", max " << (latencies.empty() ? 0 : latencies.back())
+              << std::endl;
+    return succeeded == sessions ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+#include "bench/log_synth.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+void printUsage(const char* programName) {
+    std::cout << "Usage: " << programName << " [options] <output_directory>\n";
+    std::cout << "  --format <json|xml|txt|all> - Log format (default: all, one file of each)\n";
+    std::cout << "  --files <n>      - Files per format (default 1)\n";
+    std::cout << "  --records <n>    - Records per file (default 10000)\n";
+    std::cout << "  --size <MB>      - Approximate size per file, instead of --records\n";
+    std::cout << "  --users <n>      - Distinct users (default 100)\n";
+    std::cout << "  --ips <n>        - Distinct IP addresses (default 1000)\n";
+    std::cout << "  --skew <s>       - Zipf exponent for users and IPs (default 0: uniform; ~1 is typical)\n";
+    std::cout << "  --start <date>   - First timestamp, YYYY-MM-DD (default 2023-01-01)\n";
+    std::cout << "  --days <n>       - Spread timestamps over this many days (default: one record per second)\n";
+    std::cout << "  --seed <n>       - Random seed (default 42)\n";
+    std::cout << "\nExample:\n";
+    std::cout << "  " << programName << " --size 100 --users 100000 --skew 1.1 --days 30 test_logs/large\n";
+}
+
+int main(int argc, char* argv[]) {
+    SyntheticLogOptions options;
+    std::string format = "all";
+    std::string outputDirectory;
+    size_t files = 1;
+    double sizeMB = 0;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--format" && hasValue) {
+                format = argv[++i];
+            }
+            else if (arg == "--files" && hasValue) {
+                files = std::stoull(argv[++i]);
+            }
+            else if (arg == "--records" && hasValue) {
+                options.records = std::stoull(argv[++i]);
+            }
+            else if (arg == "--size" && hasValue) {
+                sizeMB = std::stod(argv[++i]);
+            }
+            else if (arg == "--users" && hasValue) {
+                options.users = std::stoull(argv[++i]);
+            }
+            else if (arg == "--ips" && hasValue) {
+                options.ips = std::stoull(argv[++i]);
+            }
+            else if (arg == "--skew" && hasValue) {
+                options.skew = std::stod(argv[++i]);
+            }
+            else if (arg == "--start" && hasValue) {
+                if (!parseStartDate(argv[++i], options.startTime)) {
+                    std::cerr << "Invalid start date: " << argv[i] << std::endl;
+                    return 1;
+                }
+            }
+            else if (arg == "--days" && hasValue) {
+                options.spanSeconds = static_cast<int64_t>(std::stod(argv[++i]) * 86400);
+            }
+            else if (arg == "--seed" && hasValue) {
+                options.seed = std::stoull(argv[++i]);
+            }
+            else if (arg.rfind("--", 0) != 0 && outputDirectory.empty()) {
+                outputDirectory = arg;
+            }
+            else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Invalid option value: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::vector<std::pair<LogFormat, std::string>> formats;
+    if (format == "json" || format == "all") formats.emplace_back(LogFormat::JSON, "json");
+    if (format == "xml" || format == "all") formats.emplace_back(LogFormat::XML, "xml");
+    if (format == "txt" || format == "all") formats.emplace_back(LogFormat::TXT, "txt");
+    if (outputDirectory.empty() || formats.empty() || options.users == 0 || options.ips == 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::error_code error;
+    fs::create_directories(outputDirectory, error);
+    if (error) {
+        std::cerr << "Error creating directory: " << outputDirectory << std::endl;
+        return 1;
+    }
+
+    uint64_t totalBytes = 0;
+    uint64_t totalRecords = 0;
+    for (const auto& entry : formats) {
+        SyntheticLogOptions fileOptions = options;
+        if (sizeMB > 0) {
+            fileOptions.records = static_cast<size_t>(sizeMB * 1048576 / averageRecordSize(entry.first, options)) + 1;
+        }
+        for (size_t file = 0; file < files; ++file) {
+            // Every file draws its own keys over the same time span, like separate hosts
+            fileOptions.seed = options.seed + file;
+            std::string content = generateLogs(entry.first, fileOptions);
+
+            std::string path = (fs::path(outputDirectory) / ("logs_" + std::to_string(file + 1) + "." + entry.second)).string();
+            std::ofstream out(path, std::ios::binary);
+            if (!out.write(content.data(), content.size())) {
+                std::cerr << "Error writing file: " << path << std::endl;
+                return 1;
+            }
+            std::cout << "Wrote " << path << " (" << fileOptions.records << " records, " << content.size()
+                      << " bytes)" << std::endl;
+            totalBytes += content.size();
+            totalRecords += fileOptions.records;
+        }
+    }
+    std::cout << "Generated " << totalRecords << " records, " << totalBytes << " bytes" << std::endl;
+    return 0;
+}